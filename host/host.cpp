@@ -0,0 +1,343 @@
+/*
+Host build of the Moscilloscope sketch: main.cpp compiled for Linux against the stand-in libraries in stubs/, so the pipeline can be run, timed
+and tested without the hardware. The SD card is a directory on the host (the current one unless -d is given), so a capture copied off the
+card (or received with "capture receive" and copied off) replays here exactly as it does on the scope.
+
+Usage: scope_host [-d card-directory] command
+  selftest               - run the sketch's self-tests
+  synthcapture <records> [layout]
+                         - write a capture of synthesized records to CAPTURE.BIN, packed in a store layout (STORE_ value, the
+                           record's own by default)
+  replay [frames]        - push every record of CAPTURE.BIN through the pipeline as fast as it will go and report the rate and stage
+                           times (benchmarkReplay), optionally writing the rendered frames to FRAMES.RAW
+  frames [record]        - render the frame scenarios and compare them with the golden frames on the card, or record new ones
+                           (testFrameRegression). The golden frames for this build are kept in golden/: text is drawn with stand-in
+                           glyphs here, so they are not the scope's own.
+  kernels                - run the store and processing kernels in channel counts, field widths, sample types and record lengths
+                           other than the sketch's, and check them against plain reference versions
+  rate [replay]          - waveform update rate and blind time at a spread of HScale settings, from a synthesized record or by
+                           replaying CAPTURE.BIN (benchmarkUpdateRate)
+*/
+
+#include "../main.cpp"
+
+#define UPDATE_RATE_MS 1000 // Time benchmarkUpdateRate() runs the loop for at each HScale setting
+
+/*
+Name: runSelfTests
+Description: Runs every self-test the sketch has, in the order of its sections
+Returns: Nothing (prints to terminal)
+Parameters: None
+*/
+void runSelfTests(){
+  benchmarkSampleStore();
+  testDSPKernels();
+  testTriggers();
+  testProtocolDecoders();
+  testMaskTest();
+  testAutoset();
+  Serial.println(verifyPixelLUTs() ? "Pixel table self-test PASSED" : "Pixel table self-test FAILED");
+}
+
+/*
+Name: processStore
+Description: processAcquisition() for a store of any configuration: unpacks each channel a window at a time (an odd window size, so windows
+don't line up with the record's end), runs the kernel for procMode and packs it back
+Returns: Nothing (updates the store, the accumulators and avgAcquired)
+Parameters: uint32_t "store[]", int32_t "accum[][LENGTH]"
+*/
+template<int CHANNELS, int BITS, typename SampleT, int LENGTH>
+void processStore(uint32_t store[], int32_t accum[][LENGTH]){
+  const int window = 97;
+  const int ahead = (procMode == PROC_HIRES) ? (1 << avgLog2) - (1 << avgLog2)/2 : 0;
+  SampleT data[window + (1 << HIRES_MAX_LOG2)];
+
+  for(int ch = 0; ch < CHANNELS; ch++){
+    HiResFilter<SampleT> filter;
+    for(int base = 0; base < LENGTH; base += window){
+      int n = min(window, LENGTH - base);
+      unpackChannel<CHANNELS, BITS, 0>(store, ch, base, min(n + ahead, LENGTH - base), data);
+      switch(procMode){
+        case PROC_AVG_EXP:   processAverageExp(data, &accum[ch][base], n);   break;
+        case PROC_AVG_BLOCK: processAverageBlock(data, &accum[ch][base], n); break;
+        case PROC_HIRES:
+          if(base == 0){
+            processHiResBegin(filter, data, LENGTH, storeField<CHANNELS, BITS, 0>(store, ch, LENGTH - 1));
+          }
+          processHiRes(filter, data, base, n);
+        break;
+        default:             processNormal(data, n);
+      }
+      packChannel<CHANNELS, BITS, 0>(store, ch, base, n, data);
+    }
+  }
+  if(procMode == PROC_AVG_EXP || procMode == PROC_AVG_BLOCK){
+    avgAcquired++;
+  }
+  if(procMode == PROC_AVG_BLOCK && avgAcquired >= (1 << avgLog2)){
+    avgAcquired = 0;
+  }
+}
+
+/*
+Name: checkKernels
+Description: Checks the store and processing kernels in one configuration. Random ADC records are packed and unpacked (whole channels and
+random spans), then taken through each processing mode by processStore() and compared with the same processing done on plain int arrays:
+normal, five acquisitions of the exponential average, six of the block average (so a block restarts; its reciprocal multiply may round one
+count differently from a divide) and high-res at every length.
+Returns: int "mismatches" (prints a summary line)
+Parameters: const char* "name" (the configuration, for the summary)
+*/
+template<int CHANNELS, int BITS, typename SampleT, int LENGTH>
+int checkKernels(const char* name){
+  static uint32_t store[(CHANNELS*LENGTH*BITS + 31)/32 + 1];
+  static int32_t accum[CHANNELS][LENGTH];
+  static int raw[CHANNELS][LENGTH];
+  static int64_t reference[CHANNELS][LENGTH]; // The exponential average's accumulators, or the block's sum
+  static SampleT values[LENGTH];
+  const char* modeNames[PROC_NUM_MODES] = {"pack", "exp avg", "block avg", "hi-res"};
+  int mismatches[PROC_NUM_MODES] = {0};
+
+  auto acquire = [&](){
+    for(int ch = 0; ch < CHANNELS; ch++){
+      for(int i = 0; i < LENGTH; i++){
+        raw[ch][i] = random(ADC_MAX_COUNT + 1);
+        values[i] = raw[ch][i];
+      }
+      packChannel<CHANNELS, BITS, 0>(store, ch, 0, LENGTH, values);
+    }
+  };
+  auto compare = [&](int mode, auto expected, int tolerance){
+    for(int ch = 0; ch < CHANNELS; ch++){
+      for(int i = 0; i < LENGTH; i++){
+        mismatches[mode] += abs(storeField<CHANNELS, BITS, 0>(store, ch, i) - expected(ch, i)) > tolerance;
+      }
+    }
+  };
+
+  // Packing: whole channels back out, then random spans of them
+  acquire();
+  compare(PROC_NORMAL, [&](int ch, int i){ return raw[ch][i]; }, 0);
+  for(int trial = 0; trial < 200; trial++){
+    int ch = random(CHANNELS);
+    int first = random(LENGTH);
+    int count = 1 + random(LENGTH - first);
+    unpackChannel<CHANNELS, BITS, 0>(store, ch, first, count, values);
+    for(int i = 0; i < count; i++){
+      mismatches[PROC_NORMAL] += values[i] != raw[ch][first + i];
+    }
+  }
+  procMode = PROC_NORMAL;
+  processStore<CHANNELS, BITS, SampleT, LENGTH>(store, accum);
+  compare(PROC_NORMAL, [&](int ch, int i){ return raw[ch][i] << PROC_EXTRA_BITS; }, 0);
+
+  procMode = PROC_AVG_EXP;
+  avgLog2 = 3;
+  avgAcquired = 0;
+  for(int acquisition = 0; acquisition < 5; acquisition++){
+    acquire();
+    processStore<CHANNELS, BITS, SampleT, LENGTH>(store, accum);
+    compare(PROC_AVG_EXP, [&](int ch, int i){
+      const int outShift = AVG_FRAC_BITS - PROC_EXTRA_BITS;
+      int64_t target = (int64_t)raw[ch][i] << AVG_FRAC_BITS;
+      reference[ch][i] = (acquisition == 0) ? target : reference[ch][i] + ((target - reference[ch][i]) >> avgLog2);
+      return (acquisition == 0) ? raw[ch][i] << PROC_EXTRA_BITS : (int)((reference[ch][i] + (1 << (outShift - 1))) >> outShift);
+    }, 0);
+  }
+
+  procMode = PROC_AVG_BLOCK;
+  avgLog2 = 2;
+  avgAcquired = 0;
+  for(int acquisition = 0; acquisition < 6; acquisition++){
+    int inBlock = acquisition % (1 << avgLog2) + 1;
+    acquire();
+    processStore<CHANNELS, BITS, SampleT, LENGTH>(store, accum);
+    compare(PROC_AVG_BLOCK, [&](int ch, int i){
+      reference[ch][i] = (inBlock == 1) ? raw[ch][i] : reference[ch][i] + raw[ch][i];
+      return (int)lround((double)(reference[ch][i] << PROC_EXTRA_BITS)/inBlock);
+    }, 1);
+  }
+
+  procMode = PROC_HIRES;
+  for(avgLog2 = 1; avgLog2 <= HIRES_MAX_LOG2; avgLog2++){
+    const int taps = 1 << avgLog2;
+    const int shift = avgLog2 - PROC_EXTRA_BITS;
+    acquire();
+    processStore<CHANNELS, BITS, SampleT, LENGTH>(store, accum);
+    compare(PROC_HIRES, [&](int ch, int i){
+      int sum = 0;
+      for(int k = i - taps/2; k < i - taps/2 + taps; k++){
+        sum += raw[ch][constrain(k, 0, LENGTH - 1)];
+      }
+      return (shift >= 0) ? (sum + ((1 << shift) >> 1)) >> shift : sum << -shift;
+    }, 0);
+  }
+
+  int total = 0;
+  printf("%-32s", name);
+  for(int mode = 0; mode < PROC_NUM_MODES; mode++){
+    printf("  %s %d", modeNames[mode], mismatches[mode]);
+    total += mismatches[mode];
+  }
+  printf("\n");
+  return total;
+}
+
+/*
+Name: checkAllKernels
+Description: Runs checkKernels() on the sketch's own configuration and on ones that change the channel count, field width, sample type and
+record length (including fields that straddle words at every offset, and lengths that aren't a whole number of windows)
+Returns: bool (true if every configuration matched its reference)
+Parameters: None
+*/
+bool checkAllKernels(){
+  int saved[3] = {procMode, avgLog2, avgAcquired};
+  int mismatches = 0;
+
+  printf("Kernel mismatches against the reference versions (pack covers unpacking and the normal mode)\n");
+  mismatches += checkKernels<NUM_CHANNELS, STORE_RECORD_BITS, sample_t, NUM_SAMPLES>("the sketch's own");
+  mismatches += checkKernels<4, 16, int32_t, 5000>("4 ch x 16 bits, int32_t, 5000");
+  mismatches += checkKernels<3, 13, int32_t, 1237>("3 ch x 13 bits, int32_t, 1237");
+  mismatches += checkKernels<1, 12, int16_t, 777>("1 ch x 12 bits, int16_t, 777");
+
+  procMode = saved[0];
+  avgLog2 = saved[1];
+  avgAcquired = saved[2];
+  return mismatches == 0;
+}
+
+/*
+Name: writeSynthCapture
+Description: Records a capture of synthesized records through the sketch's own capture path: a sine on channel 1 and a square on channel 2,
+both sweeping in frequency from record to record so that no two replayed frames are the same
+Returns: bool (true if the capture was written)
+Parameters: uint32_t "records", int "layout" (STORE_ value the records are packed in)
+*/
+bool writeSynthCapture(uint32_t records, int layout){
+  if(!setCaptureLayout(layout) || !startCapture()){
+    return false;
+  }
+  for(uint32_t r = 0; r < records; r++){
+    synthRecord(0, false, 1000 + 50*r, 3.0, 0.5);
+    synthRecord(1, true, 2500 + 120*r, 2.0, -1.0);
+    recordCapture();
+  }
+  stopCapture();
+  return captureRecords == records;
+}
+
+/*
+Name: benchmarkUpdateRate
+Description: Measures the waveform update rate and blind time at five HScale settings from HScaleMin to HScaleMax. At each setting the loop the
+scope runs (take a record, convert and trigger, decimate, decode, mask test, render, display update) runs for UPDATE_RATE_MS. Dead time is
+counted from the end of one record to the start of the next, and the blind fraction is the share of real time no record covers, taking each
+record to last as long as it would on the scope. The records are a 1 kHz 2 Vpp sine on channel 1, triggered at 0.5 V, synthesized once per
+setting (so there is no acquisition, and the dead time is the whole loop), or those of the capture being replayed.
+Returns: Nothing (prints to terminal)
+Parameters: bool "replay"
+*/
+void benchmarkUpdateRate(bool replay){
+  const int numSettings = 5;
+  const double cyclesPerUs = F_CPU_ACTUAL/1E6;
+
+  if(!replay){
+    triggerVoltage = 0.5;
+    triggerHysteresis = 0;
+    triggerSource = TRIG_SRC_CH1;
+  }
+  printf("Records from %s\n", replay ? "the replayed capture" : "a synthesized 1 kHz sine");
+  printf("%12s %12s %12s %12s %12s %9s\n", "HScale (us)", "updates/s", "triggered/s", "record (us)", "dead (us)", "blind");
+
+  for(int setting = 0; setting < numSettings; setting++){
+    HScale = HScaleMin*pow(HScaleMax/HScaleMin, setting/(numSettings - 1.0));
+    if(!replay){
+      synthRecord(0, false, 1000, 2.0, 0);
+      synthRecord(1, false, 1000, 2.0, 0);
+    }
+
+    uint32_t updates = 0;
+    uint32_t triggered = 0;
+    uint64_t deadCycles = 0;
+    uint32_t recordEnd = ARM_DWT_CYCCNT;
+    uint32_t startMs = millis();
+    while(millis() - startMs < UPDATE_RATE_MS){
+      deadCycles += ARM_DWT_CYCCNT - recordEnd; // Re-armed: the next record starts now
+      if(replay){
+        replayNextRecord();
+      }
+      recordEnd = ARM_DWT_CYCCNT;
+
+      updateVoltageData();
+      extractPlottingData();
+      if(displayMode == DISPLAY_ZOOM){
+        extractZoomOverview();
+        extractZoomColumns();
+      }
+      runProtocolDecoder();
+      runMaskTest();
+      renderFrame();
+      tft.update(fb);
+
+      updates++;
+      triggered += (trigIndex > 0);
+    }
+
+    double seconds = (millis() - startMs)/1000.0;
+    double recordUs = NUM_SAMPLES*sampleDt*1E6;
+    double blind = max(0.0, 1.0 - updates/seconds*recordUs/1E6);
+    printf("%12.3f %12.1f %12.1f %12.1f %12.1f %8.2f%%\n", HScale*1E6, updates/seconds, triggered/seconds, recordUs,
+           updates ? deadCycles/cyclesPerUs/updates : 0.0, 100*blind);
+  }
+}
+
+int main(int argc, char** argv){
+  const char* card = ".";
+  int arg = 1;
+  if(arg + 1 < argc && strcmp(argv[arg], "-d") == 0){
+    card = argv[arg + 1];
+    arg += 2;
+  }
+  if(arg >= argc){
+    fprintf(stderr, "usage: %s [-d card-directory] selftest | synthcapture <records> [layout] | replay [frames] | frames [record] | kernels | rate [replay]\n", argv[0]);
+    return 2;
+  }
+  const char* command = argv[arg];
+  const char* option = (arg + 1 < argc) ? argv[arg + 1] : "";
+  const char* option2 = (arg + 2 < argc) ? argv[arg + 2] : "";
+
+  SD.setRoot(card);
+  setup();
+
+  if(strcmp(command, "selftest") == 0){
+    runSelfTests();
+  }else if(strcmp(command, "synthcapture") == 0){
+    if(!writeSynthCapture(atoi(option), (*option2 != 0) ? atoi(option2) : STORE_PACK_PROC)){
+      fprintf(stderr, "Could not write %s/%s\n", card, CAPTURE_FILE);
+      return 1;
+    }
+  }else if(strcmp(command, "replay") == 0){
+    if(!setReplay(true)){
+      fprintf(stderr, "No capture to replay in %s\n", card);
+      return 1;
+    }
+    setReplay(false);
+    benchmarkReplay(strcmp(option, "frames") == 0);
+  }else if(strcmp(command, "kernels") == 0){
+    if(!checkAllKernels()){
+      return 1;
+    }
+  }else if(strcmp(command, "rate") == 0){
+    bool replay = strcmp(option, "replay") == 0;
+    if(replay && !setReplay(true)){
+      fprintf(stderr, "No capture to replay in %s\n", card);
+      return 1;
+    }
+    benchmarkUpdateRate(replay);
+  }else if(strcmp(command, "frames") == 0){
+    testFrameRegression(strcmp(option, "record") == 0);
+  }else{
+    fprintf(stderr, "Unknown command: %s\n", command);
+    return 2;
+  }
+  return 0;
+}
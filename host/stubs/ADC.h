@@ -0,0 +1,29 @@
+// Host build: the Teensy ADC library. There is no analog front end here, so every conversion finishes at once and reads mid-scale; records
+// reach the pipeline from a replayed capture or a synthesizer instead.
+#pragma once
+#include <Arduino.h>
+
+enum class ADC_CONVERSION_SPEED { VERY_LOW_SPEED, LOW_SPEED, MED_SPEED, HIGH_SPEED_16BITS, HIGH_SPEED, VERY_HIGH_SPEED };
+enum class ADC_SAMPLING_SPEED { VERY_LOW_SPEED, LOW_SPEED, LOW_MED_SPEED, MED_SPEED, MED_HIGH_SPEED, HIGH_SPEED, HIGH_VERY_HIGH_SPEED, VERY_HIGH_SPEED };
+
+class ADC_Module {
+  uint8_t resolution = 10;
+public:
+  void setResolution(uint8_t bits){ resolution = bits; }
+  void setConversionSpeed(ADC_CONVERSION_SPEED){}
+  void setSamplingSpeed(ADC_SAMPLING_SPEED){}
+  void setAveraging(uint8_t){}
+  bool checkPin(uint8_t){ return true; }
+  bool isConverting(){ return false; }
+  bool startSingleRead(uint8_t){ return true; }
+  int readSingle(){ return 1 << (resolution - 1); }
+  int analogRead(uint8_t){ return readSingle(); }
+};
+
+class ADC {
+  ADC_Module modules[2];
+public:
+  ADC_Module* const adc0 = &modules[0];
+  ADC_Module* const adc1 = &modules[1];
+  bool startSynchronizedSingleRead(uint8_t, uint8_t){ return true; }
+};
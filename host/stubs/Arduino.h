@@ -0,0 +1,195 @@
+// Host build: the parts of the Teensy core the sketch uses, on top of the C library. Time comes from the host's monotonic clock, the cycle
+// counter counts at F_CPU_ACTUAL from it, the serial port is stdout and the pins read as idle (pulled up).
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <string>
+#include <random>
+
+#define DMAMEM
+#define FASTRUN
+#define EXTMEM
+#define PROGMEM
+
+#define INPUT        0
+#define OUTPUT       1
+#define INPUT_PULLUP 2
+#define LOW          0
+#define HIGH         1
+#define FALLING      2
+#define RISING       3
+#define CHANGE       4
+#define DEC          10
+#define HEX          16
+#define BIN          2
+
+#define F_CPU_ACTUAL 600000000
+
+#define min(a, b) ({ __typeof__(a) _a = (a); __typeof__(b) _b = (b); (_a < _b) ? _a : _b; })
+#define max(a, b) ({ __typeof__(a) _a = (a); __typeof__(b) _b = (b); (_a > _b) ? _a : _b; })
+template<class T> T constrain(T value, T low, T high){ return (value < low) ? low : ((value > high) ? high : value); }
+using std::abs;
+
+inline uint64_t hostNanoseconds(){
+  static timespec start = []{ timespec t; clock_gettime(CLOCK_MONOTONIC, &t); return t; }();
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)(now.tv_sec - start.tv_sec)*1000000000ULL + now.tv_nsec - start.tv_nsec;
+}
+#define ARM_DWT_CYCCNT ((uint32_t)(hostNanoseconds()*(F_CPU_ACTUAL/1000000)/1000))
+
+inline uint32_t millis(){ return hostNanoseconds()/1000000; }
+inline uint32_t micros(){ return hostNanoseconds()/1000; }
+inline void delayNanoseconds(uint32_t ns){ timespec t = {0, (long)ns}; nanosleep(&t, nullptr); }
+inline void delayMicroseconds(uint32_t us){ delayNanoseconds(us*1000); }
+inline void delay(uint32_t ms){ timespec t = {(time_t)(ms/1000), (long)(ms%1000)*1000000}; nanosleep(&t, nullptr); }
+inline void yield(){}
+inline void noInterrupts(){}
+inline void interrupts(){}
+
+class elapsedMicros {
+  uint32_t start;
+public:
+  elapsedMicros() : start(micros()) {}
+  operator uint32_t() const { return micros() - start; }
+  elapsedMicros& operator=(uint32_t value){ start = micros() - value; return *this; }
+};
+
+// QuadTimer 4, the pad mux and the clock gate, as plain registers: the setup code writes them and reads back what it wrote. Nothing drives the
+// timer inputs or clocks, so the counters hold still (the frequency counter reads no signal and the external trigger never captures).
+struct HostQuadTimerChannel {
+  volatile uint16_t COMP1, COMP2, CAPT, LOAD, HOLD, CNTR, CTRL, SCTRL, CMPLD1, CMPLD2, CSCTRL, FILT, DMA;
+};
+inline HostQuadTimerChannel hostTMR4[4];
+inline volatile uint16_t TMR4_ENBL = 0x000F;
+#define TMR4_COMP12   (hostTMR4[2].COMP1)
+#define TMR4_COMP13   (hostTMR4[3].COMP1)
+#define TMR4_CAPT0    (hostTMR4[0].CAPT)
+#define TMR4_CAPT1    (hostTMR4[1].CAPT)
+#define TMR4_LOAD0    (hostTMR4[0].LOAD)
+#define TMR4_LOAD1    (hostTMR4[1].LOAD)
+#define TMR4_LOAD2    (hostTMR4[2].LOAD)
+#define TMR4_LOAD3    (hostTMR4[3].LOAD)
+#define TMR4_HOLD1    (hostTMR4[1].HOLD)
+#define TMR4_HOLD3    (hostTMR4[3].HOLD)
+#define TMR4_CNTR0    (hostTMR4[0].CNTR)
+#define TMR4_CNTR1    (hostTMR4[1].CNTR)
+#define TMR4_CNTR2    (hostTMR4[2].CNTR)
+#define TMR4_CNTR3    (hostTMR4[3].CNTR)
+#define TMR4_CTRL0    (hostTMR4[0].CTRL)
+#define TMR4_CTRL1    (hostTMR4[1].CTRL)
+#define TMR4_CTRL2    (hostTMR4[2].CTRL)
+#define TMR4_CTRL3    (hostTMR4[3].CTRL)
+#define TMR4_SCTRL0   (hostTMR4[0].SCTRL)
+#define TMR4_SCTRL1   (hostTMR4[1].SCTRL)
+#define TMR4_SCTRL2   (hostTMR4[2].SCTRL)
+#define TMR4_SCTRL3   (hostTMR4[3].SCTRL)
+#define TMR4_CSCTRL0  (hostTMR4[0].CSCTRL)
+#define TMR4_CSCTRL1  (hostTMR4[1].CSCTRL)
+#define TMR4_CSCTRL2  (hostTMR4[2].CSCTRL)
+#define TMR4_CSCTRL3  (hostTMR4[3].CSCTRL)
+#define TMR_CTRL_CM(n)             ((uint16_t)(((n) & 0x7) << 13))
+#define TMR_CTRL_PCS(n)            ((uint16_t)(((n) & 0xF) << 9))
+#define TMR_CTRL_SCS(n)            ((uint16_t)(((n) & 0x3) << 7))
+#define TMR_CTRL_LENGTH            ((uint16_t)(1 << 5))
+#define TMR_SCTRL_IEF              ((uint16_t)(1 << 11))
+#define TMR_SCTRL_CAPTURE_MODE(n)  ((uint16_t)(((n) & 0x3) << 6))
+
+inline volatile uint32_t CCM_CCGR6 = 0;
+#define CCM_CCGR_ON                3
+#define CCM_CCGR6_QTIMER4(n)       ((uint32_t)(((n) & 0x3) << 16))
+inline volatile uint32_t IOMUXC_SW_MUX_CTL_PAD_GPIO_B0_10 = 5;
+inline volatile uint32_t IOMUXC_SW_MUX_CTL_PAD_GPIO_B0_11 = 5;
+
+inline void pinMode(uint8_t, uint8_t){}
+inline void digitalWrite(uint8_t, uint8_t){}
+inline int digitalRead(uint8_t){ return HIGH; }
+inline int digitalPinToInterrupt(int pin){ return pin; }
+inline void attachInterrupt(uint8_t, void (*)(), int){}
+inline void detachInterrupt(uint8_t){}
+
+// Seeded the same every run, so the self-tests see the same "random" cases each time
+inline std::mt19937& hostRandom(){ static std::mt19937 generator(1); return generator; }
+inline void randomSeed(uint32_t seed){ hostRandom().seed(seed); }
+inline long random(long high){ return (high > 0) ? (long)(hostRandom()() % (uint32_t)high) : 0; }
+inline long random(long low, long high){ return low + random(high - low); }
+
+class String {
+  std::string text;
+public:
+  String(){}
+  String(const char* value) : text(value) {}
+  String(const std::string& value) : text(value) {}
+  String(int value) : text(std::to_string(value)) {}
+  String(unsigned value) : text(std::to_string(value)) {}
+  String(long value) : text(std::to_string(value)) {}
+  String(unsigned long value) : text(std::to_string(value)) {}
+  String(double value, int decimals = 2){ char buffer[64]; snprintf(buffer, sizeof(buffer), "%.*f", decimals, value); text = buffer; }
+  const char* c_str() const { return text.c_str(); }
+  int length() const { return text.size(); }
+  void trim(){
+    size_t first = text.find_first_not_of(" \t\r\n");
+    size_t last = text.find_last_not_of(" \t\r\n");
+    text = (first == std::string::npos) ? "" : text.substr(first, last - first + 1);
+  }
+  bool operator==(const char* other) const { return text == other; }
+  bool startsWith(const char* prefix) const { return text.compare(0, strlen(prefix), prefix) == 0; }
+  String substring(int from) const { return String(text.substr(from)); }
+  String substring(int from, int to) const { return String(text.substr(from, to - from)); }
+};
+
+class Print {
+  template<class T> size_t printInteger(T value, int base){
+    if(base < 2 || base == 10){
+      return printf("%s", std::to_string(value).c_str());
+    }
+    char digits[65];
+    int count = 0;
+    unsigned long long magnitude = (unsigned long long)value;
+    do{
+      digits[count++] = "0123456789ABCDEF"[magnitude % base];
+      magnitude /= base;
+    }while(magnitude);
+    for(int i = count - 1; i >= 0; i--){
+      putchar(digits[i]);
+    }
+    return count;
+  }
+public:
+  size_t write(uint8_t c){ return fwrite(&c, 1, 1, stdout); }
+  size_t write(const uint8_t* buffer, size_t size){ return fwrite(buffer, 1, size, stdout); }
+  size_t print(const char* value){ return fputs(value, stdout) >= 0 ? strlen(value) : 0; }
+  size_t print(const String& value){ return print(value.c_str()); }
+  size_t print(char value){ return write((uint8_t)value); }
+  size_t print(int value, int base = DEC){ return printInteger(value, base); }
+  size_t print(unsigned value, int base = DEC){ return printInteger(value, base); }
+  size_t print(long value, int base = DEC){ return printInteger(value, base); }
+  size_t print(unsigned long value, int base = DEC){ return printInteger(value, base); }
+  size_t print(long long value, int base = DEC){ return printInteger(value, base); }
+  size_t print(unsigned long long value, int base = DEC){ return printInteger(value, base); }
+  size_t print(double value, int digits = 2){ return printf("%.*f", digits, value); }
+  size_t println(){ return print("\n"); }
+  template<class T> size_t println(T value){ return print(value) + println(); }
+  template<class T> size_t println(T value, int format){ return print(value, format) + println(); }
+};
+
+// Nothing ever arrives: the host build runs its commands from the command line
+class Stream : public Print {
+public:
+  int available(){ return 0; }
+  long parseInt(){ return 0; }
+  String readStringUntil(char){ return String(); }
+  size_t readBytes(char*, size_t){ return 0; }
+};
+
+class usb_serial_class : public Stream {
+public:
+  void begin(long){}
+  explicit operator bool(){ return true; }
+};
+inline usb_serial_class Serial;
@@ -0,0 +1,16 @@
+// Host build: the emulated EEPROM, as RAM that starts out erased (so the sketch falls back to its default calibration and mask)
+#pragma once
+#include <Arduino.h>
+
+#define E2END 0x10BB
+
+class EEPROMClass {
+  uint8_t bytes[E2END + 1];
+public:
+  EEPROMClass(){ memset(bytes, 0xFF, sizeof(bytes)); }
+  uint8_t read(int address){ return bytes[address]; }
+  void write(int address, uint8_t value){ bytes[address] = value; }
+  template<class T> T& get(int address, T& value){ memcpy((void*)&value, &bytes[address], sizeof(T)); return value; }
+  template<class T> const T& put(int address, const T& value){ memcpy(&bytes[address], (const void*)&value, sizeof(T)); return value; }
+};
+inline EEPROMClass EEPROM;
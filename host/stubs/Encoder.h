@@ -0,0 +1,11 @@
+// Host build: a quadrature encoder that nobody turns
+#pragma once
+#include <Arduino.h>
+
+class Encoder {
+  int32_t position = 0;
+public:
+  Encoder(uint8_t, uint8_t){}
+  int32_t read(){ return position; }
+  void write(int32_t value){ position = value; }
+};
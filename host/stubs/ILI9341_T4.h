@@ -0,0 +1,21 @@
+// Host build: the display driver. The frame stays in the sketch's fb, which is all the host build looks at.
+#pragma once
+#include <Arduino.h>
+
+namespace ILI9341_T4 {
+
+template<int SIZE> class DiffBuffStatic {};
+
+class ILI9341Driver {
+public:
+  ILI9341Driver(uint8_t, uint8_t, uint8_t, uint8_t, uint8_t, uint8_t, uint8_t, uint8_t){}
+  bool begin(){ return true; }
+  void setRotation(uint8_t){}
+  void setFramebuffer(uint16_t*){}
+  template<int SIZE> void setDiffBuffers(DiffBuffStatic<SIZE>*, DiffBuffStatic<SIZE>*){}
+  void setRefreshRate(int){}
+  void setVSyncSpacing(int){}
+  void update(const uint16_t*, bool = false){}
+};
+
+}
@@ -0,0 +1,148 @@
+// Host build: the SD card, as a directory on the host (set with SD.setRoot before setup()). Files opened for reading are memory-mapped, so a
+// replayed capture is read straight out of the page cache; files opened for writing go through stdio.
+#pragma once
+#include <Arduino.h>
+#include <memory>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define FILE_READ      0
+#define FILE_WRITE     1
+#define BUILTIN_SDCARD 254
+
+class File {
+  struct Handle {
+    const uint8_t* map = nullptr; // FILE_READ
+    size_t mapSize = 0;
+    FILE* stream = nullptr;       // FILE_WRITE
+    uint64_t position = 0;
+
+    ~Handle(){
+      if(map != nullptr){
+        munmap((void*)map, mapSize);
+      }
+      if(stream != nullptr){
+        fclose(stream);
+      }
+    }
+  };
+  std::shared_ptr<Handle> handle; // Shared, as File objects are copied around like the Teensy's
+
+public:
+  static File openRead(const std::string& path){
+    File file;
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat status;
+    if(fd < 0){
+      return file;
+    }
+    if(fstat(fd, &status) == 0){
+      file.handle = std::make_shared<Handle>();
+      file.handle->mapSize = status.st_size;
+      if(status.st_size > 0){
+        void* map = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(map == MAP_FAILED){
+          file.handle.reset();
+        }else{
+          file.handle->map = (const uint8_t*)map;
+        }
+      }
+    }
+    ::close(fd);
+    return file;
+  }
+
+  // Like the Teensy's FILE_WRITE: created if missing, and written from the end
+  static File openWrite(const std::string& path){
+    File file;
+    FILE* stream = fopen(path.c_str(), "r+b");
+    if(stream == nullptr){
+      stream = fopen(path.c_str(), "w+b");
+    }
+    if(stream != nullptr){
+      fseek(stream, 0, SEEK_END);
+      file.handle = std::make_shared<Handle>();
+      file.handle->stream = stream;
+      file.handle->position = ftell(stream);
+    }
+    return file;
+  }
+
+  explicit operator bool() const { return handle != nullptr; }
+
+  uint64_t size() const {
+    if(handle == nullptr){
+      return 0;
+    }
+    if(handle->stream == nullptr){
+      return handle->mapSize;
+    }
+    fflush(handle->stream);
+    struct stat status;
+    return (fstat(fileno(handle->stream), &status) == 0) ? status.st_size : 0;
+  }
+
+  bool seek(uint64_t position){
+    if(handle == nullptr || position > size()){
+      return false;
+    }
+    handle->position = position;
+    return handle->stream == nullptr || fseek(handle->stream, position, SEEK_SET) == 0;
+  }
+
+  int read(void* buffer, size_t count){
+    if(handle == nullptr){
+      return -1;
+    }
+    if(handle->stream != nullptr){
+      count = fread(buffer, 1, count, handle->stream);
+    }else{
+      count = min(count, (size_t)(handle->mapSize - handle->position));
+      memcpy(buffer, handle->map + handle->position, count);
+    }
+    handle->position += count;
+    return count;
+  }
+
+  size_t write(const uint8_t* buffer, size_t count){
+    if(handle == nullptr || handle->stream == nullptr){
+      return 0;
+    }
+    count = fwrite(buffer, 1, count, handle->stream);
+    handle->position += count;
+    return count;
+  }
+
+  void close(){
+    handle.reset();
+  }
+};
+
+class SDClass {
+  std::string root;
+
+  std::string path(const char* name) const { return root + "/" + name; }
+
+public:
+  void setRoot(const char* directory){ root = directory; }
+
+  bool begin(uint8_t){
+    struct stat status;
+    return !root.empty() && stat(root.c_str(), &status) == 0 && S_ISDIR(status.st_mode);
+  }
+
+  File open(const char* name, uint8_t mode = FILE_READ){
+    return (mode == FILE_WRITE) ? File::openWrite(path(name)) : File::openRead(path(name));
+  }
+
+  bool exists(const char* name){
+    return access(path(name).c_str(), F_OK) == 0;
+  }
+
+  bool remove(const char* name){
+    return unlink(path(name).c_str()) == 0;
+  }
+};
+inline SDClass SD;
@@ -0,0 +1,11 @@
+// Host build: a debounced button that is never pressed
+#pragma once
+#include <Arduino.h>
+
+class Bounce {
+public:
+  void attach(int, int){}
+  void interval(uint16_t){}
+  bool update(){ return false; }
+  bool fell(){ return false; }
+};
@@ -0,0 +1,14 @@
+// Host build: the Arial fonts, reduced to the sizes the stand-in glyphs in tgx.h are drawn at
+#pragma once
+#include <Arduino.h>
+
+struct ILI9341_t3_font_t {
+  uint8_t cap_height;
+  uint8_t line_space;
+};
+
+inline const ILI9341_t3_font_t font_tgx_Arial_8 = {6, 9};
+inline const ILI9341_t3_font_t font_tgx_Arial_10 = {7, 11};
+inline const ILI9341_t3_font_t font_tgx_Arial_12 = {9, 14};
+inline const ILI9341_t3_font_t font_tgx_Arial_14 = {10, 16};
+inline const ILI9341_t3_font_t font_tgx_Arial_16 = {12, 18};
@@ -0,0 +1,103 @@
+// Host build: the part of tgx the sketch draws with, rendering into the image's buffer for real so that frames can be hashed and compared.
+// Text is drawn as stand-in glyphs (a 3 x 5 block pattern picked by the character, scaled to the font), so a change of string, position,
+// font or color still changes the frame, but frames rendered here are not pixel-identical to the display's.
+#pragma once
+#include <Arduino.h>
+#include "font_tgx_Arial.h"
+
+namespace tgx {
+
+struct iVec2 {
+  int x, y;
+};
+
+struct iBox2 {
+  int minX, maxX, minY, maxY;
+};
+
+struct RGB32 {
+  uint32_t val;
+  constexpr RGB32(uint8_t r, uint8_t g, uint8_t b) : val(0xFF000000u | ((uint32_t)r << 16) | ((uint32_t)g << 8) | b) {}
+};
+
+struct RGB565 {
+  uint16_t val;
+  RGB565() : val(0) {}
+  constexpr RGB565(uint16_t value) : val(value) {}
+  constexpr RGB565(int r, int g, int b) : val((uint16_t)((r << 11) | (g << 5) | b)) {}
+  constexpr RGB565(RGB32 color) : val((uint16_t)(((color.val >> 8) & 0xF800) | ((color.val >> 5) & 0x07E0) | ((color.val >> 3) & 0x001F))) {}
+};
+
+constexpr RGB565 RGB565_Black(0, 0, 0), RGB565_White(31, 63, 31), RGB565_Red(31, 0, 0), RGB565_Green(0, 63, 0), RGB565_Blue(0, 0, 31),
+                 RGB565_Yellow(31, 63, 0), RGB565_CYAN(0, 63, 31), RGB565_Magenta(31, 0, 31), RGB565_Orange(31, 40, 0),
+                 RGB565_Gray(16, 32, 16), RGB565_Lime(0, 63, 0), RGB565_Navy(0, 0, 16), RGB565_Purple(16, 0, 16);
+constexpr RGB32 RGB32_Black(0, 0, 0), RGB32_White(255, 255, 255), RGB32_Gray(128, 128, 128), RGB32_Red(255, 0, 0), RGB32_Green(0, 255, 0),
+                RGB32_Blue(0, 0, 255), RGB32_Yellow(255, 255, 0);
+
+template<class COLOR> class Image {
+  COLOR* buffer;
+  int width, height;
+
+  void fill(int minX, int maxX, int minY, int maxY, COLOR color){
+    minX = max(minX, 0);
+    maxX = min(maxX, width - 1);
+    minY = max(minY, 0);
+    maxY = min(maxY, height - 1);
+    for(int y = minY; y <= maxY; y++){
+      for(int x = minX; x <= maxX; x++){
+        buffer[y*width + x] = color;
+      }
+    }
+  }
+
+public:
+  Image(void* pixels, int lx, int ly) : buffer((COLOR*)pixels), width(lx), height(ly) {}
+
+  int lx() const { return width; }
+  int ly() const { return height; }
+
+  template<class C> void clear(C color){
+    fill(0, width - 1, 0, height - 1, COLOR(color));
+  }
+
+  template<class C> void drawFastHLine(iVec2 pos, int w, C color, float = 1){
+    fill(pos.x, pos.x + w - 1, pos.y, pos.y, COLOR(color));
+  }
+
+  template<class C> void drawFastVLine(iVec2 pos, int h, C color, float = 1){
+    fill(pos.x, pos.x, pos.y, pos.y + h - 1, COLOR(color));
+  }
+
+  template<class C> void drawRect(const iBox2& box, C color, float = 1){
+    drawFastHLine({box.minX, box.minY}, box.maxX - box.minX + 1, color);
+    drawFastHLine({box.minX, box.maxY}, box.maxX - box.minX + 1, color);
+    drawFastVLine({box.minX, box.minY}, box.maxY - box.minY + 1, color);
+    drawFastVLine({box.maxX, box.minY}, box.maxY - box.minY + 1, color);
+  }
+
+  template<class C1, class C2> void fillThickRect(const iBox2& box, int thickness, C1 interior, C2 border, float = 1){
+    fill(box.minX, box.maxX, box.minY, box.maxY, COLOR(border));
+    fill(box.minX + thickness, box.maxX - thickness, box.minY + thickness, box.maxY - thickness, COLOR(interior));
+  }
+
+  // Draws from the baseline at pos and returns the position just after the text, as tgx does
+  template<class C> iVec2 drawText(const char* text, iVec2 pos, const ILI9341_t3_font_t& font, C color, float = 1){
+    const int scale = max(1, font.cap_height/5);
+    for(const char* c = text; *c != 0; c++){
+      if(*c != ' '){
+        uint32_t pattern = ((uint8_t)*c*2654435761u) >> 17; // 15 bits, one per block
+        for(int block = 0; block < 15; block++){
+          if(pattern & (1u << block)){
+            int x = pos.x + (block % 3)*scale;
+            int y = pos.y - font.cap_height + (block/3)*scale;
+            fill(x, x + scale - 1, y, y + scale - 1, COLOR(color));
+          }
+        }
+      }
+      pos.x += 4*scale;
+    }
+    return pos;
+  }
+};
+
+}
@@ -28,6 +28,7 @@ between these modes
 #include <tgx.h>                // An open source 2d & 3D graphics library for Teensy (draw rectangles, lines, etc.)
 #include "font_tgx_Arial.h"     // Fonts available through TGX
 #include <string.h>
+#include <stddef.h>
 #include <math.h>
 
 /* UI Libraries */
@@ -37,6 +38,20 @@ between these modes
 /* ADC Libraries */
 #include <ADC.h>                // ADC library for Teensy microcontroller. Allows greater utilization of the ADCs
 
+/* Calibration Libraries */
+#include <EEPROM.h>             // Teensy's emulated EEPROM, used to keep the calibration tables between power cycles
+
+/* Storage Libraries */
+#include <SD.h>                 // Teensy 4.1's built-in SD card slot, used for reference waveforms
+
+/* DSP Libraries */
+#if defined(__ARM_FEATURE_DSP)
+  #include <arm_math.h>         // CMSIS, for the Cortex-M7's packed 16-bit SIMD instructions (__SSUB16, __SEL, __SMLAD, ...)
+  #define DSP_SIMD true
+#else
+  #define DSP_SIMD false        // Scalar kernels (see DSP Kernel Functions)
+#endif
+
 
 #define runUI true
 #define debugging true
@@ -71,13 +86,19 @@ between these modes
 #define LX 320
 #define LY 240
 
+#define NUM_CHANNELS 2    // Channels carried through the processing, measurement and rendering stages (one per ADC when acquiring)
+
 double triggerVoltage = 1.23;
-double VScale = 10;
+double triggerHysteresis = 0; // Volts a signal must first drop below triggerVoltage for a rising crossing to trigger (0 = trigger on the first sample near triggerVoltage)
+double CH1_VScale = 10; // Volts per half-screen (120 pixels) for each channel
+double CH2_VScale = 10;
+int CH1_VPos = 0;       // Vertical position of each channel's 0 V line, in pixels above the screen's center
+int CH2_VPos = 0;
+bool CH1_AC = false;    // AC coupling emulation: the channel's mean (offset1/offset2) is removed before plotting
+bool CH2_AC = false;
 double HScale = 8E-6; //HScale is the time/unit as seen on the oscilloscope, with 1 unit = 10 pixels (i.e. time/10 indices of the raw data array)
-double CH1_P2P = 1;
-double CH1_T = 0.00081;
-double CH2_P2P = 1;
-double CH2_T = 0.00081;
+double CH_P2P[NUM_CHANNELS] = {1, 1};             // Each channel's peak-to-peak voltage...
+double CH_T[NUM_CHANNELS] = {0.00081, 0.00081};   // ...and period (seconds, -1 if none was found)
 
 int menuOptionsX1;
 int menuOptionsX2;
@@ -85,12 +106,21 @@ int menuOptionsY1;
 int menuOptionsY2;
 int menuOptionsYSpace;
 
-tgx::iVec2 sig1Points[LX];
-tgx::iVec2 sig2Points[LX];
-
 double sig1Data[LX];
 double sig2Data[LX];
 
+// Math channel's 320 plotted points (volts, or volts^2 for products), computed alongside sig1Data/sig2Data
+double mathData[LX];
+
+// Raw ADC values of the 320 plotted points, mapped straight to screen rows through the count -> pixel tables below
+uint16_t sigRaw[NUM_CHANNELS][LX];
+
+// Peak-detect columns: the lowest and highest raw value among all the record samples that fall into each screen column (see extractPeakColumns)
+uint16_t sig1ColMin[LX];
+uint16_t sig1ColMax[LX];
+uint16_t sig2ColMin[LX];
+uint16_t sig2ColMax[LX];
+
 
 String string_TrigVolt;
 
@@ -101,9 +131,40 @@ char* string_CH1_T = new char[30];
 char* string_CH2_P2P = new char[30];
 char* string_CH2_T = new char[30];
 
+// Display modes: the usual voltage vs time view, channel 1 (X) against channel 2 (Y) for phase/Lissajous checks, or the zoom (dual timebase) view
+#define DISPLAY_YT         0
+#define DISPLAY_XY         1
+#define DISPLAY_ZOOM       2
+#define DISPLAY_NUM_MODES  3
+
+const char* const displayModeNames[DISPLAY_NUM_MODES] = {"YT", "XY", "Zoom"};
+int displayMode = DISPLAY_YT;
+
+// Zoom view: the upper pane holds the whole record compressed into the screen width, the lower pane a window of it at the HScale timebase.
+// Both are peak-detect columns of the same stored record (see extractZoomOverview and extractZoomColumns), so panning and zooming never need a new acquisition.
+#define ZOOM_PANE_HEIGHT  (LY/2)
+#define ZOOM_PAN_STEPS    16 // Encoder steps needed to pan the window by its own width
+#define ZOOM_WINDOW_COLOR tgx::RGB565(31, 40, 0) // Orange
+
+int zoomOffset = 0;    // Record samples from the trigger to the start of the zoom window
+int zoomStart = 0;     // Record index of the window's first sample, as last used by extractZoomColumns()
+int zoomSamples = LX;  // Record samples the window covers
+bool zoomEncoders = false; // With the menu closed, the encoders pan the window (1) and change its timebase (2) instead of their usual job
+uint16_t zoomOverviewMin[NUM_CHANNELS][LX];
+uint16_t zoomOverviewMax[NUM_CHANNELS][LX];
+uint16_t zoomWindowMin[NUM_CHANNELS][LX];
+uint16_t zoomWindowMax[NUM_CHANNELS][LX];
+
+// XY mode draws every sample of the record and brightens a pixel each time it is hit again. The intensity lives in the green field of the
+// RGB565 pixel (bits 5-10), starting at XY_FIRST_HIT and stepping up by XY_HIT_STEP until it saturates at XY_MAX_HIT.
+#define XY_FIRST_HIT  (20 << 5)
+#define XY_HIT_STEP   (4 << 5)
+#define XY_MAX_HIT    (63 << 5)
+
 // Constants defining some font & color characteristics of different display components
 #define CH1_COLOR          GREEN
 #define CH2_COLOR          BLUE
+#define MATH_COLOR         tgx::RGB565(31, 0, 31) // Magenta
 #define MEAS_FONT          font_tgx_Arial_8
 #define TRIG_VOLT_FONT     font_tgx_Arial_8
 #define SCALE_FONT         font_tgx_Arial_8
@@ -142,11 +203,22 @@ tgx::Image<tgx::RGB565> oScopeImage(fb, 320, 240);
 
 #define MAX_TRIGGER           5.0 // Maximum trigger voltage value
 #define TRIGGER_Sensitivity   0.01 // The trigger voltage increment for every UI reigstered rotary increment
-#define MAX_HSCALE            102E-6
-#define MIN_HSCALE            8E-6
+#define MAX_HSCALE            900E-6 // Just inside a dual-channel record (HScaleMax)
+#define MIN_HSCALE            1E-6   // Below the shortest sampled timebase (HScaleMin), reached by interpolating
 #define HSCALE_Sensitivity    1E-6
+#define HSCALE_COARSE         100E-6 // From here up, HScale steps 10x HSCALE_Sensitivity
 #define MAX_VSCALE            20
 #define VSCALE_Sensitivity    0.1
+#define MAX_VPOS              (LY/2) // Furthest a channel's 0 V line can be moved from the center (pixels)
+#define VPOS_Sensitivity      2      // Pixels moved per registered rotary increment
+
+#define MAX_MATH_VSCALE       100
+#define MATH_VSCALE_Sensitivity 0.5
+
+#define MAIN_MENU_OPTIONS     11 // Channels, Trigger, Scaling, Position, Math, Display, Cursors, Acquire, Decode, Mask, Refs
+
+#define CURSOR_STEP_PIXELS    2 // Screen pixels a cursor moves per registered rotary increment
+#define CH_MENU_OPTIONS       9 // Show Wave 1/2, Show Meas 1/2, CH1/CH2 Coupling, Meas Stats, Reset Stats, Freq Counter
 
 
 // Variables for storing user interface menu navigation data
@@ -157,6 +229,7 @@ bool showMenu;
 // Variables for storing user interface "channels menu" navigation data, and channel display data
 int chDataSelecting;
 int chDataSelected;
+int scaleChannel = 0; // Which channel's VScale encoder 1 adjusts in the scaling menu (0 = channel 1, 1 = channel 2)
 bool showWave1 = true;
 bool showWave2 = true;
 bool showMeas1;
@@ -182,36 +255,278 @@ bool button4State = 0;
 
 
 
+/* Trigger Variables & Constants */
+
+// Trigger types. Edge is the level trigger of findTriggerIndex(); the others qualify positive-going events and are found by a streaming state
+// machine over the raw counts (see triggerScan):
+//   Width <, >, <>  a pulse (a rise to triggerVoltage after dropping below triggerVoltage - triggerHysteresis, and back) narrower than
+//                   triggerTime1, wider than triggerTime1, or between triggerTime1 and triggerTime2
+//   Runt            a pulse that rises to triggerVoltage and falls back below it without reaching triggerUpper
+//   Timeout         no crossing of triggerVoltage (with hysteresis) for longer than triggerTime1 after the last one
+//   Slew <, >       a rising edge from triggerVoltage to triggerUpper taking less / more than triggerTime1
+#define TRIG_EDGE         0
+#define TRIG_WIDTH_LT     1
+#define TRIG_WIDTH_GT     2
+#define TRIG_WIDTH_IN     3
+#define TRIG_RUNT         4
+#define TRIG_TIMEOUT      5
+#define TRIG_SLEW_LT      6
+#define TRIG_SLEW_GT      7
+#define TRIG_NUM_TYPES    8
+
+// Trigger sources. The source's trigger index places both channels, so they stay aligned to the same instant.
+#define TRIG_SRC_CH1      0
+#define TRIG_SRC_CH2      1
+#define TRIG_SRC_EXT      2 // Rising edge on EXT_TRIG_PIN
+#define TRIG_SRC_FREE     3 // Free-run: records are shown from their first sample
+#define TRIG_NUM_SOURCES  4
+#define EXT_TRIG_PIN      6 // GPIO_B0_10, QTIMER4_TIMER1 on ALT1
+
+// Trigger menu entries (encoder 1 picks one, encoder 2 changes it)
+#define TRIG_ITEM_LEVEL   0
+#define TRIG_ITEM_SOURCE  1
+#define TRIG_ITEM_TYPE    2
+#define TRIG_ITEM_UPPER   3
+#define TRIG_ITEM_TIME1   4
+#define TRIG_ITEM_TIME2   5
+#define TRIG_ITEM_HYST    6 // Set by autoset, adjustable (or zeroed) here
+#define TRIG_NUM_ITEMS    7
+
+#define TRIG_TIME_STEP    1.25    // Factor a trigger time changes by per registered rotary increment
+#define MIN_TRIG_TIME     0.5E-6
+#define MAX_TRIG_TIME     5E-3
+
+// States of the streaming trigger
+#define TRIG_ST_UNKNOWN   0 // Waiting for the signal to first go low
+#define TRIG_ST_LOW       1
+#define TRIG_ST_MID       2 // Risen to the lower threshold but not (yet) the upper one (runt and slew)
+#define TRIG_ST_HIGH      3
+
+// A streaming trigger's settings (as counts and samples) and where it is up to. Indexes are record indexes, so a record can be fed in chunks.
+struct TriggerScanner {
+  uint8_t type;
+  uint8_t state;
+  int mark;                      // Record index the current pulse, edge or level started at (-1 before the first crossing)
+  int lowFirst, lowLast;         // Counts below the lower threshold
+  int notLowFirst, notLowLast;   // Counts at or above the lower threshold
+  int highFirst, highLast;       // Counts at or above the upper threshold
+  int time1, time2;              // triggerTime1/2 in samples
+};
+
+const char* const triggerTypeNames[TRIG_NUM_TYPES] = {"Edge", "Width <", "Width >", "Width <>", "Runt", "Timeout", "Slew <", "Slew >"};
+const char* const triggerSourceNames[TRIG_NUM_SOURCES] = {"CH1", "CH2", "Ext", "Free"};
+int triggerType = TRIG_EDGE;
+int triggerSource = TRIG_SRC_CH1;
+int triggerMenuItem = TRIG_ITEM_LEVEL;
+double triggerUpper = 2.5;     // Upper threshold of the runt and slew triggers (volts)
+double triggerTime1 = 10E-6;   // Seconds
+double triggerTime2 = 50E-6;
+
+// External trigger. EXT_TRIG_PIN is a QuadTimer 4 input: channels 0 and 1 both capture its first rising edge after a record is armed, in
+// hardware, and the edge is placed in the record using the timer's values at the record's start and end (taken by sampleChannels, see
+// externalTriggerPosition). Channel 0 counts the 150 MHz IP bus clock / 128 and channel 1 / 8; together they make one clock of 53 ns ticks
+// that wraps every 55.9 ms (see extTrigTicks), which a record has to fit in.
+#define EXT_TRIG_CLOCK_MASK 0xFFFFF
+bool extTrigAttached = false;
+uint32_t recordStartStamp = 0; // External trigger clock at the record's first sample...
+uint32_t recordEndStamp = 0;   // ...and one sample past its last
+
+/**/
+
+
+
+
+/* Cursor Variables & Constants */
+
+// Cursor modes. Time cursors are a pair of vertical lines (delta T, 1/delta T, and delta V of cursorChannel's trace between them); voltage
+// cursors are a pair of horizontal lines on cursorChannel's scale (delta V). With the menu closed, encoder 1/2 move cursor 1/2.
+#define CURSOR_OFF      0
+#define CURSOR_TIME     1
+#define CURSOR_VOLT     2
+#define CURSOR_NUM_MODES 3
+#define CURSOR_COLOR    YELLOW
+
+int cursorMode = CURSOR_OFF;
+int cursorChannel = 0;      // Channel the voltage readouts are taken from (0 = channel 1, 1 = channel 2)
+int cursorT1 = 80;          // Time cursor positions, in record samples after the plotted window's first sample
+int cursorT2 = 240;
+double cursorV1 = 1.0;      // Voltage cursor levels (volts)
+double cursorV2 = -1.0;
+
+// Cursor readouts, recomputed from the full-resolution record by updateCursorReadouts()
+double cursorDeltaT = 0;
+double cursorDeltaV = 0;
+
+/**/
+
+
+
+
+/* Measurement Statistics Variables & Constants */
+
+// Running statistics of each measurement across acquisitions, kept with Welford's online algorithm (a running mean and sum of squared
+// deviations) so the spread stays accurate however many acquisitions are accumulated
+#define STAT_CH1_P2P  0
+#define STAT_CH1_T    1
+#define STAT_CH2_P2P  2
+#define STAT_CH2_T    3
+#define NUM_STATS     4
+
+struct MeasStats {
+  uint32_t count;
+  double mean;
+  double m2;    // Sum of squared deviations from the mean
+  double min;
+  double max;
+};
+
+MeasStats measStats[NUM_STATS];
+bool showStats = false; // Measurements are shown as mean +/- sigma (with the count) instead of the latest value
+
+/**/
+
+
+
+
+/* Math Channel Variables & Constants */
+
+// Math channel operations. Every operation is "compiled" into the same quadratic in A (channel 1 volts) and B (channel 2 volts), so
+// evaluating it costs the same handful of multiply-adds per point whatever was selected:
+//   math = c[0] + c[1]*A + c[2]*B + c[3]*A*B + c[4]*A*A + c[5]*B*B
+#define MATH_OFF      0
+#define MATH_ADD      1 // A + B
+#define MATH_SUB      2 // A - B (differential)
+#define MATH_MUL      3 // A * B (power, with a current probe on one channel)
+#define MATH_EXPR     4 // User expression (set over serial with "math <expression>")
+#define MATH_NUM_OPS  5
+#define MATH_TERMS    6
+
+int mathOp = MATH_OFF;
+double mathVScale = 10;               // Math units per half-screen (120 pixels)
+float mathPoly[MATH_TERMS] = {0};     // Coefficients of the selected operation (see above)
+float mathExprPoly[MATH_TERMS] = {0, 0, 0, 1, 0, 0}; // Coefficients of the last user expression that compiled
+char mathExprText[32] = "A*B";        // Text of that expression, for display
+uint32_t mathVersion = 0;             // Bumped whenever mathPoly is set (see setMathOp), so the plotting stage redoes the math channel
+
+/**/
+
+
+
+
+/* Interpolation Variables & Constants */
+
+// Reconstruction of the points between samples, for timebases shorter than one sample per screen column (stride < 1). Sin(x)/x uses a
+// Lanczos-windowed sinc, precomputed as a polyphase table: INTERP_PHASES sets of INTERP_TAPS coefficients, one set per fraction of a sample.
+#define INTERP_OFF        0 // Nearest sample (a staircase)
+#define INTERP_LINEAR     1
+#define INTERP_SINC       2
+#define INTERP_NUM_MODES  3
+#define INTERP_TAPS       8  // Samples each point is made from (4 either side)
+#define INTERP_PHASES     32 // Fractions of a sample a point can be placed at
+#define INTERP_FRAC_BITS  14 // Fixed point fraction bits of the sinc coefficients
+#define INTERP_MAX_ZOOM   8  // Screen columns per sample at the shortest interpolated timebase
+
+const char* const interpModeNames[INTERP_NUM_MODES] = {"Off", "Linear", "Sinc"};
+int interpMode = INTERP_SINC;
+int16_t sincTable[INTERP_PHASES][INTERP_TAPS]; // Built by buildSincTable()
+
+/**/
+
+
+
+
 /* ADC Variables & Constants */
 
-#define NUM_SAMPLES 4000 // for 4000 samples, the usable HScale range is 8.153 us to 101.9 us
+#define NUM_SAMPLES 24000 // Record depth: 6x the 4000 samples the same RAM held unpacked (see SAMPLE_STORE_BYTES). The usable HScale range is
+                          // 1.533 us (INTERP_MAX_ZOOM, 12.27 us uninterpolated) to 900 us (MAX_HSCALE)
+#if NUM_SAMPLES % 2
+#error "NUM_SAMPLES must be even so interleaved records split evenly between the two ADCs"
+#endif
+#if NUM_SAMPLES > 65536
+#error "The protocol decoder keeps record indexes (edges, annotations) as uint16_t"
+#endif
 #define CH1_PIN 41
 #define CH2_PIN 23
 
 #define ADC_RESOLUTION    10      // Resolution in bits
+#define ADC_MAX_COUNT     ((1 << ADC_RESOLUTION) - 1) // Largest raw value the ADCs can return (1023 @ 10 bits)
+#define PROC_EXTRA_BITS   2       // Bits kept below the ADC's LSB once a record is processed, so averaging/high-res gains aren't rounded away
+#define PROC_MAX_CODE     (((ADC_MAX_COUNT + 1) << PROC_EXTRA_BITS) - 1) // Largest processed value (4095 @ 10 bits)
 #define ADC_OVERSAMPLING  0      // 
 #define SAMPLING_INTERVAL 1      // microseconds
 
 #define upperVoltage 5
 #define lowerVoltage -5
 
+#define ADC_SAMPLE_DT         1.2265E-6 // Time for one synchronized conversion on a single ADC (seconds)
+#define INTERLEAVE_PHASE_NS   613       // Delay between starting ADC0 and ADC1 in interleaved mode (half of ADC_SAMPLE_DT, in ns)
+#define INTERLEAVE_SMOOTHING  8         // Number of acquisitions the interleave gain/offset estimate is averaged over
+
+// Acquisition modes. In the interleaved modes both ADCs sample the same pin half a conversion apart, and the results are
+// woven together into a single record at twice the sample rate.
+#define ACQ_DUAL            0 // ADC0 -> channel 1, ADC1 -> channel 2 (synchronized)
+#define ACQ_INTERLEAVE_CH1  1 // ADC0 & ADC1 -> channel 1
+#define ACQ_INTERLEAVE_CH2  2 // ADC0 & ADC1 -> channel 2
+
+
+// Acquisition processing, applied to each freshly sampled record by processAcquisition(). All modes leave the record in processed
+// counts (ADC counts << PROC_EXTRA_BITS); the averaging and high-res modes fill in those extra bits.
+#define PROC_NORMAL       0 // Single acquisition
+#define PROC_AVG_EXP      1 // Exponential average, time constant of avgCount acquisitions
+#define PROC_AVG_BLOCK    2 // Block average of avgCount acquisitions (restarts every avgCount acquisitions)
+#define PROC_HIRES        3 // Boxcar average of avgCount adjacent samples (extra bits from a single acquisition, at reduced bandwidth)
+#define PROC_NUM_MODES    4
+#define AVG_MAX_LOG2      8  // Up to 256 acquisitions averaged
+#define HIRES_MAX_LOG2    6  // Up to 64 adjacent samples averaged
+#define AVG_FRAC_BITS     16 // Fraction bits of the exponential average's accumulators
+
+int procMode = PROC_NORMAL;
+int avgLog2 = 4;      // avgCount = 1 << avgLog2
+int avgAcquired = 0;  // Acquisitions accumulated so far (0 restarts the average)
+
+// One 32-bit accumulator per sample for the averaging modes (kept in the second RAM bank, beside fb_internal)
+DMAMEM int32_t avgAccum[NUM_CHANNELS][NUM_SAMPLES];
+
+
+// Limits that follow from a record's depth. extractPlottingData() spreads 32*HScale/sampleDt samples across the screen, so the longest
+// timebase is the one that shows the whole record and the shortest is the one that still has a sample for every column (stride 1).
+template<int RECORD_LENGTH>
+struct RecordLimits {
+  static_assert(RECORD_LENGTH >= LX, "A record must hold at least one sample per screen column");
+  static_assert(RECORD_LENGTH % 2 == 0, "A record must split evenly between the two ADCs when interleaved");
+  static_assert(RECORD_LENGTH*ADC_SAMPLE_DT < (EXT_TRIG_CLOCK_MASK + 1)*8/150E6, "A record must fit in one wrap of the external trigger clock");
+
+  static constexpr double hscaleMax(double dt){ return (RECORD_LENGTH*1.0*dt)/32; }
+  static constexpr double hscaleMin(double dt){ return (LX*1.0*dt)/32; }
+  static constexpr double maxStride(){ return RECORD_LENGTH/(LX*1.0); } // Record samples per screen column at hscaleMax
+  static constexpr double minStride(){ return 1.0; }                   // ...and at hscaleMin
+};
+
+double sampleDt = ADC_SAMPLE_DT; // 1.2265 micro seconds = time to sample one data point from an ADC (time different (Dt) between each index in the sample array)
 
+double HScaleMax = RecordLimits<NUM_SAMPLES>::hscaleMax(ADC_SAMPLE_DT); // 919.9 microseconds @ NUM_SAMPLES = 24000
+double HScaleMin = RecordLimits<NUM_SAMPLES>::hscaleMin(ADC_SAMPLE_DT); // 12.265 microseconds
 
-double sampleDt = 1.2265-6; // 0.81533 micro second = time to sample one data point from an ADC (time different (Dt) between each index in the sample array)
+int acqMode = ACQ_DUAL;
+bool interleaveCH1Available = false; // Set in setup() if CH1_PIN can be routed to both ADCs
+bool interleaveCH2Available = false; // Set in setup() if CH2_PIN can be routed to both ADCs
 
-double HScaleMax = ((NUM_SAMPLES*1.0)*sampleDt)/32; // 153.31 microsecond @ NUM_SAMPLES = 4000
-double HScaleMin = (sampleDt*10.0); // 12.265 microseconds @ NUM_SAMPLES = 4000
+// Gain/offset applied to the ADC1 half of an interleaved record so that it matches ADC0 (ADC1 * gain + offset)
+double interleaveGain = 1.0;
+double interleaveOffset = 0.0;
 
-int rawData1[NUM_SAMPLES];
-int rawData2[NUM_SAMPLES];
-double voltageData1[NUM_SAMPLES];
-double voltageData2[NUM_SAMPLES];
-double offset1 = 0;
+typedef int16_t sample_t; // One record sample: ADC counts as sampled, processed counts once processAcquisition() has run. The record itself
+                          // is held packed in the sample store; sample_t is what the stages unpack it to.
+
+double offset1 = 0; // Mean voltage of each channel's record, updated by updateVoltageData()
 double offset2 = 0;
 
 
-int sig1TrigIndex = 0;
-int sig2TrigIndex = 0;
+double plotStride = 1; // Record samples per screen column, as last used by extractPlottingData()
+
+int trigIndex = 0; // Record index of the trigger, which both channels are plotted from (0 when untriggered or free-running)
+double trigPosition = 0; // Where the trigger fell between samples (trigIndex - 1 < trigPosition <= trigIndex), for interpolated traces
+bool plotInterpolated = false; // The plotted points were interpolated, starting at trigPosition rather than trigIndex
 
 int startTime;
 int elapsedTime;
@@ -222,6 +537,509 @@ ADC *adc = new ADC();
 /**/
 
 
+
+
+/* Sample Store Variables & Constants */
+
+// The record. Both channels live in one compact store, channel-interleaved (ch1, ch2, ch1, ...) the way the ADCs deliver them and bit-packed:
+// sampleChannels() writes each sample straight into it, and the stages unpack (and de-interleave) a window of one channel at a time. Kept
+// unpacked, as sample_t plus a double voltage, a record took 10 bytes per sample per channel; packed to STORE_RECORD_BITS it takes 1.5, so
+// the RAM that held UNPACKED_DEPTH samples per channel holds NUM_SAMPLES.
+#define STORE_U16         0 // One uint16_t per sample
+#define STORE_PACK_PROC   1 // Bit-packed processed counts (ADC_RESOLUTION + PROC_EXTRA_BITS bits, 12 @ 10-bit)
+#define STORE_PACK_ADC    2 // Bit-packed ADC counts (ADC_RESOLUTION bits, 10 @ 10-bit). Drops the processing's extra bits
+#define STORE_NUM_LAYOUTS 3
+
+#define STORE_PROC_BITS    (ADC_RESOLUTION + PROC_EXTRA_BITS)
+#define STORE_ADC_BITS     ADC_RESOLUTION
+#define STORE_RECORD_BITS  STORE_PROC_BITS // The record's layout: the narrowest that keeps processed counts whole
+#define SAMPLE_STORE_WORDS ((NUM_CHANNELS*NUM_SAMPLES*STORE_RECORD_BITS + 31)/32)
+#define SAMPLE_STORE_BYTES (SAMPLE_STORE_WORDS*4)
+#define UNPACKED_DEPTH     4000 // Samples per channel the same RAM held as sample_t records plus their double voltages
+#define RECORD_WINDOW      480  // Samples per channel a stage unpacks at a time
+
+static_assert(STORE_PROC_BITS <= 16, "Processed counts must fit the uint16_t layout");
+static_assert(SAMPLE_STORE_BYTES <= NUM_CHANNELS*UNPACKED_DEPTH*(sizeof(sample_t) + sizeof(double)), "The record must fit the RAM it replaced");
+static_assert(RECORD_WINDOW >= (1 << HIRES_MAX_LOG2), "The high-res filter is primed from the first window");
+
+const int storeLayoutBits[STORE_NUM_LAYOUTS] = {16, STORE_PROC_BITS, STORE_ADC_BITS};
+
+uint32_t sampleStore[SAMPLE_STORE_WORDS + 1]; // A field is read and written as the two words it can straddle, so one spare word follows
+
+/**/
+
+
+
+
+/* Capture Replay Variables & Constants */
+
+// A capture is a run of processed records streamed to CAPTURE_FILE on the SD card, each packed in one of the store's layouts (captureLayout:
+// the record's own layout is a straight image of the sample store, the others are converted a window at a time). It can be copied to / from
+// the serial port or a numbered slot on the card, and replayed through the pipeline in place of the ADCs, a record at a time.
+#define CAPTURE_MAGIC    0x43415054 // "CAPT"
+#define CAPTURE_VERSION  3
+#define CAPTURE_FILE     "CAPTURE.BIN"
+#define CAPTURE_NUM_SLOTS 10        // Saved copies of CAPTURE_FILE, as CAPTn.BIN
+#define CAPTURE_CHUNK_WORDS (RECORD_WINDOW*NUM_CHANNELS*16/32) // RECORD_WINDOW samples per channel in the widest layout
+#define REPLAY_FRAMES_FILE "FRAMES.RAW" // Rendered frames from benchmarkReplay, raw RGB565 LX x LY back to back
+
+// Written ahead of the records
+struct CaptureHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint8_t layout;       // STORE_ value the records are packed in
+  uint8_t channels;     // NUM_CHANNELS when captured
+  uint32_t records;     // Records that follow, captureRecordBytes(layout) each
+  uint32_t recordLength; // NUM_SAMPLES when captured
+  uint32_t acqMode;     // ACQ_ value the records were sampled in
+  float sampleDt;
+};
+
+File captureFile;              // CAPTURE_FILE while recording or replaying
+bool captureRecording = false; // Append every processed acquisition to the capture
+bool replaying = false;        // Take records from the capture instead of the ADCs
+uint32_t captureRecords = 0;   // Records in the capture being recorded or replayed
+uint32_t replayPosition = 0;   // Next record to replay
+int captureAcqMode = ACQ_DUAL; // Acquisition mode of the capture's records
+int captureLayout = STORE_PACK_PROC; // Layout new captures are written in
+int replayLayout = STORE_PACK_PROC;  // Layout of the capture being replayed
+
+static_assert(STORE_RECORD_BITS == STORE_PROC_BITS, "A STORE_PACK_PROC capture record is a straight image of the sample store");
+static_assert(NUM_SAMPLES % RECORD_WINDOW == 0 && (RECORD_WINDOW*NUM_CHANNELS*STORE_ADC_BITS) % 32 == 0
+              && (RECORD_WINDOW*NUM_CHANNELS*STORE_PROC_BITS) % 32 == 0, "Capture records are converted in whole windows of whole words");
+
+/**/
+
+
+
+
+/* Frame Regression Variables & Constants */
+
+// Golden-frame render tests: each scenario (a standard waveform pair plus a menu state and overlays) is rendered into fb and its CRC-32 is
+// compared against the one recorded on the SD card. A failing scenario's frame and a diff against the recorded golden frame are written
+// out as BMP images. Every setting that changes what is drawn is pinned while they run (see DisplayState), so a frame only depends on the
+// code that draws it. Hashes only hold for the renderer they were recorded with: the ones in host/golden come from the host build's
+// stand-in glyphs (host/stubs/tgx.h), so a unit records its own with "testframes record".
+#define GOLDEN_MAGIC       0x444C4F47 // "GOLD"
+#define GOLDEN_FILE        "GOLDEN.BIN"
+#define FRAME_DIFF_COLOR   RED        // Pixels that differ from the golden frame, in the diff image
+#define FRAME_BMP_HEADER   66         // BMP file header + BITMAPINFOHEADER + the three RGB565 bit masks
+
+// Standard waveform pairs the scenarios are rendered with
+#define FRAME_WAVE_SINE_SQUARE  0
+#define FRAME_WAVE_SQUARE_SINE  1
+#define FRAME_WAVE_FLAT         2
+
+// Overlays a scenario turns on
+#define FRAME_SHOW_MEAS      0x01
+#define FRAME_SHOW_STATS     0x02
+#define FRAME_SHOW_TCURSORS  0x04
+#define FRAME_SHOW_VCURSORS  0x08
+#define FRAME_SHOW_MATH      0x10
+#define FRAME_SHOW_XY        0x20
+#define FRAME_SHOW_ZOOM      0x40  // Zoom view, the window panned FRAME_ZOOM_OFFSET samples past the trigger
+#define FRAME_SHOW_REF       0x80  // Channel 2's trace held in reference slot 1, drawn against channel 1
+#define FRAME_SHOW_MASK      0x100 // A mask made from the record, under test with FRAME_MASK_PASSES/FRAME_MASK_FAILS counted
+
+#define FRAME_ZOOM_OFFSET    1500
+#define FRAME_MASK_PASSES    41
+#define FRAME_MASK_FAILS     1
+
+struct FrameScenario {
+  const char* name;
+  uint8_t wave;      // FRAME_WAVE_ value
+  int8_t menu;       // menuSelected with the menu open (0 = main menu), or -1 for the menu closed
+  int8_t subMenu;    // chDataSelected, in the channels menu
+  uint16_t overlays; // FRAME_SHOW_ flags
+  uint8_t trigType = TRIG_EDGE;
+  uint8_t trigSource = TRIG_SRC_CH1;
+};
+
+const FrameScenario frameScenarios[] = {
+  {"Sine + square",      FRAME_WAVE_SINE_SQUARE, -1, 0, 0},
+  {"Square + sine",      FRAME_WAVE_SQUARE_SINE, -1, 0, 0},
+  {"Flat",               FRAME_WAVE_FLAT,        -1, 0, 0},
+  {"Measurements",       FRAME_WAVE_SINE_SQUARE, -1, 0, FRAME_SHOW_MEAS},
+  {"Statistics",         FRAME_WAVE_SINE_SQUARE, -1, 0, FRAME_SHOW_MEAS | FRAME_SHOW_STATS},
+  {"Time cursors",       FRAME_WAVE_SINE_SQUARE, -1, 0, FRAME_SHOW_TCURSORS},
+  {"Voltage cursors",    FRAME_WAVE_SQUARE_SINE, -1, 0, FRAME_SHOW_VCURSORS},
+  {"Math A-B",           FRAME_WAVE_SINE_SQUARE, -1, 0, FRAME_SHOW_MATH},
+  {"XY",                 FRAME_WAVE_SINE_SQUARE, -1, 0, FRAME_SHOW_XY},
+  {"Main menu",          FRAME_WAVE_SINE_SQUARE, 0,  0, 0},
+  {"Channels menu",      FRAME_WAVE_SINE_SQUARE, 1,  0, 0},
+  {"Show Wave 1",        FRAME_WAVE_SINE_SQUARE, 1,  1, 0},
+  {"Meas Stats",         FRAME_WAVE_SINE_SQUARE, 1,  7, 0},
+  {"Trigger menu",       FRAME_WAVE_SINE_SQUARE, 2,  0, 0},
+  {"Scaling menu",       FRAME_WAVE_SINE_SQUARE, 3,  0, 0},
+  {"Position menu",      FRAME_WAVE_SINE_SQUARE, 4,  0, 0},
+  {"Math menu",          FRAME_WAVE_SINE_SQUARE, 5,  0, 0},
+  {"Display menu",       FRAME_WAVE_SINE_SQUARE, 6,  0, 0},
+  {"Cursors menu",       FRAME_WAVE_SINE_SQUARE, 7,  0, FRAME_SHOW_TCURSORS},
+  {"Acquire menu",       FRAME_WAVE_SINE_SQUARE, 8,  0, 0},
+  {"Decode menu",        FRAME_WAVE_SINE_SQUARE, 9,  0, 0},
+  {"Mask menu",          FRAME_WAVE_SINE_SQUARE, 10, 0, 0},
+  {"Refs menu",          FRAME_WAVE_SINE_SQUARE, 11, 0, 0},
+  {"Zoom",               FRAME_WAVE_SINE_SQUARE, -1, 0, FRAME_SHOW_ZOOM},
+  {"Runt trigger",       FRAME_WAVE_SINE_SQUARE, 2,  0, 0, TRIG_RUNT},
+  {"Slew trigger",       FRAME_WAVE_SQUARE_SINE, -1, 0, 0, TRIG_SLEW_LT},
+  {"Ext trigger",        FRAME_WAVE_SINE_SQUARE, -1, 0, 0, TRIG_EDGE, TRIG_SRC_EXT},
+  {"Free run",           FRAME_WAVE_SINE_SQUARE, -1, 0, 0, TRIG_EDGE, TRIG_SRC_FREE},
+  {"Reference",          FRAME_WAVE_SINE_SQUARE, -1, 0, FRAME_SHOW_REF},
+  {"Refs menu + ref",    FRAME_WAVE_SINE_SQUARE, 11, 0, FRAME_SHOW_REF},
+  {"Mask",               FRAME_WAVE_SINE_SQUARE, -1, 0, FRAME_SHOW_MASK},
+  {"Mask menu + mask",   FRAME_WAVE_SINE_SQUARE, 10, 0, FRAME_SHOW_MASK},
+};
+
+#define FRAME_NUM_SCENARIOS ((int)(sizeof(frameScenarios)/sizeof(frameScenarios[0])))
+static_assert(FRAME_NUM_SCENARIOS <= 100, "Frame file names (GOLDnn.BMP, FAILnn.BMP, DIFFnn.BMP) have room for two digits");
+
+// What GOLDEN_FILE holds
+struct GoldenHashes {
+  uint32_t magic;
+  uint32_t count;
+  uint32_t crc[FRAME_NUM_SCENARIOS];
+};
+
+/**/
+
+
+
+
+/* Protocol Decoder Variables & Constants */
+
+// Protocols the two channels can be decoded as. UART decodes each channel as its own line (e.g. TX on CH1, RX on CH2); SPI takes CH1 as SCK and
+// CH2 as MOSI (mode 0, MSB first, no chip select so words are framed by pauses in the clock); I2C takes CH1 as SCL and CH2 as SDA.
+#define DECODE_OFF            0
+#define DECODE_UART           1
+#define DECODE_SPI            2
+#define DECODE_I2C            3
+#define DECODE_NUM_PROTOCOLS  4
+#define DECODE_MAX_EDGES      1024 // Per channel, per record
+#define DECODE_MAX_ANNOTATIONS 64
+#define DECODE_HYSTERESIS     0.1  // Volts either side of decodeThreshold a signal has to cross to count as an edge
+#define DECODE_SPI_GAP        4    // A pause of this many clock periods ends an SPI word
+#define DECODE_THRESHOLD_Sensitivity 0.05
+#define DECODE_COLOR          tgx::RGB565(31, 40, 0) // Orange
+
+// Annotation flags
+#define ANNOT_ADDRESS  0x01 // I2C address byte
+#define ANNOT_NACK     0x02 // I2C byte that wasn't acknowledged
+#define ANNOT_ERROR    0x04 // UART framing error, or an SPI word cut short
+#define ANNOT_START    0x08 // I2C start condition
+#define ANNOT_STOP     0x10 // I2C stop condition
+
+// One decoded byte (or bus condition), spanning record samples start to end
+struct DecodeAnnotation {
+  uint16_t start;
+  uint16_t end;
+  uint8_t value;
+  uint8_t flags;
+  uint8_t row;    // 0 = drawn by channel 1's row, 1 = by channel 2's
+};
+
+int decodeProtocol = DECODE_OFF;
+const char* const decodeProtocolNames[DECODE_NUM_PROTOCOLS] = {"Off", "UART", "SPI", "I2C"};
+double decodeThreshold = 1.65; // Logic threshold (volts)
+const long decodeBaudRates[] = {9600, 19200, 38400, 57600, 115200, 230400};
+#define DECODE_NUM_BAUDS 6
+int decodeBaudIndex = 4;
+
+// Each record is thresholded into a list of edges (sample indexes where the logic level toggles), which is all the decoders look at
+uint16_t decodeEdges[2][DECODE_MAX_EDGES];
+int decodeNumEdges[2];
+bool decodeStartLevel[2];   // Logic level at the start of the record
+int decodeHighCode[2];      // Processed count at/above which (after decodeFlip) a channel is high
+int decodeLowCode[2];       // Processed count below which (after decodeFlip) a channel is low
+int decodeFlip[2];          // PROC_MAX_CODE for an inverting front end (counts fall as volts rise), else 0
+double decodeThresholdBuilt = -1000; // decodeThreshold the codes were found for
+int decodeVoltageVersion = -1;       // voltageLUTVersion the codes were found for
+
+DecodeAnnotation decodeAnnotations[DECODE_MAX_ANNOTATIONS];
+int decodeNumAnnotations = 0;
+
+/**/
+
+
+
+
+/* Calibration Variables & Constants */
+
+#define CAL_EEPROM_ADDR   0           // EEPROM address the calibration block is stored at
+#define CAL_MAGIC         0x4C41434D  // "MCAL", marks an EEPROM block as a moscilloscope calibration
+#define CAL_VERSION       1           // Bump whenever CalibrationData's layout changes (old blocks are then ignored)
+#define CAL_NUM_POINTS    3           // Number of reference levels measured per calibration
+#define CAL_AVERAGES      256         // ADC reads averaged for each reference level
+#define CAL_LINEARITY     true        // Apply the per-point residuals (linearity LUT) on top of the gain/offset fit
+
+#define CAL_ADC0  0
+#define CAL_ADC1  1
+
+// Known voltages the user applies to the probe tip during calibration (from a bench supply, in volts)
+const double calRefVoltages[CAL_NUM_POINTS] = {-2.5, 0.0, 2.5};
+
+// Calibration of one signal path (a channel's front end feeding one of the two ADCs): volts = gain*count + offset + residual(count)
+struct CalibrationPath {
+  float gain;
+  float offset;
+  float refCount[CAL_NUM_POINTS]; // Average count measured at each reference level (sorted ascending)
+  float residual[CAL_NUM_POINTS]; // Reference voltage minus the linear fit at each refCount
+  uint8_t valid;                  // 1 if this path was measured, 0 if it holds the ideal mapping
+};
+
+// Everything stored in EEPROM. The front end has a single input range, so "per range" tables are kept per ADC path instead: each channel
+// can be converted by either ADC (the second one only in interleaved mode), and the two ADCs differ.
+struct CalibrationData {
+  uint32_t magic;
+  uint16_t version;
+  CalibrationPath path[2][2]; // [channel][ADC]
+  uint32_t crc;
+};
+
+CalibrationData calData;
+
+// Count -> volts lookup tables, rebuilt from calData whenever the calibration or acquisition mode changes. Like every table indexed by
+// the record, these are indexed by processed counts (ADC counts with PROC_EXTRA_BITS extra bits, see processAcquisition()).
+float countToVolts1[PROC_MAX_CODE + 1];
+float countToVolts2[PROC_MAX_CODE + 1];
+int voltageLUTVersion = 0; // Incremented every time the count -> volts tables are rebuilt
+
+// Count -> screen row lookup tables (calibration, VScale, vertical position, AC coupling and clipping folded in). Rebuilt by updatePixelLUTs()
+// only when an input changes. The state each table was last built for is kept per channel ([0] = channel 1, [1] = channel 2).
+uint8_t countToPixel1[PROC_MAX_CODE + 1];
+uint8_t countToPixel2[PROC_MAX_CODE + 1];
+uint16_t countToColumn1[PROC_MAX_CODE + 1]; // Channel 1 count -> screen column, for the XY display
+double pixelLUTVScale[2] = {-1, -1};
+int pixelLUTVPos[2] = {0, 0};
+int pixelLUTDCPixels[2] = {0, 0};             // Removed DC level, in whole pixels (0 when DC coupled)
+int pixelLUTVoltageVersion[2] = {-1, -1};
+int pixelLUTBuild[2] = {0, 0};                // Incremented every time a channel's table is rebuilt
+#define AC_REBUILD_HYSTERESIS 0.75            // Pixels the mean has to drift before an AC coupled channel's table is rebuilt
+
+bool interleaveCalibrated = false; // True if the interleave gain/offset came from calData rather than being estimated
+
+/**/
+
+
+
+
+/* Mask Test Variables & Constants */
+
+// A mask is a per-column min/max band (in processed counts) around a golden capture. Each acquisition's peak-detect columns are compared
+// against it, so a test costs two compares per column per channel. The mask is kept in EEPROM right after the calibration block.
+#define MASK_EEPROM_ADDR  (CAL_EEPROM_ADDR + sizeof(CalibrationData))
+#define MASK_MAGIC        0x4B53414D // "MASK"
+#define MASK_VERSION      2          // 2: the timebase is kept as an HScale step index, not a float
+#define MAX_MASK_TOLERANCE 2.0       // Volts
+#define MASK_TOLERANCE_Sensitivity 0.05
+#define MASK_COLOR        tgx::RGB565(10, 20, 10) // Dim gray-green
+#define MASK_FAIL_COLOR   RED
+
+// Mask menu entries (encoder 2 picks one, its button acts on it)
+#define MASK_ITEM_TEST    0 // Testing on/off
+#define MASK_ITEM_STOP    1 // Stop acquiring on the first failure
+#define MASK_ITEM_MAKE    2 // Make a new mask from the current capture
+#define MASK_ITEM_RESET   3 // Clear the counters (and restart acquisition)
+#define MASK_NUM_ITEMS    4
+
+struct MaskData {
+  uint32_t magic;
+  uint16_t version;
+  uint8_t channels;     // Bit 0 = channel 1 is tested, bit 1 = channel 2
+  int32_t hscaleStep;   // HScale the mask was made at, as hscaleStep() (its columns only line up with captures at this timebase)
+  uint16_t low[2][LX];  // [channel][column], processed counts
+  uint16_t high[2][LX];
+  uint32_t crc;
+};
+
+static_assert(MASK_EEPROM_ADDR + sizeof(MaskData) <= E2END + 1, "Mask does not fit in EEPROM after the calibration block");
+
+MaskData maskData;
+bool maskValid = false;
+bool maskTesting = false;
+bool maskStopOnFail = false;
+bool maskMakePending = false;  // Set by the UI, the mask is made by the next runMaskTest()
+double maskTolerance = 0.2;    // Volts added either side of the golden capture when a mask is made
+int maskMenuItem = MASK_ITEM_TEST;
+uint32_t maskPassCount = 0;
+uint32_t maskFailCount = 0;
+bool maskLastFailed = false;
+int maskFailColumn = -1;       // First failing column of the last failed test
+
+// Copy of the most recent failing capture (the packed record as it stood), dumped over serial by printMaskFailure()
+DMAMEM uint32_t maskFailRecord[SAMPLE_STORE_WORDS + 1];
+int maskFailTrigIndex;
+bool maskFailSaved = false;
+
+/**/
+
+
+
+
+/* Run Control Variables & Constants */
+
+// Run/Stop/Single: button 3 swaps between running and stopped, button 4 arms a single acquisition that stops once a record has triggered.
+// While stopped, the held record is only re-processed by the stages whose inputs changed (see updateRecordStages).
+#define RUN_COLOR     GREEN
+#define STOP_COLOR    RED
+#define SINGLE_COLOR  YELLOW
+
+bool acquisitionRunning = true; // Cleared by Stop, a completed Single and the mask test's stop-on-fail; the held capture stays on screen
+bool singleArmed = false;       // Stop after the next triggered record
+
+uint32_t recordVersion = 0; // Bumped whenever the record may have changed (a new acquisition or replayed record, autoset, a received capture)
+
+// What the voltage/trigger stage (updateVoltageData) last ran on
+uint32_t voltageStageRecord = 0xFFFFFFFF;
+int voltageStageLUTVersion = -1;
+int voltageStageTrigType = -1;
+int voltageStageTrigSource = -1;
+double voltageStageTrigSettings[5];   // triggerVoltage, triggerHysteresis, triggerUpper, triggerTime1, triggerTime2
+uint32_t voltageStageRuns = 0;        // Bumped every time the stage runs, so the stages after it know to follow
+
+// What the plotting stage (extractPlottingData) last ran on
+uint32_t plotStageVoltageRuns = 0xFFFFFFFF;
+double plotStageHScale = -1;
+int plotStageInterpMode = -1;
+uint32_t plotStageMathVersion = 0xFFFFFFFF;
+uint32_t plotStageRuns = 0;
+
+// What the protocol decoder (runProtocolDecoder) last ran on
+uint32_t decodeStageRecord = 0xFFFFFFFF;
+int decodeStageLUTVersion = -1;
+int decodeStageProtocol = -1;
+int decodeStageBaudIndex = -1;
+double decodeStageThreshold = -1000;
+
+// What the zoom stages (extractZoomOverview, extractZoomColumns) last ran on
+uint32_t zoomOverviewStageRecord = 0xFFFFFFFF;
+uint32_t zoomStagePlotRuns = 0xFFFFFFFF;
+int zoomStageOffset = 0;
+
+/**/
+
+
+
+
+/* Reference Waveform Variables & Constants */
+
+// Reference slots hold a channel's plotted trace and its full record. They live in RAM; a slot can also be written to EEPROM (trace only, for the
+// first REF_EEPROM_SLOTS slots, after the mask) or to the SD card (trace and record, as REFn.BIN).
+#define REF_NUM_SLOTS     4
+#define REF_EEPROM_SLOTS  2
+#define REF_EEPROM_ADDR   (MASK_EEPROM_ADDR + sizeof(MaskData))
+#define REF_MAGIC         0x46455246 // "FREF"
+#define REF_VERSION       1
+#define REF_NO_ROW        255        // Overlay row for a column past the end of the reference
+#define REF_RECORD_LENGTH 4000       // Samples of the record a slot keeps from the trigger on (the SD file layout predates the deeper record)
+
+// Reference menu actions (encoder 2 picks one, its button runs it on the slot encoder 1 picks)
+#define REF_ACT_SAVE_CH1     0
+#define REF_ACT_SAVE_CH2     1
+#define REF_ACT_SHOW         2 // Show/hide
+#define REF_ACT_CLEAR        3
+#define REF_ACT_WRITE_EEPROM 4
+#define REF_ACT_READ_EEPROM  5
+#define REF_ACT_WRITE_SD     6
+#define REF_ACT_READ_SD      7
+#define REF_NUM_ACTIONS      8
+
+struct RefSlot {
+  bool valid;
+  bool shown;
+  bool hasRecord;       // False for references read back from EEPROM (trace only)
+  uint8_t channel;      // Channel it was captured from (drawn with that channel's scale and position)
+  float sampleDt;       // Sample spacing of the capture
+  float stride;         // Record samples per column of the stored trace
+  uint16_t trace[LX];   // The trace as it was plotted, processed counts
+
+  // Overlay, pre-mapped to a screen row per column, and the time per column and pixel table it was mapped for
+  uint8_t rows[LX];
+  double mappedColumnTime;
+  int mappedLUTBuild;
+};
+
+// What is written to EEPROM, and at the start of an SD file (followed there by the REF_RECORD_LENGTH record)
+struct RefStoredTrace {
+  uint32_t magic;
+  uint16_t version;
+  uint8_t channel;
+  float sampleDt;
+  float stride;
+  uint16_t trace[LX];
+  uint32_t crc;
+};
+
+static_assert(REF_EEPROM_ADDR + REF_EEPROM_SLOTS*sizeof(RefStoredTrace) <= E2END + 1, "References do not fit in EEPROM after the mask");
+static_assert(REF_NUM_SLOTS <= 9, "Reference file names (REFn.BIN) have room for one digit");
+static_assert(REF_RECORD_LENGTH <= NUM_SAMPLES, "A reference record is taken from one record");
+
+RefSlot refSlots[REF_NUM_SLOTS];
+DMAMEM uint16_t refRecords[REF_NUM_SLOTS][REF_RECORD_LENGTH]; // Records from the trigger sample on ([0] is the trigger sample)
+int refSlot = 0;
+int refAction = REF_ACT_SAVE_CH1;
+int refPendingAction = -1; // Set by the UI, run by the next runRefAction()
+bool sdAvailable = false;  // Set in setup() if the SD card could be opened
+
+const tgx::RGB565 refColors[REF_NUM_SLOTS] = {tgx::RGB565(31, 63, 31), tgx::RGB565(31, 40, 20), tgx::RGB565(20, 40, 31), tgx::RGB565(31, 30, 31)};
+
+// RAM2 (DMAMEM, 512K) also holds the heap (SD and display library buffers), so the arrays placed there have a budget: a section that adds one
+// adds it to this sum.
+#define DMAMEM_BUDGET (480*1024)
+static_assert(sizeof(fb_internal) + sizeof(avgAccum) + sizeof(maskFailRecord) + sizeof(refRecords) <= DMAMEM_BUDGET,
+              "The DMAMEM arrays exceed their share of RAM2");
+
+/**/
+
+
+
+
+/* Frequency Counter Variables & Constants */
+
+// Gated frequency counter: the rising edges of a digitized copy of the input (e.g. a comparator on the trigger level) on FREQ_PIN are counted
+// in hardware by QuadTimer 4, channel 2 counting the pin and channel 3 cascaded on it for the upper 16 bits, so no CPU time is spent per edge
+// and there is no rate limit short of the timer's own. Every gate reads the count together with the cycle counter; the frequency is the
+// gate's edges over the cycles between the two reads, to +/-1 edge per gate.
+#define FREQ_PIN          9       // GPIO_B0_11, QTIMER4_TIMER2 on ALT1
+#define FREQ_GATE_MS      100     // A new reading every gate
+#define FREQ_MAX_GATE_MS  2000    // Gate is stretched up to this long waiting for FREQ_MIN_EDGES (slow signals)
+#define FREQ_MIN_EDGES    100     // Edges wanted per gate, so the +/-1 edge is at most 1% of the reading
+
+bool freqCounterOn = false;       // Set from the UI; the timer is started/stopped by updateFrequencyCounter()
+bool freqCounterRunning = false;
+uint32_t freqGateCount = 0;       // Timer count...
+uint32_t freqGateStamp = 0;       // ...and cycle counter at the start of the current gate
+uint32_t freqGateStart = 0;       // millis() at the start of the current gate
+double freqMeasured = 0;          // Hz (0 = no edges)
+int freqDigits = 1;               // Significant digits of freqMeasured: those of the gate's edge count, as it is only good to +/-1
+
+/**/
+
+
+
+
+/* Autoset Variables & Constants */
+
+// Autoset takes one record at the current sample rate, measures each shown channel (range, DC level, fundamental period) and sets the
+// channel scales and positions, the timebase and the trigger from it
+#define AUTOSET_MIN_AMPLITUDE 0.05 // Volts peak-to-peak below which a channel is treated as flat (no period, no trigger)
+#define AUTOSET_FILL          0.8  // Most of its screen band a channel's peak-to-peak is scaled to fill (scales are rounded up to 1-2-5 steps)
+#define AUTOSET_PERIODS       2.5  // Periods shown across the screen
+#define AUTOSET_HYSTERESIS    0.1  // Trigger (and period crossing) hysteresis, as a fraction of peak-to-peak
+
+// What autoset measures of one channel's record
+struct SignalSummary {
+  bool active;   // Channel is shown
+  double min;
+  double max;
+  double mean;
+  double period; // Seconds (0 if fewer than two cycles were found)
+};
+
+bool autosetPending = false; // Set by the UI, autoset runs at the start of the next loop
+
+/**/
+
+
 /*
 Name: bound
 Description: Bounds a provided double-type to a provided range
@@ -252,1389 +1070,8140 @@ void bound(int &val, int lower, int upper){
   }
 }
 
-#if runUI
-// ---------------------
-/* BEGIN UI Functions */
-// ---------------------
-
-
+// ------------------------------------------
+/* BEGIN Pipeline Template Functions */
+// ------------------------------------------
 
+/*
+The per-channel stages are written once over the sample type, channel count and record length, and called per channel by loops over
+NUM_CHANNELS. Changing NUM_CHANNELS, NUM_SAMPLES or sample_t re-instantiates them at the new size; the host build (host/host.cpp) runs the
+store and processing kernels in other configurations and checks them against plain reference versions.
+*/
 
 /*
-Name: checkButton1
-Description: Returns the boolean state of button 1
-Returns: bool "button1State"
-Parameters: None
+Name: drawTrace
+Description: Maps each of a channel's LX extracted raw values through its count -> pixel table and writes them straight into the framebuffer.
+Returns: Nothing (shows on display)
+Parameters: const SampleT "raw[]" (LX long, one value per column), const uint8_t "lut[]" (count -> pixel table), uint16_t "color"
 */
-// Returns the boolean state of button 1
-bool checkButton1(){
-  #if DUMMY
-    int input;
+template<typename SampleT, int N>
+void drawTrace(const SampleT (&raw)[N], const uint8_t lut[], uint16_t color){
+  static_assert(N == LX, "A trace has one point per screen column");
+  for(int i = 0; i < N; i++){
+    fb[lut[raw[i]]*LX + i] = color;
+  }
+}
 
-    Serial.println("ENTER BUTTON 1");
-    while(Serial.available() == 0){
+// Compile-time checks of the record limits at depths other than the one being built
+static_assert(RecordLimits<8000>::hscaleMax(1.0) == 2*RecordLimits<4000>::hscaleMax(1.0), "HScale range scales with depth");
+static_assert(RecordLimits<16384>::maxStride() == 51.2, "Stride at the longest timebase");
+static_assert(RecordLimits<LX>::hscaleMin(1.0) == RecordLimits<LX>::hscaleMax(1.0), "A one-screen record has a single timebase");
+static_assert(RecordLimits<NUM_SAMPLES>::hscaleMax(ADC_SAMPLE_DT) >= MAX_HSCALE, "MAX_HSCALE must fit in a dual-channel record");
+
+// ---------------------------------------
+/* END Pipeline Template Functions */
+// ---------------------------------------
 
-    }
-    input = Serial.parseInt();
 
-    button1State = input;
-    // Serial.print("Button1 State: ");
-    Serial.println(button1State);
-  #endif
-  #if !DUMMY
-    button1.update();
-    button1State = button1.fell();
-  #endif
 
-  return button1State;
-}
+
+// ------------------------------------
+/* BEGIN Sample Store Functions */
+// ------------------------------------
 
 /*
-Name: checkButton2
-Description: Returns the boolean state of button 2
-Returns: bool "button2State"
-Parameters: None
+The store kernels below work on any store of CHANNELS interleaved channels BITS wide each (a little-endian bit stream of 32-bit words, so a
+field can straddle two words, followed by one spare word). Values are shifted right by SHIFT as they are packed and back left as they are
+unpacked. The record wrappers after them are the ones the rest of the sketch uses, on sampleStore in the record's layout.
 */
-// Returns the boolean state of button 2
-bool checkButton2(){
-  #if DUMMY
-    int input;
 
-    Serial.println("ENTER BUTTON 2");
-    while(Serial.available() == 0){
+/*
+Name: storeField
+Description: One sample of a store: channel ch's field at a sample index, taken from the two words it can straddle
+Returns: int "value"
+Parameters: const uint32_t "store[]", int "ch", int "index"
+*/
+template<int CHANNELS, int BITS, int SHIFT>
+inline int storeField(const uint32_t store[], int ch, int index){
+  uint32_t bit = ((uint32_t)index*CHANNELS + ch)*BITS;
+  uint64_t pair = store[bit >> 5] | ((uint64_t)store[(bit >> 5) + 1] << 32);
+  return (int)((pair >> (bit & 31)) & ((1UL << BITS) - 1)) << SHIFT;
+}
 
+/*
+Name: setStoreField
+Description: Writes one sample of a store, leaving the fields around it (the other channels') as they were
+Returns: Nothing (updates the store)
+Parameters: uint32_t "store[]", int "ch", int "index", int "value"
+*/
+template<int CHANNELS, int BITS, int SHIFT>
+inline void setStoreField(uint32_t store[], int ch, int index, int value){
+  const uint64_t mask = (1ULL << BITS) - 1;
+  uint32_t bit = ((uint32_t)index*CHANNELS + ch)*BITS;
+  uint32_t word = bit >> 5;
+  uint64_t pair = store[word] | ((uint64_t)store[word + 1] << 32);
+
+  pair = (pair & ~(mask << (bit & 31))) | ((((uint64_t)value >> SHIFT) & mask) << (bit & 31));
+  store[word] = (uint32_t)pair;
+  store[word + 1] = (uint32_t)(pair >> 32);
+}
+
+/*
+Name: unpackChannel
+Description: Unpacks count samples of one channel, from sample index first, into a de-interleaved array. Fields are pulled from a 64-bit
+window that is refilled a word at a time, so each sample costs a shift and a mask rather than a straddle test; the other channels' fields
+between two samples are shifted out (whole words of them skipped). Words past the last field asked for are never read.
+Returns: Nothing (fills the provided array)
+Parameters: const uint32_t "store[]", int "ch", int "first", int "count", SampleT "out[]"
+*/
+template<int CHANNELS, int BITS, int SHIFT, typename SampleT>
+void unpackChannel(const uint32_t store[], int ch, int first, int count, SampleT out[]){
+  const uint32_t mask = (1UL << BITS) - 1;
+  const int skip = (CHANNELS - 1)*BITS; // The other channels' fields between two of this channel's
+  uint32_t bit = ((uint32_t)first*CHANNELS + ch)*BITS;
+  const uint32_t* word = &store[bit >> 5];
+  uint64_t window = *word++ >> (bit & 31);
+  int available = 32 - (bit & 31);
+
+  for(int i = 0; i < count; i++){
+    if(i > 0){
+      int drop = skip;
+      while(drop >= available && drop > 0){
+        drop -= available;
+        window = *word++;
+        available = 32;
+      }
+      window >>= drop;
+      available -= drop;
     }
-    input = Serial.parseInt();
+    while(available < BITS){
+      window |= (uint64_t)(*word++) << available;
+      available += 32;
+    }
+    out[i] = (SampleT)(((uint32_t)window & mask) << SHIFT);
+    window >>= BITS;
+    available -= BITS;
+  }
+}
 
-    button2State = input;
-    // Serial.print("Button2 State: ");
-    Serial.println(button2State);
-  #endif
-  #if !DUMMY
-    button2.update();
-    button2State = button2.fell();
-  #endif
-  
-  return button2State;
+/*
+Name: packChannel
+Description: Packs count samples of one channel, from a de-interleaved array into the store from sample index first. Each field is merged
+into the two words it can straddle, so the other channels' fields are left as they were.
+Returns: Nothing (updates the store)
+Parameters: uint32_t "store[]", int "ch", int "first", int "count", const SampleT "in[]"
+*/
+template<int CHANNELS, int BITS, int SHIFT, typename SampleT>
+void packChannel(uint32_t store[], int ch, int first, int count, const SampleT in[]){
+  const uint64_t mask = (1ULL << BITS) - 1;
+  uint32_t bit = ((uint32_t)first*CHANNELS + ch)*BITS;
+
+  for(int i = 0; i < count; i++, bit += CHANNELS*BITS){
+    uint32_t word = bit >> 5;
+    uint64_t pair = store[word] | ((uint64_t)store[word + 1] << 32);
+    pair = (pair & ~(mask << (bit & 31))) | ((((uint64_t)in[i] >> SHIFT) & mask) << (bit & 31));
+    store[word] = (uint32_t)pair;
+    store[word + 1] = (uint32_t)(pair >> 32);
+  }
 }
 
 /*
-Name: checkButton3
-Description: Returns the boolean state of button 3
-Returns: bool "button3State"
-Parameters: None
+Name: recordSample
+Description: One sample of the record (random access, for the stages that only look at a few samples)
+Returns: int "value" (ADC counts as sampled, processed counts once processAcquisition() has run)
+Parameters: int "ch", int "index" (0 to NUM_SAMPLES - 1)
 */
-// Returns the boolean state of button 3
-bool checkButton3(){
-  #if DUMMY
-    int input;
+inline int recordSample(int ch, int index){
+  return storeField<NUM_CHANNELS, STORE_RECORD_BITS, 0>(sampleStore, ch, index);
+}
 
-    Serial.println("ENTER BUTTON 3");
-    while(Serial.available() == 0){
+/*
+Name: setRecordSample
+Description: Writes one sample of the record
+Returns: Nothing (updates sampleStore)
+Parameters: int "ch", int "index", int "value"
+*/
+inline void setRecordSample(int ch, int index, int value){
+  setStoreField<NUM_CHANNELS, STORE_RECORD_BITS, 0>(sampleStore, ch, index, value);
+}
 
-    }
-    input = Serial.parseInt();
+/*
+Name: loadRecordWindow
+Description: Unpacks samples [first, first + count) of one channel of the record into a window (count <= RECORD_WINDOW for the stages'
+windows, and first + count <= NUM_SAMPLES: windows don't wrap)
+Returns: Nothing (fills the provided array)
+Parameters: int "ch", int "first", int "count", sample_t "window[]"
+*/
+inline void loadRecordWindow(int ch, int first, int count, sample_t window[]){
+  unpackChannel<NUM_CHANNELS, STORE_RECORD_BITS, 0>(sampleStore, ch, first, count, window);
+}
 
-    button3State = input;
-    // Serial.print("Button3 State: ");
-    Serial.println(button3State);
-  #endif
-  #if !DUMMY
-    button3.update();
-    button3State = button3.fell();
-  #endif
-  
-  return button3State;
+/*
+Name: saveRecordWindow
+Description: Packs a window back into samples [first, first + count) of one channel of the record
+Returns: Nothing (updates sampleStore)
+Parameters: int "ch", int "first", int "count", const sample_t "window[]"
+*/
+inline void saveRecordWindow(int ch, int first, int count, const sample_t window[]){
+  packChannel<NUM_CHANNELS, STORE_RECORD_BITS, 0>(sampleStore, ch, first, count, window);
 }
 
 /*
-Name: checkButton4
-Description: Returns the boolean state of button 4
-Returns: bool "button4State"
-Parameters: None
+Name: loadRecordSpan
+Description: Unpacks count consecutive samples of one channel from record position first, wrapping around the end of the record (in at most
+two windows)
+Returns: Nothing (fills the provided array)
+Parameters: int "ch", int "first" (any record position, taken modulo NUM_SAMPLES), int "count" (<= NUM_SAMPLES), sample_t "span[]"
 */
-// Returns the boolean state of button 4
-bool checkButton4(){
-  #if DUMMY
-    int input;
+void loadRecordSpan(int ch, int first, int count, sample_t span[]){
+  first = ((first % NUM_SAMPLES) + NUM_SAMPLES) % NUM_SAMPLES;
+  int head = min(count, NUM_SAMPLES - first);
+  loadRecordWindow(ch, first, head, span);
+  if(head < count){
+    loadRecordWindow(ch, 0, count - head, &span[head]);
+  }
+}
 
-    Serial.println("ENTER BUTTON 4");
-    while(Serial.available() == 0){
+/*
+Name: storeTestValue
+Description: Used by the sample store benchmark. A repeatable pseudo-random processed count (with no extra bits, as a single acquisition
+leaves them) for each channel and sample.
+Returns: sample_t "value"
+Parameters: int "ch", int "index"
+*/
+inline sample_t storeTestValue(int ch, int index){
+  uint32_t hash = (uint32_t)(index*2654435761UL) ^ (uint32_t)(ch*0x9E3779B9UL);
+  return (sample_t)(hash >> (32 - ADC_RESOLUTION)) << PROC_EXTRA_BITS;
+}
 
+/*
+Name: benchmarkLayout
+Description: Used by the sample store benchmark. Packs count samples per channel of the test pattern into sampleStore in one layout, a
+window at a time, unpacks them again and checks they round-trip.
+Returns: bool (true if every sample came back), and the cycles spent packing and unpacking
+Parameters: int "count" (samples per channel), uint32_t& "packCycles", uint32_t& "unpackCycles"
+*/
+template<int BITS, int SHIFT>
+bool benchmarkLayout(int count, uint32_t& packCycles, uint32_t& unpackCycles){
+  sample_t window[RECORD_WINDOW];
+  bool pass = true;
+  packCycles = 0;
+  unpackCycles = 0;
+
+  for(int ch = 0; ch < NUM_CHANNELS; ch++){
+    for(int first = 0; first < count; first += RECORD_WINDOW){
+      int n = min(RECORD_WINDOW, count - first);
+      for(int i = 0; i < n; i++){
+        window[i] = storeTestValue(ch, first + i);
+      }
+      uint32_t start = ARM_DWT_CYCCNT;
+      packChannel<NUM_CHANNELS, BITS, SHIFT>(sampleStore, ch, first, n, window);
+      packCycles += ARM_DWT_CYCCNT - start;
     }
-    input = Serial.parseInt();
+  }
 
-    button4State = input;
-    // Serial.print("Button4 State: ");
-    Serial.println(button4State);
-  #endif
-  #if !DUMMY
-    button4.update();
-    button4State = button4.fell();
-  #endif
-  
-  return button4State;
+  for(int ch = 0; ch < NUM_CHANNELS; ch++){
+    for(int first = 0; first < count; first += RECORD_WINDOW){
+      int n = min(RECORD_WINDOW, count - first);
+      uint32_t start = ARM_DWT_CYCCNT;
+      unpackChannel<NUM_CHANNELS, BITS, SHIFT>(sampleStore, ch, first, n, window);
+      unpackCycles += ARM_DWT_CYCCNT - start;
+      for(int i = 0; i < n; i++){
+        pass &= (window[i] == storeTestValue(ch, first + i));
+      }
+    }
+  }
+  return pass;
 }
 
 /*
-Name: readEncoder1Change
-Description: Returns the number of rotary clicks registered by encoder 1. Actual clicks are divided out by ENC_SENSITIVITY to prevent
-misreads from small variations in the encoder rotation.
-Returns: int "difference"
+Name: benchmarkSampleStore
+Description: Used for testing & debugging. For each layout, packs a synthetic record (as deep as that layout fits in the record's RAM) into
+the store and back, checks it round-trips, and reports the bytes per sample, the depth that RAM holds (and that relative to the unpacked
+sample_t + double record it replaced), and the pack/unpack cost next to a plain de-interleaving copy of uint16_t. Overwrites the record, and
+leaves it holding the synthetic one in the record's layout.
+Returns: Nothing (prints to terminal)
 Parameters: None
 */
-int readEncoder1Change(){
-  int difference;
+void benchmarkSampleStore(){
+  const char* layoutNames[STORE_NUM_LAYOUTS] = {"uint16", "packed proc", "packed ADC"};
+  const double unpackedBytes = sizeof(sample_t) + sizeof(double); // Per sample per channel, unpacked
+  sample_t window[RECORD_WINDOW];
+  bool allPass = true;
+
+  // Baseline: de-interleave a window of uint16_t (whatever the store holds stands in for the source)
+  const uint16_t* interleaved = (const uint16_t*)sampleStore;
+  uint32_t start = ARM_DWT_CYCCNT;
+  for(int i = 0; i < RECORD_WINDOW; i++){
+    window[i] = interleaved[i*NUM_CHANNELS];
+  }
+  uint32_t copyCycles = ARM_DWT_CYCCNT - start;
+  (void)window[RECORD_WINDOW - 1];
+  Serial.print("De-interleaving copy of uint16_t: ");
+  Serial.print(copyCycles/(double)RECORD_WINDOW, 2);
+  Serial.println(" cycles/sample");
+
+  Serial.println("Layout, bits, bytes/sample, depth (samples/ch), depth vs unpacked, pack cycles/sample, unpack cycles/sample");
+  for(int layout = 0; layout < STORE_NUM_LAYOUTS; layout++){
+    int bits = storeLayoutBits[layout];
+    int depth = (int)min((uint32_t)NUM_SAMPLES, (uint32_t)(SAMPLE_STORE_BYTES*8ULL/(bits*NUM_CHANNELS)));
+    uint32_t packCycles, unpackCycles;
+    bool pass;
+
+    switch(layout){
+      case STORE_PACK_PROC: pass = benchmarkLayout<STORE_PROC_BITS, 0>(depth, packCycles, unpackCycles); break;
+      case STORE_PACK_ADC:  pass = benchmarkLayout<STORE_ADC_BITS, PROC_EXTRA_BITS>(depth, packCycles, unpackCycles); break;
+      default:              pass = benchmarkLayout<16, 0>(depth, packCycles, unpackCycles);
+    }
+    allPass &= pass;
+    double samples = (double)depth*NUM_CHANNELS;
+
+    Serial.print(layoutNames[layout]);
+    Serial.print(layout == STORE_PACK_PROC ? " (record)" : "");
+    Serial.print(", ");
+    Serial.print(bits);
+    Serial.print(", ");
+    Serial.print(bits/8.0, 3);
+    Serial.print(", ");
+    Serial.print(SAMPLE_STORE_BYTES*8ULL/(bits*NUM_CHANNELS));
+    Serial.print(", ");
+    Serial.print(unpackedBytes*8/bits, 1);
+    Serial.print("x, ");
+    Serial.print(packCycles/samples, 2);
+    Serial.print(", ");
+    Serial.print(unpackCycles/samples, 2);
+    Serial.println(pass ? "" : "  FAIL");
+  }
+  Serial.println(allPass ? "Sample store self-test PASSED" : "Sample store self-test FAILED");
 
-  #if DUMMY
-    int input;
+  // The record's own layout last, so the store is left holding a whole record in it
+  uint32_t packCycles, unpackCycles;
+  benchmarkLayout<STORE_RECORD_BITS, 0>(NUM_SAMPLES, packCycles, unpackCycles);
+}
 
-    Serial.println("ENTER ENCODER 1");
-    while(Serial.available() == 0){
 
-    }
-    input = Serial.parseInt();
+// ----------------------------------
+/* END Sample Store Functions */
+// ----------------------------------
 
-    difference = input;
-    // Serial.print("Encoder1 Change: ");
-    Serial.println(difference);
-  #endif
 
-  #if !DUMMY
-  enc1New = encoder1.read();
 
-  difference = enc1New - enc1Old;
-  #endif
 
-  if(abs(difference) >= ENC_Sensitivity){
-    enc1Old = enc1New;
-    return difference / ENC_Sensitivity;
-  }else{
-    return 0;
+// -------------------------------
+/* BEGIN DSP Kernel Functions */
+// -------------------------------
+
+// The packed 16-bit instructions the SIMD kernels use (SSUB16 sets a GE flag per half-word and SEL picks bytes by them, SMLAD and SMLALD are
+// dual 16-bit multiply-accumulates): the CMSIS intrinsics on the M7, portable stand-ins elsewhere
+#if DSP_SIMD
+#define simdSSUB16  __SSUB16
+#define simdSEL     __SEL
+#define simdSMLAD   __SMLAD
+#define simdSMLALD  __SMLALD
+#else
+// The stand-ins keep the GE flags in a variable, so the SIMD kernels also build on targets without the instructions and can be checked against
+// the scalar kernels there
+uint32_t dspGEFlags = 0;
+
+uint32_t ssub16_portable(uint32_t a, uint32_t b){
+  int32_t low = (int16_t)a - (int16_t)b;
+  int32_t high = (int16_t)(a >> 16) - (int16_t)(b >> 16);
+  dspGEFlags = ((low >= 0) ? 0x3 : 0) | ((high >= 0) ? 0xC : 0);
+  return (uint32_t)(low & 0xFFFF) | ((uint32_t)high << 16);
+}
+
+uint32_t sel_portable(uint32_t a, uint32_t b){
+  uint32_t result = 0;
+  for(int byte = 0; byte < 4; byte++){
+    uint32_t mask = 0xFFUL << (8*byte);
+    result |= ((dspGEFlags >> byte) & 1) ? (a & mask) : (b & mask);
   }
+  return result;
+}
+
+uint32_t smlad_portable(uint32_t a, uint32_t b, uint32_t acc){
+  return acc + (int16_t)a*(int16_t)b + (int16_t)(a >> 16)*(int16_t)(b >> 16);
 }
 
+uint64_t smlald_portable(uint32_t a, uint32_t b, uint64_t acc){
+  return acc + (int64_t)((int16_t)a*(int16_t)b) + (int64_t)((int16_t)(a >> 16)*(int16_t)(b >> 16));
+}
+
+#define simdSSUB16  ssub16_portable
+#define simdSEL     sel_portable
+#define simdSMLAD   smlad_portable
+#define simdSMLALD  smlald_portable
+#endif
+
 /*
-Name: readEncoder2Change
-Description: Returns the number of rotary clicks registered by encoder 2. Actual clicks are divided out by ENC_SENSITIVITY to prevent
-misreads from small variations in the encoder rotation.
-Returns: int "difference"
-Parameters: None
+Name: loadPair
+Description: Two adjacent samples as one 32-bit word (first sample in the low half), for the packed 16-bit instructions
+Returns: uint32_t "pair"
+Parameters: const sample_t* "data"
 */
-int readEncoder2Change(){
-  int difference;
-
-  #if DUMMY
-    int input;
+inline uint32_t loadPair(const sample_t* data){
+  uint32_t pair;
+  memcpy(&pair, data, sizeof(pair)); // A single (unaligned-capable) load on the M7
+  return pair;
+}
 
-    Serial.println("ENTER ENCODER 2");
-    while(Serial.available() == 0){
+/*
+Name: firstInRangeScalar
+Description: Index of the first sample in [start, end) with lo <= value <= hi
+Returns: int "index" (-1 if there is none)
+Parameters: const sample_t "data[]", int "start", int "end", int "lo", int "hi"
+*/
+int firstInRangeScalar(const sample_t data[], int start, int end, int lo, int hi){
+  for(int i = start; i < end; i++){
+    if(data[i] >= lo && data[i] <= hi){
+      return i;
+    }
+  }
+  return -1;
+}
 
+/*
+Name: firstInRangeSIMD
+Description: firstInRangeScalar two samples at a time: SSUB16 against the range's ends sets a GE flag per sample, and SEL turns the flags
+into a mask of the samples in range
+Returns: int "index" (-1 if there is none)
+Parameters: const sample_t "data[]", int "start", int "end", int "lo", int "hi"
+*/
+int firstInRangeSIMD(const sample_t data[], int start, int end, int lo, int hi){
+  if(lo > hi){
+    return -1;
+  }
+  lo = (lo < INT16_MIN) ? INT16_MIN : lo;
+  hi = (hi > INT16_MAX) ? INT16_MAX : hi;
+  const uint32_t loPair = (uint16_t)lo | ((uint32_t)(uint16_t)lo << 16);
+  const uint32_t hiPair = (uint16_t)hi | ((uint32_t)(uint16_t)hi << 16);
+
+  int i = start;
+  for(; i + 1 < end; i += 2){
+    uint32_t pair = loadPair(&data[i]);
+    simdSSUB16(pair, loPair);
+    uint32_t aboveLo = simdSEL(0xFFFFFFFF, 0);
+    simdSSUB16(hiPair, pair);
+    uint32_t inRange = simdSEL(aboveLo, 0);
+    if(inRange){
+      return (inRange & 0xFFFF) ? i : i + 1;
     }
-    input = Serial.parseInt();
+  }
+  return firstInRangeScalar(data, i, end, lo, hi);
+}
 
-    difference = input;
-    Serial.println(difference);
-  #endif
+/*
+Name: minMaxScalar
+Description: Lowest and highest of n samples (n >= 1)
+Returns: Nothing (sets low and high)
+Parameters: const sample_t "data[]", int "n", int& "low", int& "high"
+*/
+void minMaxScalar(const sample_t data[], int n, int& low, int& high){
+  low = high = data[0];
+  for(int i = 1; i < n; i++){
+    if(data[i] < low){
+      low = data[i];
+    }else if(data[i] > high){
+      high = data[i];
+    }
+  }
+}
 
-  #if !DUMMY
-  enc2New = encoder2.read();
+/*
+Name: minMaxSIMD
+Description: minMaxScalar two samples at a time: a running minimum and maximum per half-word, updated with SSUB16 + SEL, then combined
+Returns: Nothing (sets low and high)
+Parameters: const sample_t "data[]", int "n", int& "low", int& "high"
+*/
+void minMaxSIMD(const sample_t data[], int n, int& low, int& high){
+  if(n < 4){
+    minMaxScalar(data, n, low, high);
+    return;
+  }
 
-  difference = enc2New - enc2Old;
-  #endif
+  uint32_t lows = loadPair(data);
+  uint32_t highs = lows;
+  int i = 2;
+  for(; i + 1 < n; i += 2){
+    uint32_t pair = loadPair(&data[i]);
+    simdSSUB16(pair, highs);
+    highs = simdSEL(pair, highs);
+    simdSSUB16(lows, pair);
+    lows = simdSEL(pair, lows);
+  }
 
-  if(abs(difference) >= ENC_Sensitivity){
-    enc2Old = enc2New;
-    return difference / ENC_Sensitivity;
-  }else{
-    return 0;
+  low = min((int16_t)lows, (int16_t)(lows >> 16));
+  high = max((int16_t)highs, (int16_t)(highs >> 16));
+  if(i < n){
+    low = min(low, (int)data[i]);
+    high = max(high, (int)data[i]);
   }
 }
 
+/*
+Name: sumSquaresScalar
+Description: Sum and sum of squares of n samples
+Returns: Nothing (sets sum and sumSq)
+Parameters: const sample_t "data[]", int "n", int32_t& "sum", uint64_t& "sumSq"
+*/
+void sumSquaresScalar(const sample_t data[], int n, int32_t& sum, uint64_t& sumSq){
+  sum = 0;
+  sumSq = 0;
+  for(int i = 0; i < n; i++){
+    sum += data[i];
+    sumSq += (int32_t)data[i]*data[i];
+  }
+}
 
 /*
-Name: resetMenu
-Description: Resets all the global selector variables for the UI's menu.
-Returns: Nothing (edits global variables)
-Parameters: None
+Name: sumSquaresSIMD
+Description: sumSquaresScalar two samples at a time: SMLAD against (1, 1) for the sum and SMLALD of the pair with itself (into 64 bits,
+which a record of squared 12-bit counts needs) for the sum of squares
+Returns: Nothing (sets sum and sumSq)
+Parameters: const sample_t "data[]", int "n", int32_t& "sum", uint64_t& "sumSq"
 */
-void resetMenu(){
-  menuSelected = 0;
-  menuSelecting = 0;
-  chDataSelected = 0;
-  chDataSelecting = 0;
+void sumSquaresSIMD(const sample_t data[], int n, int32_t& sum, uint64_t& sumSq){
+  uint32_t sum32 = 0;
+  uint64_t sq = 0;
+  int i = 0;
+  for(; i + 1 < n; i += 2){
+    uint32_t pair = loadPair(&data[i]);
+    sum32 = simdSMLAD(pair, 0x00010001, sum32);
+    sq = simdSMLALD(pair, pair, sq);
+  }
+  sum = (int32_t)sum32;
+  sumSq = sq;
+  if(i < n){
+    sum += data[i];
+    sumSq += (int32_t)data[i]*data[i];
+  }
 }
 
+// The kernels the rest of the sketch uses: the SIMD versions where the instructions exist, the scalar ones elsewhere (the emulated SIMD
+// instructions above are only for checking)
+#if DSP_SIMD
+  #define firstInRange  firstInRangeSIMD
+  #define minMax        minMaxSIMD
+  #define sumSquares    sumSquaresSIMD
+#else
+  #define firstInRange  firstInRangeScalar
+  #define minMax        minMaxScalar
+  #define sumSquares    sumSquaresScalar
+#endif
 
 /*
-Name: updateButton1
-Description: Updates the menu selection process based on the value of button 1. (Per cycle button 1 check)
-Returns: Nothing (edits global variables)
-Parameters: None
+Name: voltsToCode
+Description: Finds the processed count whose calibrated voltage is closest to (the first at or past) a voltage, by binary search of a
+channel's count -> volts table (rising or falling)
+Returns: int "count"
+Parameters: const float "countToVolts[]", double "volts"
 */
-void updateButton1(){  
-  if(checkButton1() == true){
-    //Open menu 
-    if(showMenu == 0){
-      showMenu = 1;
-        return;
+int voltsToCode(const float countToVolts[], double volts){
+  bool rising = countToVolts[PROC_MAX_CODE] > countToVolts[0];
+  int low = 0;
+  int high = PROC_MAX_CODE;
+  while(low < high){
+    int mid = (low + high)/2;
+    if(rising ? (countToVolts[mid] < volts) : (countToVolts[mid] > volts)){
+      low = mid + 1;
+    }else{
+      high = mid;
     }
+  }
+  return low;
+}
 
-    // Close menu
-    if(menuSelected == 0){
-      showMenu = 0;
-      resetMenu();
-      return;
+/*
+Name: codeRange
+Description: The range of processed counts whose calibrated voltage lies strictly between two voltages. The count -> volts table is monotonic
+(rising, or falling for an inverting front end), so the counts form one range, found by binary search and then trimmed at its ends.
+Returns: Nothing (sets first and last; first > last if no count qualifies)
+Parameters: const float "countToVolts[]", double "lowVolts", double "highVolts", int& "first", int& "last"
+*/
+void codeRange(const float countToVolts[], double lowVolts, double highVolts, int& first, int& last){
+  int a = voltsToCode(countToVolts, lowVolts);
+  int b = voltsToCode(countToVolts, highVolts);
+  first = min(a, b) - 1;
+  last = max(a, b) + 1;
+  bound(first, 0, PROC_MAX_CODE);
+  bound(last, 0, PROC_MAX_CODE);
+
+  while(first <= last && !(countToVolts[first] > lowVolts && countToVolts[first] < highVolts)){
+    first++;
+  }
+  while(last >= first && !(countToVolts[last] > lowVolts && countToVolts[last] < highVolts)){
+    last--;
+  }
+}
+
+/*
+Name: findTriggerIndex
+Description: The trigger search of updateVoltageData(), done on a channel's raw counts rather than its voltages: the trigger conditions are
+turned into ranges of counts once (codeRange), then searched for with the firstInRange kernel. With hysteresis, the trigger is the first
+sample at or above triggerVoltage after one below (triggerVoltage - triggerHysteresis); without, the first sample after the first within
++/- 5% of triggerVoltage. The record is searched a window at a time, stopping at the window that holds the trigger.
+Returns: int "index" (0 if the record has no trigger)
+Parameters: int "ch" (0 or 1), const float "countToVolts[]" (the channel's table)
+*/
+int findTriggerIndex(int ch, const float countToVolts[]){
+  sample_t window[RECORD_WINDOW];
+  int armFirst = 0, armLast = -1;
+  int first, last;
+  bool armed = true;
+
+  if(triggerHysteresis > 0){
+    codeRange(countToVolts, -INFINITY, triggerVoltage - triggerHysteresis, armFirst, armLast);
+    codeRange(countToVolts, nextafter(triggerVoltage, -INFINITY), INFINITY, first, last); // volts >= triggerVoltage
+    armed = false;
+  }else{
+    codeRange(countToVolts, 0.95*triggerVoltage, 1.05*triggerVoltage, first, last);
+  }
+
+  for(int base = 0; base < NUM_SAMPLES; base += RECORD_WINDOW){
+    int n = min(RECORD_WINDOW, NUM_SAMPLES - base);
+    int start = (base == 0) ? 1 : 0; // The first sample of the record can't be the trigger
+    loadRecordWindow(ch, base, n, window);
+    if(!armed){
+      int armIndex = firstInRange(window, 0, n, armFirst, armLast);
+      if(armIndex < 0){
+        continue;
+      }
+      armed = true;
+      start = armIndex + 1;
     }
-    
-    // Go back to "main menu" unless "channels" is selected, then go back to "main channels menu"
-    if(menuSelected > 0){
-      if(menuSelected == 1){
-        if(chDataSelected > 0){
-          chDataSelected = 0;
-          chDataSelecting = 0;
-          return;
-        }else{
-          resetMenu();
-        }
-      }else{
-        resetMenu();
-        return;
+    int index = firstInRange(window, start, n, first, last);
+    if(index >= 0){
+      return base + index;
+    }
+  }
+  return 0;
+}
+
+/*
+Name: triggerIndexReference
+Description: Used by the DSP kernel self-test. The trigger search as updateVoltageData() used to do it, sample by sample on voltages.
+Returns: int "index" (0 if the record has no trigger)
+Parameters: int "ch" (0 or 1), const float "countToVolts[]"
+*/
+int triggerIndexReference(int ch, const float countToVolts[]){
+  double armLevel = triggerVoltage - triggerHysteresis;
+  bool armed = false;
+  for(int i = 0; i < NUM_SAMPLES; i++){
+    double volts = countToVolts[recordSample(ch, i)];
+    if(triggerHysteresis > 0){
+      armed = armed || volts < armLevel;
+      if(armed && volts >= triggerVoltage && i > 0){
+        return i;
       }
+    }else if(i > 0 && volts > (0.95*triggerVoltage) && volts < (1.05*triggerVoltage)){
+      return i;
     }
   }
+  return 0;
 }
 
 /*
-Name: updateTrigger
-Description: Updates the trigger voltage's value based on an inputted number of increments (increments being read from the UI).
-Returns: Nothing (edits global variables)
-Parameters: int "increments"
+Name: testDSPKernels
+Description: Used for testing & debugging. Checks the SIMD kernels against the scalar ones (on this target's instructions, or their portable
+stand-ins) over random windows of a record and ranges, checks the count-domain trigger search against the voltage one, and reports the
+cycles per sample of each kernel over a whole window. Overwrites channel 1 of the record.
+Returns: Nothing (prints to terminal)
+Parameters: None
 */
-void updateTrigger(int increments){
-  triggerVoltage += increments*TRIGGER_Sensitivity;
+void testDSPKernels(){
+  sample_t data[RECORD_WINDOW];
+  double savedTrigger[2] = {triggerVoltage, triggerHysteresis};
+  bool allPass = true;
 
-  bound(triggerVoltage, 0, MAX_TRIGGER);
+  // A slow sine with noise, so the trigger and range searches have both hits and misses
+  for(int i = 0; i < NUM_SAMPLES; i++){
+    setRecordSample(0, i, 2048 + (int)(1500*sin(i*0.01)) + random(200) - 100);
+  }
+
+  int mismatches = 0;
+  for(int trial = 0; trial < 200; trial++){
+    loadRecordWindow(0, random(NUM_SAMPLES - RECORD_WINDOW + 1), RECORD_WINDOW, data);
+    int start = random(RECORD_WINDOW);
+    int end = start + 1 + random(RECORD_WINDOW - start);
+    int lo = random(PROC_MAX_CODE + 1);
+    int hi = lo + random(64);
+    int low1, high1, low2, high2;
+    int32_t sum1, sum2;
+    uint64_t sq1, sq2;
+
+    minMaxScalar(&data[start], end - start, low1, high1);
+    minMaxSIMD(&data[start], end - start, low2, high2);
+    sumSquaresScalar(&data[start], end - start, sum1, sq1);
+    sumSquaresSIMD(&data[start], end - start, sum2, sq2);
+    if(firstInRangeScalar(data, start, end, lo, hi) != firstInRangeSIMD(data, start, end, lo, hi) || low1 != low2 || high1 != high2
+       || sum1 != sum2 || sq1 != sq2){
+      mismatches++;
+    }
+  }
+  Serial.print("SIMD vs scalar kernels: ");
+  Serial.println(mismatches ? "FAIL" : "PASS");
+  allPass &= (mismatches == 0);
+
+  mismatches = 0;
+  for(int trial = 0; trial < 100; trial++){
+    triggerVoltage = (random(1001) - 500)/100.0;
+    triggerHysteresis = (trial & 1) ? random(100)/100.0 : 0;
+    if(findTriggerIndex(0, countToVolts1) != triggerIndexReference(0, countToVolts1)){
+      mismatches++;
+    }
+  }
+  triggerVoltage = savedTrigger[0];
+  triggerHysteresis = savedTrigger[1];
+  Serial.print("Count-domain vs voltage trigger search: ");
+  Serial.println(mismatches ? "FAIL" : "PASS");
+  allPass &= (mismatches == 0);
+
+  // Whole-window timings. The range searched for is out of reach, so the searches run the full window.
+  const char* kernelNames[] = {"firstInRange", "minMax", "sumSquares"};
+  Serial.print(DSP_SIMD ? "Cycles/sample (M7 SIMD instructions)" : "Cycles/sample (portable SIMD stand-ins)");
+  Serial.println(": kernel, scalar, SIMD");
+  for(int kernel = 0; kernel < 3; kernel++){
+    uint32_t cycles[2];
+    volatile int sink = 0;
+    for(int simd = 0; simd < 2; simd++){
+      int low, high;
+      int32_t sum;
+      uint64_t sq;
+      uint32_t start = ARM_DWT_CYCCNT;
+      switch(kernel){
+        case 0: sink = simd ? firstInRangeSIMD(data, 0, RECORD_WINDOW, -2, -1) : firstInRangeScalar(data, 0, RECORD_WINDOW, -2, -1); break;
+        case 1: simd ? minMaxSIMD(data, RECORD_WINDOW, low, high) : minMaxScalar(data, RECORD_WINDOW, low, high); sink = low + high; break;
+        case 2: simd ? sumSquaresSIMD(data, RECORD_WINDOW, sum, sq) : sumSquaresScalar(data, RECORD_WINDOW, sum, sq); sink = sum + (int)sq; break;
+      }
+      cycles[simd] = ARM_DWT_CYCCNT - start;
+    }
+    (void)sink;
+    Serial.print(kernelNames[kernel]);
+    Serial.print(", ");
+    Serial.print(cycles[0]/(double)RECORD_WINDOW, 2);
+    Serial.print(", ");
+    Serial.println(cycles[1]/(double)RECORD_WINDOW, 2);
+  }
+
+  Serial.println(allPass ? "DSP kernel self-test PASSED" : "DSP kernel self-test FAILED");
 }
 
+// -----------------------------
+/* END DSP Kernel Functions */
+// -----------------------------
+
+
+
+
+// ---------------------------
+/* BEGIN Trigger Functions */
+// ---------------------------
+
 /*
-Name: updateHScale
-Description: Updates the horizontal scale's value based on an inputted number of increments (increments being read from the UI).
-Returns: Nothing (edits global variable)
-Parameters: int "increments"
+Name: triggerHasTwoLevels
+Description: Whether a trigger type uses triggerVoltage and triggerUpper as its two thresholds (runt and slew), rather than triggerVoltage with
+its hysteresis
+Returns: bool
+Parameters: int "type" (TRIG_ value)
 */
-void updateHScale(int increments){
-  HScale += increments*HSCALE_Sensitivity;
-
-  bound(HScale, MIN_HSCALE, MAX_HSCALE);
+bool triggerHasTwoLevels(int type){
+  return type == TRIG_RUNT || type == TRIG_SLEW_LT || type == TRIG_SLEW_GT;
 }
 
 /*
-Name: updateVScale
-Description: Updates the vertical scale's value based on an inputted number of increments (increments being read from the UI).
-Returns: Nothing (edits global variable)
-Parameters: int "increments"
+Name: triggerScanBegin
+Description: Readies a streaming trigger for a new record: the current trigger settings are turned into ranges of a channel's counts (so the
+state machine never converts a sample to volts) and its times into samples.
+Returns: Nothing (sets up scan)
+Parameters: TriggerScanner& "scan", const float "countToVolts[]" (the channel's table)
 */
-void updateVScale(int increments){
-  VScale += increments*VSCALE_Sensitivity;
+void triggerScanBegin(TriggerScanner& scan, const float countToVolts[]){
+  bool twoLevels = triggerHasTwoLevels(triggerType);
+  double lower = twoLevels ? triggerVoltage : triggerVoltage - triggerHysteresis;
+  double upper = twoLevels ? ((triggerUpper > triggerVoltage) ? triggerUpper : triggerVoltage) : triggerVoltage;
+
+  scan.type = triggerType;
+  scan.state = TRIG_ST_UNKNOWN;
+  scan.mark = -1;
+  codeRange(countToVolts, -INFINITY, lower, scan.lowFirst, scan.lowLast);
+  codeRange(countToVolts, nextafter(lower, -INFINITY), INFINITY, scan.notLowFirst, scan.notLowLast); // volts >= lower
+  codeRange(countToVolts, nextafter(upper, -INFINITY), INFINITY, scan.highFirst, scan.highLast);     // volts >= upper
+  scan.time1 = (int)lround(triggerTime1/sampleDt);
+  scan.time2 = (int)lround(triggerTime2/sampleDt);
+}
 
-  bound(VScale, 0, MAX_VSCALE);
+/*
+Name: windowInRange
+Description: firstInRange on a window of the record, in record indexes
+Returns: int "index" (record index, or -1 if there is none)
+Parameters: const sample_t "window[]" (window[k] is record index base + k), int "base", int "start", int "end", int "lo", int "hi"
+*/
+inline int windowInRange(const sample_t window[], int base, int start, int end, int lo, int hi){
+  int index = firstInRange(window, start - base, end - base, lo, hi);
+  return (index < 0) ? -1 : base + index;
 }
 
 /*
-Name: updateUI
-Description: The central UI function. Uses a switchcase to determine which global variable is currently selected for editing. To the user, this is what
-allows them to edit the oscilloscope's control values (ex: trigger voltage, or whether or not to display a waveform)
-Returns: Nothing (edits global variables)
-Parameters: None
+Name: triggerScan
+Description: Runs a streaming trigger over samples start to end of a record, carrying on from where the last call left off, so a record can be
+scanned as it arrives in chunks of any size. The states waiting for a level jump straight to the next sample that reaches it with the
+firstInRange kernel; only the short stretches between the runt/slew thresholds are stepped through a sample at a time.
+Returns: int "index" (record index the qualifying event started at, or -1 if nothing has qualified yet). Pulses and runts start at their rising
+crossing of the lower threshold, slew edges at their first sample past it, and a timeout at the crossing it was timed from.
+Parameters: TriggerScanner& "scan" (set up by triggerScanBegin), const sample_t "window[]" (window[k] is record index base + k), int "base",
+int "start", int "end" (record indexes, within the window)
 */
-void updateUI(){
-  switch(menuSelected){
-    
-    case 0: //"General Menu"
-      menuSelecting += readEncoder2Change();
-      menuSelecting = menuSelecting % 4; // Bound the selector to be values 0-3 because there are only 0-3 options
-      if(checkButton2() == true){
-        menuSelected = menuSelecting;
-      }
-    break;
+int triggerScan(TriggerScanner& scan, const sample_t window[], int base, int start, int end){
+  bool twoLevels = triggerHasTwoLevels(scan.type);
+  bool timing = (scan.type == TRIG_TIMEOUT && scan.mark >= 0);
+  int deadline = scan.mark + scan.time1 + 1; // A timeout qualifies once this sample is reached without a crossing
+  int i = start;
+
+  while(i < end){
+    int stop = (timing && deadline < end) ? deadline : end;
+    int next;
+
+    switch(scan.state){
+      case TRIG_ST_UNKNOWN:
+        next = windowInRange(window, base, i, end, scan.lowFirst, scan.lowLast);
+        if(next < 0){
+          return -1;
+        }
+        scan.state = TRIG_ST_LOW;
+        i = next + 1;
+      break;
 
-    case 1: //"Channels Menu"
-      switch(chDataSelected){
-        case 0: //"Channels Menu"
-          chDataSelecting += readEncoder2Change();
-          chDataSelecting = chDataSelecting % 5; // Bound the selector to be values 0-4 because there are only 0-4 options
-          if(checkButton2() == true){
-          chDataSelected = chDataSelecting;
+      case TRIG_ST_LOW:
+        if(twoLevels){
+          next = windowInRange(window, base, i, end, scan.notLowFirst, scan.notLowLast);
+        }else{
+          next = windowInRange(window, base, i, stop, scan.highFirst, scan.highLast);
+        }
+        if(next < 0){
+          return (timing && stop == deadline) ? scan.mark : -1;
+        }
+        scan.mark = next;
+        if(twoLevels){
+          scan.state = TRIG_ST_MID;
+          i = next; // The MID state looks at this sample too, in case it is already past the upper threshold
+        }else{
+          scan.state = TRIG_ST_HIGH;
+          i = next + 1;
+        }
+      break;
+
+      case TRIG_ST_MID:
+        for(; i < end; i++){
+          int count = window[i - base];
+          if(count >= scan.highFirst && count <= scan.highLast){
+            int transit = i - scan.mark;
+            if((scan.type == TRIG_SLEW_LT && transit < scan.time1) || (scan.type == TRIG_SLEW_GT && transit > scan.time1)){
+              return scan.mark;
+            }
+            scan.state = TRIG_ST_HIGH;
+            break;
           }
-        break;
-        case 1: // "Show Wave 1"
-          if(checkButton2() == true){
-            if(showWave1 == true){
-              showWave1 = false;
-            }else{
-              showWave1 = true;
-            }
-          }
-        break;
-        case 2: // "Show wave 2"
-          if(checkButton2() == true){
-            if(showWave2 == true){
-              showWave2 = false;
-            }else{
-              showWave2 = true;
-            }
-          }
-        break;
-        case 3: // "Show CH1 measurements"
-          if(checkButton2() == true){
-            if(showMeas1 == true){
-              showMeas1 = false;
-            }else{
-              showMeas1 = true;
-            }
-          }
-        break;
-        case 4: // "Show CH2 measurements"
-          if(checkButton2() == true){
-            if(showMeas2 == true){
-              showMeas2 = false;
-            }else{
-              showMeas2 = true;
+          if(count >= scan.lowFirst && count <= scan.lowLast){
+            if(scan.type == TRIG_RUNT){
+              return scan.mark;
             }
+            scan.state = TRIG_ST_LOW; // An edge that turned back
+            break;
           }
-        break;
-        default: // "General Menu"
-          menuSelecting += readEncoder2Change();
-          menuSelecting = menuSelecting % 4; // Bound the selector to be values 0-3 because there are only 0-3 options
-          if(checkButton2() == true){
-            menuSelecting = menuSelected;
+        }
+        i++;
+      break;
+
+      case TRIG_ST_HIGH:
+        next = windowInRange(window, base, i, stop, scan.lowFirst, scan.lowLast);
+        if(next < 0){
+          return (timing && stop == deadline) ? scan.mark : -1;
+        }
+        scan.state = TRIG_ST_LOW;
+        i = next + 1;
+        if(scan.type == TRIG_WIDTH_LT || scan.type == TRIG_WIDTH_GT || scan.type == TRIG_WIDTH_IN){
+          int width = next - scan.mark;
+          if((scan.type == TRIG_WIDTH_LT && width < scan.time1) || (scan.type == TRIG_WIDTH_GT && width > scan.time1)
+             || (scan.type == TRIG_WIDTH_IN && width >= scan.time1 && width <= scan.time2)){
+            return scan.mark;
           }
-      }
-    break;
+        }
+        if(scan.type == TRIG_TIMEOUT){
+          scan.mark = next;
+        }
+      break;
+    }
 
-    case 2: // "Trigger voltage selection"
-      updateTrigger(readEncoder2Change());
-    break;
-    case 3: // "Scaling selection"
-      updateVScale(readEncoder1Change());
-      updateHScale(readEncoder2Change());
-    break;
+    timing = (scan.type == TRIG_TIMEOUT && scan.mark >= 0);
+    deadline = scan.mark + scan.time1 + 1;
   }
 
-  updateButton1();
+  return (timing && i == deadline) ? scan.mark : -1;
 }
 
+/*
+Name: findTrigger
+Description: Finds a channel's trigger index in a record with the selected trigger type: the edge search of findTriggerIndex(), or a streaming
+trigger run over the record a window at a time, until it qualifies.
+Returns: int "index" (0 if the record has no trigger)
+Parameters: int "ch" (0 or 1), const float "countToVolts[]" (the channel's table)
+*/
+int findTrigger(int ch, const float countToVolts[]){
+  if(triggerType == TRIG_EDGE){
+    return findTriggerIndex(ch, countToVolts);
+  }
+
+  sample_t window[RECORD_WINDOW];
+  TriggerScanner scan;
+  triggerScanBegin(scan, countToVolts);
+  int index = -1;
+  for(int base = 0; base < NUM_SAMPLES && index < 0; base += RECORD_WINDOW){
+    int n = min(RECORD_WINDOW, NUM_SAMPLES - base);
+    loadRecordWindow(ch, base, n, window);
+    index = triggerScan(scan, window, base, base, base + n);
+  }
+  return (index > 0) ? index : 0;
+}
 
 /*
-Name: UITerninalTest
-Description: Used for testing & debugging. Replaces the oscilloscope's screen with terminal print outs of the menu. (For use in DUMMY mode)
+Name: testTriggers
+Description: Used for testing & debugging. Synthesizes a record on channel 1 with a narrow and a wide pulse, a runt, a slow edge and a long quiet
+stretch, and checks that each trigger type finds its event, fed the record a window at a time and in random chunks. Reports each type's
+cycles per sample against the cycles there are between samples. Overwrites channel 1 of the record.
 Returns: Nothing (prints to terminal)
 Parameters: None
 */
-void UITerminalTest(){
-  Serial.println("------------------- UI Test ----------------------");
-
-  updateButton1();
-  
-  #if DUMMY
-  if(showMenu == true){
-  Serial.println("_____MENU_____");
-  Serial.print("Select-ed: ");
-  switch(menuSelected){
-    case 0:
-    Serial.println("Menu");
-    break;
+void testTriggers(){
+  sample_t window[RECORD_WINDOW];
+  double savedSettings[6] = {triggerVoltage, triggerHysteresis, triggerUpper, triggerTime1, triggerTime2, (double)triggerType};
+  bool allPass = true;
 
-    case 1:
-    Serial.println("Channels");
-    Serial.print("dataSelect-ed: ");
-    switch(chDataSelected){
-      case 0:
-      Serial.println("Channel Menu");
-      break;
-      
-      case 1:
-      Serial.println("showWave1");
-      break;
+  // Volts at each sample: 0 V, with 2 V pulses at 100 (10 samples wide) and 300 (50 wide), a 1.4 V runt at 500, and a 40 sample ramp
+  // up to 2 V at 700 that falls back at 900
+  for(int i = 0; i < NUM_SAMPLES; i++){
+    double volts = 0;
+    if((i >= 100 && i < 110) || (i >= 300 && i < 350) || (i >= 740 && i < 900)){
+      volts = 2.0;
+    }else if(i >= 500 && i < 520){
+      volts = 1.4;
+    }else if(i >= 700 && i < 740){
+      volts = 2.0*(i - 700 + 0.5)/40;
+    }
+    setRecordSample(0, i, voltsToCode(countToVolts1, volts));
+  }
 
-      case 2:
-      Serial.println("showWave2");
-      break;
+  triggerVoltage = 1.0;
+  triggerHysteresis = 0.2;
+  triggerUpper = 1.8;
+  triggerTime2 = 60*sampleDt;
+
+  // Type, triggerTime1 (samples), expected index: the narrow pulse, the wide one, the runt, the last crossing before the quiet stretch,
+  // the (step) edge of the narrow pulse, and the ramp's first sample past 1 V
+  const int cases[][3] = {{TRIG_WIDTH_LT, 20, 100}, {TRIG_WIDTH_GT, 20, 300}, {TRIG_WIDTH_IN, 30, 300}, {TRIG_RUNT, 0, 500},
+                          {TRIG_TIMEOUT, 500, 900}, {TRIG_SLEW_LT, 10, 100}, {TRIG_SLEW_GT, 10, 720}};
+  const int numCases = sizeof(cases)/sizeof(cases[0]);
+  double budget = sampleDt*F_CPU_ACTUAL; // Cycles between two samples
+
+  Serial.print("Trigger type, found, chunked, cycles/sample (budget ");
+  Serial.print(budget, 0);
+  Serial.println(")");
+  for(int c = 0; c < numCases; c++){
+    triggerType = cases[c][0];
+    triggerTime1 = cases[c][1]*sampleDt;
+
+    uint32_t start = ARM_DWT_CYCCNT;
+    int found = findTrigger(0, countToVolts1);
+    uint32_t cycles = ARM_DWT_CYCCNT - start;
+
+    TriggerScanner scan;
+    triggerScanBegin(scan, countToVolts1);
+    int chunked = -1;
+    for(int pos = 0; pos < NUM_SAMPLES && chunked < 0;){
+      int end = min(NUM_SAMPLES, pos + 1 + (int)random(64));
+      loadRecordWindow(0, pos, end - pos, window);
+      chunked = triggerScan(scan, window, pos, pos, end);
+      pos = end;
+    }
 
-      case 3:
-      Serial.println("showMeas1");
-      break;
+    bool pass = (found == cases[c][2]) && (chunked == found);
+    allPass &= pass;
+    Serial.print(triggerTypeNames[triggerType]);
+    Serial.print(", ");
+    Serial.print(found);
+    Serial.print(", ");
+    Serial.print(chunked);
+    Serial.print(", ");
+    Serial.print(cycles/(double)NUM_SAMPLES, 2);
+    Serial.println(pass ? "" : "  FAIL");
+  }
 
-      case 4:
-      Serial.println("showMeas2");
-      break;
-    }
-    Serial.print("dataSelect-ing: ");
-    switch(chDataSelecting){
-      case 0:
-      Serial.println("Channel Menu");
-      break;
-      
-      case 1:
-      Serial.println("showWave1");
-      break;
+  triggerVoltage = savedSettings[0];
+  triggerHysteresis = savedSettings[1];
+  triggerUpper = savedSettings[2];
+  triggerTime1 = savedSettings[3];
+  triggerTime2 = savedSettings[4];
+  triggerType = (int)savedSettings[5];
 
-      case 2:
-      Serial.println("showWave2");
-      break;
+  Serial.println(allPass ? "Trigger self-test PASSED" : "Trigger self-test FAILED");
+}
 
-      case 3:
-      Serial.println("showMeas1");
-      break;
+// ---------------------------
+/* END Trigger Functions */
+// ---------------------------
 
-      case 4:
-      Serial.println("showMeas2");
-      break;
-    }
 
-    break;
 
-    case 2:
-    Serial.println("Trigger Voltage");
-    break;
-    
-    case 3:
-    Serial.println("Scaling");
-    break;
-  }
 
-  Serial.print("Select-ing: ");
-  switch(menuSelecting){
-    case 0:
-    Serial.println("Menu");
-    break;
+// ------------------------------------------
+/* BEGIN Measurement Statistics Functions */
+// ------------------------------------------
 
-    case 1:
-    Serial.println("Channels");
-    break;
+/*
+Name: resetStats
+Description: Clears every measurement's running statistics
+Returns: Nothing (edits global variables)
+Parameters: None
+*/
+void resetStats(){
+  memset(measStats, 0, sizeof(measStats));
+}
 
-    case 2:
-    Serial.println("Trigger Voltage");
-    break;
-    
-    case 3:
-    Serial.println("Scaling");
-    break;
+/*
+Name: addStat
+Description: Adds one measurement to its running statistics (Welford's update: a handful of operations, no stored history)
+Returns: Nothing (edits the provided statistics)
+Parameters: MeasStats& "stats", double "value"
+*/
+void addStat(MeasStats& stats, double value){
+  stats.count++;
+  double delta = value - stats.mean;
+  stats.mean += delta/stats.count;
+  stats.m2 += delta*(value - stats.mean);
+
+  if(stats.count == 1 || value < stats.min){
+    stats.min = value;
   }
+  if(stats.count == 1 || value > stats.max){
+    stats.max = value;
+  }
+}
 
-  Serial.println("CURRENT VALUES:");
-  Serial.print("Trigger Voltage: ");
-  Serial.println(triggerVoltage);
-  Serial.print("H_Scale: ");
-  Serial.println(HScale);
-  Serial.print("V_Scale: ");
-  Serial.println(VScale);
-  Serial.print("showWave1: ");
-  Serial.println(showWave1);
-  Serial.print("showWave2: ");
-  Serial.println(showWave2);
-  Serial.print("showMeas1: ");
-  Serial.println(showMeas1);
-  Serial.print("showMeas2: ");
-  Serial.println(showMeas2);
-  updateUI();
-}else{
-
+/*
+Name: statSigma
+Description: Sample standard deviation of a measurement's accumulated values
+Returns: double "sigma" (0 until two values have been accumulated)
+Parameters: const MeasStats& "stats"
+*/
+double statSigma(const MeasStats& stats){
+  return (stats.count > 1) ? sqrt(stats.m2/(stats.count - 1)) : 0;
 }
-#endif
+
+/*
+Name: printStats
+Description: Prints every measurement's count, mean, standard deviation, minimum and maximum
+Returns: Nothing (prints to terminal)
+Parameters: None
+*/
+void printStats(){
+  const char* names[NUM_STATS] = {"CH1 P2P (V)", "CH1 T (s)", "CH2 P2P (V)", "CH2 T (s)"};
+
+  Serial.println("measurement, count, mean, sigma, min, max");
+  for(int i = 0; i < NUM_STATS; i++){
+    Serial.print(names[i]);
+    Serial.print(", ");
+    Serial.print(measStats[i].count);
+    Serial.print(", ");
+    Serial.print(measStats[i].mean, 9);
+    Serial.print(", ");
+    Serial.print(statSigma(measStats[i]), 9);
+    Serial.print(", ");
+    Serial.print(measStats[i].min, 9);
+    Serial.print(", ");
+    Serial.println(measStats[i].max, 9);
+  }
 }
 
+/*
+Name: calcP2P
+Description: calcP2P = "calculate peak-to-peak." Peak-to-peak voltage of a channel's 320-value long plotting array, from the lowest and
+highest of its raw counts (the count -> volts table is monotonic, so they hold the extreme voltages).
+Returns: Nothing (updates global variable)
+Parameters: int "ch" (0 = channel 1, 1 = channel 2)
+*/
+void calcP2P(int ch){
+  const float* countToVolts = (ch == 0) ? countToVolts1 : countToVolts2;
+  int low, high;
+  minMax((const sample_t*)sigRaw[ch], LX, low, high);
+  CH_P2P[ch] = fabs(countToVolts[high] - countToVolts[low]);
+}
 
+/*
+Name: calcPeriod
+Description: Period of a channel's record from its half period: (1) Determines if the waveform is increasing or decreasing from the first
+point. (2) Waits until the value 'comes back around' past the first point, which would be half a period. The record is read a window at a time,
+through the channel's count -> volts table.
+Returns: double "period" (seconds, or -1 if a period couldn't be found)
+Parameters: int "ch" (0 or 1)
+*/
+double calcPeriod(int ch){
+  const float* countToVolts = (ch == 0) ? countToVolts1 : countToVolts2;
+  const double sample = countToVolts[recordSample(ch, 0)];
+  sample_t window[RECORD_WINDOW];
+  int slope = 0;
+  int signCounter = 0;
 
+  // Determine the waveform's slope direction (positive or negative)
+  for(int base = 0; base < NUM_SAMPLES && slope == 0; base += RECORD_WINDOW){
+    int n = min(RECORD_WINDOW, NUM_SAMPLES - base);
+    loadRecordWindow(ch, base, n, window);
+    for(int i = (base == 0) ? 1 : 0; i < n; i++){
+      double volts = countToVolts[window[i]];
+      if(volts < sample){
+        signCounter--;
+      }else if(volts > sample){
+        signCounter++;
+      }
 
-//--------------------------
-/* END  UI Functions */
-// -------------------------
-#endif
+      if(signCounter <= -3 || signCounter >= 3){ // If three or more repeated in/decreases of value are detected, slope sign can be determined
+        slope = (signCounter < 0) ? -1 : 1;
+        break;
+      }
+    }
+  }
 
+  // Using the slope direction, look for when the value 'comes back around': that index is half a period. The period is -1 if it could not
+  // be determined
+  for(int base = 0; base < NUM_SAMPLES && slope != 0; base += RECORD_WINDOW){
+    int n = min(RECORD_WINDOW, NUM_SAMPLES - base);
+    loadRecordWindow(ch, base, n, window);
+    for(int i = (base == 0) ? 1 : 0; i < n; i++){
+      double volts = countToVolts[window[i]];
+      if((slope < 0 && volts > sample) || (slope > 0 && volts < sample)){
+        return ((base + i)*2.0)*sampleDt;
+      }
+    }
+  }
+  return -1;
+}
 
+/*
+Name: calcT
+Description: Calculates the period of a channel, or -1 if a period couldn't be found.
+Returns: Nothing (updates global variable)
+Parameters: int "ch" (0 = channel 1, 1 = channel 2)
+*/
+void calcT(int ch){
+  #if dummy 
+    CH_T[ch] = 999;
+  #endif
+  
+  #if !dummy
+    CH_T[ch] = calcPeriod(ch);
+  #endif
+}
 
-// ----------------------
-/* BEGIN ADC FUNCTIONS */
-// ----------------------
+/*
+Name: measureChannels
+Description: Takes every channel's measurements (peak-to-peak from the plotted points, period from the record). Run by extractPlottingData()
+each time the plotted points change, so the display only reads them.
+Returns: Nothing (updates global variables)
+Parameters: None
+*/
+void measureChannels(){
+  for(int ch = 0; ch < NUM_CHANNELS; ch++){
+    calcP2P(ch);
+    calcT(ch);
+  }
+}
 
 /*
-Name: sampleChannels
-Description: Sample ADC0 and ADC1 on the Teensy 4.1 (for channel 1 & 2) 4000 times, and store it in an array of unsigned 16-bit values.
-The 16-bit value was chosen because the ADC has 10-bit resolution, and 16-bit was the next largest value for storing it.
-Returns: Nothing (updates global arrays)
+Name: addMeasStats
+Description: With statistics on, adds every channel's latest measurements to their running statistics. Called once per acquired (or replayed)
+record, so a held record isn't counted again however often it is redrawn or re-measured.
+Returns: Nothing (updates global variables)
 Parameters: None
 */
-void sampleChannels(){
-  #if DUMMY
-    for(int i = 0; i < NUM_SAMPLES; i++){
-      rawData1[i] = (int)(i%1023);
-      rawData2[i] = (int)(1023 - i%1023);
+void addMeasStats(){
+  if(!showStats){
+    return;
+  }
+  for(int ch = 0; ch < NUM_CHANNELS; ch++){
+    addStat(measStats[(ch == 0) ? STAT_CH1_P2P : STAT_CH2_P2P], CH_P2P[ch]);
+    if(CH_T[ch] > 0){
+      addStat(measStats[(ch == 0) ? STAT_CH1_T : STAT_CH2_T], CH_T[ch]); // -1 = no period found
     }
-  #endif
+  }
+}
 
-  #if !DUMMY
-  for(int i = 0; i < NUM_SAMPLES; i++){
-  while(adc->adc0->isConverting() || adc->adc1->isConverting());
+// ----------------------------------------
+/* END Measurement Statistics Functions */
+// ----------------------------------------
 
-  uint16_t ch1Val = adc->adc0->readSingle();
-  uint16_t ch2Val = adc->adc1->readSingle();
 
-  rawData1[i] = ch1Val;
-  rawData2[i] = ch2Val;
 
-  adc->startSynchronizedSingleRead(CH1_PIN, CH2_PIN);
+
+// ------------------------------
+/* BEGIN Math Channel Functions */
+// ------------------------------
+
+const char* mathCursor; // Parse position while compiling a math expression
+
+/*
+Name: mathTermIndex
+Description: Index into a math polynomial (see MATH_TERMS) of the term A^expA * B^expB
+Returns: int (0 to MATH_TERMS-1, or -1 if the term is above second order)
+Parameters: int "expA", int "expB"
+*/
+int mathTermIndex(int expA, int expB){
+  const int index[3][3] = {{0, 2, 5}, {1, 3, -1}, {4, -1, -1}}; // [expA][expB]
+  if(expA + expB > 2){
+    return -1;
   }
-  #endif
+  return index[expA][expB];
 }
 
 /*
-Name: updateVoltageData
-Description: Update the global 1D arrays in units volts for channel 1 and channel 2. (i.e. convert the 10-bit
-ADC value into a value representing the real-world voltage being sampled, and store it in the corresponding arrays). Additionally,
-determine where in the signal data the trigger voltage first appears, and store this index for read-back later.
-Returns: Nothing (updates global arrays)
-Parameters: None
+Name: mathPolyMultiply
+Description: Multiplies two math polynomials. Fails if the product would be above second order (e.g. A*A*B), which the math channel can't evaluate.
+Returns: bool (true on success)
+Parameters: float "x[]", float "y[]", float "out[]" (MATH_TERMS long, may be the same array as x or y)
 */
-void updateVoltageData(){
-  sig1TrigIndex = 0;
-  sig2TrigIndex = 0;
-
-  for(int i = 0; i < NUM_SAMPLES; i ++){
-    // Take the fraction of the full range that the value represents (raw/1023), multiply it by full voltage range, add the lower bound
-    voltageData1[i] = upperVoltage - ((rawData1[i]*1.0)/1023)*(upperVoltage - lowerVoltage);
-    voltageData2[i] = upperVoltage - ((rawData2[i]*1.0)/1023)*(upperVoltage - lowerVoltage);
-
-    // Determine where the trigger voltage starts in the waveform (with +/- 5% error allowed for trigger voltage)
-    if(sig1TrigIndex == 0 && (voltageData1[i] > (0.95*triggerVoltage) && voltageData1[i] < (1.05*triggerVoltage))){
-      sig1TrigIndex = i;
-    }
-    if(sig2TrigIndex == 0 && (voltageData2[i] > (0.95*triggerVoltage) && voltageData2[i] < (1.05*triggerVoltage))){
-      sig2TrigIndex = i;
+bool mathPolyMultiply(const float x[], const float y[], float out[]){
+  const int expA[MATH_TERMS] = {0, 1, 0, 1, 2, 0};
+  const int expB[MATH_TERMS] = {0, 0, 1, 1, 0, 2};
+  float result[MATH_TERMS] = {0};
+
+  for(int i = 0; i < MATH_TERMS; i++){
+    for(int j = 0; j < MATH_TERMS; j++){
+      if(x[i] == 0 || y[j] == 0){
+        continue;
+      }
+      int term = mathTermIndex(expA[i] + expA[j], expB[i] + expB[j]);
+      if(term < 0){
+        return false;
+      }
+      result[term] += x[i]*y[j];
     }
   }
+
+  memcpy(out, result, sizeof(result));
+  return true;
 }
 
+bool mathParseExpr(float out[]);
+
 /*
-Name: extractPlottingData
-Description: Using the horizontal scale (HScale) and the time-per-sample (smapleDt), index the NUM_SAMPLES length array 
-to extract 320 points for plotting on the 320-pixel wide TFT display.
-Returns: Nothing (updates global arrays)
-Parameters: None
+Name: mathParseFactor
+Description: Compiles one factor of a math expression: a number, A, B, a negated factor, or a parenthesized expression
+Returns: bool (true on success)
+Parameters: float "out[]" (MATH_TERMS long polynomial to write)
 */
-void extractPlottingData(){
-  int indexRange = 320;
-  double stride = 0;
-  double strideIndex = 0;;
-  
-  indexRange = (int)((32.0*HScale)/sampleDt);
+bool mathParseFactor(float out[]){
+  while(*mathCursor == ' '){
+    mathCursor++;
+  }
 
-  bound(indexRange, 1, NUM_SAMPLES);
+  memset(out, 0, sizeof(float)*MATH_TERMS);
+
+  if(*mathCursor == '-'){
+    mathCursor++;
+    if(!mathParseFactor(out)){
+      return false;
+    }
+    for(int t = 0; t < MATH_TERMS; t++){
+      out[t] = -out[t];
+    }
+    return true;
+  }
+  if(*mathCursor == '('){
+    mathCursor++;
+    if(!mathParseExpr(out)){
+      return false;
+    }
+    while(*mathCursor == ' '){
+      mathCursor++;
+    }
+    if(*mathCursor != ')'){
+      return false;
+    }
+    mathCursor++;
+    return true;
+  }
+  if(*mathCursor == 'A' || *mathCursor == 'a'){
+    mathCursor++;
+    out[mathTermIndex(1, 0)] = 1;
+    return true;
+  }
+  if(*mathCursor == 'B' || *mathCursor == 'b'){
+    mathCursor++;
+    out[mathTermIndex(0, 1)] = 1;
+    return true;
+  }
+  if((*mathCursor >= '0' && *mathCursor <= '9') || *mathCursor == '.'){
+    char* end;
+    out[0] = strtod(mathCursor, &end);
+    mathCursor = end;
+    return true;
+  }
+  return false;
+}
+
+/*
+Name: mathParseTerm
+Description: Compiles a product/quotient of factors. Division is only allowed by a (non-zero) constant.
+Returns: bool (true on success)
+Parameters: float "out[]" (MATH_TERMS long polynomial to write)
+*/
+bool mathParseTerm(float out[]){
+  float factor[MATH_TERMS];
+
+  if(!mathParseFactor(out)){
+    return false;
+  }
+
+  while(true){
+    while(*mathCursor == ' '){
+      mathCursor++;
+    }
+
+    if(*mathCursor == '*'){
+      mathCursor++;
+      if(!mathParseFactor(factor) || !mathPolyMultiply(out, factor, out)){
+        return false;
+      }
+    }else if(*mathCursor == '/'){
+      mathCursor++;
+      if(!mathParseFactor(factor) || factor[0] == 0){
+        return false;
+      }
+      for(int t = 1; t < MATH_TERMS; t++){
+        if(factor[t] != 0){
+          return false;
+        }
+      }
+      for(int t = 0; t < MATH_TERMS; t++){
+        out[t] /= factor[0];
+      }
+    }else{
+      return true;
+    }
+  }
+}
+
+/*
+Name: mathParseExpr
+Description: Compiles a sum/difference of terms
+Returns: bool (true on success)
+Parameters: float "out[]" (MATH_TERMS long polynomial to write)
+*/
+bool mathParseExpr(float out[]){
+  float term[MATH_TERMS];
+
+  if(!mathParseTerm(out)){
+    return false;
+  }
+
+  while(true){
+    while(*mathCursor == ' '){
+      mathCursor++;
+    }
+
+    if(*mathCursor == '+' || *mathCursor == '-'){
+      float sign = (*mathCursor == '+') ? 1 : -1;
+      mathCursor++;
+      if(!mathParseTerm(term)){
+        return false;
+      }
+      for(int t = 0; t < MATH_TERMS; t++){
+        out[t] += sign*term[t];
+      }
+    }else{
+      return true;
+    }
+  }
+}
+
+/*
+Name: compileMathExpression
+Description: Compiles a user expression in A (channel 1) and B (channel 2) using numbers, + - * / and parentheses, e.g. "A-B", "(A+B)/2" or
+"2*A*B - 0.1*A". The result is the expression expanded into the math channel's quadratic form, so nothing is interpreted per sample.
+Expressions above second order, or dividing by a channel, are rejected.
+Returns: bool (true if the expression compiled)
+Parameters: const char* "text", float "out[]" (MATH_TERMS long polynomial to write)
+*/
+bool compileMathExpression(const char* text, float out[]){
+  mathCursor = text;
+
+  if(!mathParseExpr(out)){
+    return false;
+  }
+  while(*mathCursor == ' '){
+    mathCursor++;
+  }
+  return *mathCursor == '\0';
+}
+
+/*
+Name: setMathOp
+Description: Selects the math channel's operation and loads its coefficients into mathPoly
+Returns: Nothing (edits global variables)
+Parameters: int "op" (MATH_OFF, MATH_ADD, MATH_SUB, MATH_MUL or MATH_EXPR)
+*/
+void setMathOp(int op){
+  memset(mathPoly, 0, sizeof(mathPoly));
+
+  switch(op){
+    case MATH_ADD:
+      mathPoly[mathTermIndex(1, 0)] = 1;
+      mathPoly[mathTermIndex(0, 1)] = 1;
+    break;
+    case MATH_SUB:
+      mathPoly[mathTermIndex(1, 0)] = 1;
+      mathPoly[mathTermIndex(0, 1)] = -1;
+    break;
+    case MATH_MUL:
+      mathPoly[mathTermIndex(1, 1)] = 1;
+    break;
+    case MATH_EXPR:
+      memcpy(mathPoly, mathExprPoly, sizeof(mathPoly));
+    break;
+  }
+
+  mathOp = op;
+  mathVersion++;
+}
+
+/*
+Name: mathValue
+Description: The selected math operation's value for one pair of channel voltages (the compiled quadratic, see setMathOp)
+Returns: double "value"
+Parameters: double "a" (channel 1 volts), double "b" (channel 2 volts)
+*/
+inline double mathValue(double a, double b){
+  return mathPoly[0] + a*(mathPoly[1] + mathPoly[3]*b + mathPoly[4]*a) + b*(mathPoly[2] + mathPoly[5]*b);
+}
+
+/*
+Name: mathOpName
+Description: Short name of the selected math operation for the display (the expression's text for MATH_EXPR)
+Returns: const char* (name)
+Parameters: None
+*/
+const char* mathOpName(){
+  switch(mathOp){
+    case MATH_ADD:  return "A+B";
+    case MATH_SUB:  return "A-B";
+    case MATH_MUL:  return "A*B";
+    case MATH_EXPR: return mathExprText;
+  }
+  return "Off";
+}
+
+// ------------------------------
+/* END Math Channel Functions */
+// ------------------------------
+
+
+
+#if runUI
+// ---------------------
+/* BEGIN UI Functions */
+// ---------------------
+
+
+
+
+/*
+Name: checkButton1
+Description: Returns the boolean state of button 1
+Returns: bool "button1State"
+Parameters: None
+*/
+// Returns the boolean state of button 1
+bool checkButton1(){
+  #if DUMMY
+    int input;
+
+    Serial.println("ENTER BUTTON 1");
+    while(Serial.available() == 0){
+
+    }
+    input = Serial.parseInt();
+
+    button1State = input;
+    // Serial.print("Button1 State: ");
+    Serial.println(button1State);
+  #endif
+  #if !DUMMY
+    button1.update();
+    button1State = button1.fell();
+  #endif
+
+  return button1State;
+}
+
+/*
+Name: checkButton2
+Description: Returns the boolean state of button 2
+Returns: bool "button2State"
+Parameters: None
+*/
+// Returns the boolean state of button 2
+bool checkButton2(){
+  #if DUMMY
+    int input;
+
+    Serial.println("ENTER BUTTON 2");
+    while(Serial.available() == 0){
+
+    }
+    input = Serial.parseInt();
+
+    button2State = input;
+    // Serial.print("Button2 State: ");
+    Serial.println(button2State);
+  #endif
+  #if !DUMMY
+    button2.update();
+    button2State = button2.fell();
+  #endif
+  
+  return button2State;
+}
+
+/*
+Name: checkButton3
+Description: Returns the boolean state of button 3
+Returns: bool "button3State"
+Parameters: None
+*/
+// Returns the boolean state of button 3
+bool checkButton3(){
+  #if DUMMY
+    int input;
+
+    Serial.println("ENTER BUTTON 3");
+    while(Serial.available() == 0){
+
+    }
+    input = Serial.parseInt();
+
+    button3State = input;
+    // Serial.print("Button3 State: ");
+    Serial.println(button3State);
+  #endif
+  #if !DUMMY
+    button3.update();
+    button3State = button3.fell();
+  #endif
+  
+  return button3State;
+}
+
+/*
+Name: checkButton4
+Description: Returns the boolean state of button 4
+Returns: bool "button4State"
+Parameters: None
+*/
+// Returns the boolean state of button 4
+bool checkButton4(){
+  #if DUMMY
+    int input;
+
+    Serial.println("ENTER BUTTON 4");
+    while(Serial.available() == 0){
+
+    }
+    input = Serial.parseInt();
+
+    button4State = input;
+    // Serial.print("Button4 State: ");
+    Serial.println(button4State);
+  #endif
+  #if !DUMMY
+    button4.update();
+    button4State = button4.fell();
+  #endif
+  
+  return button4State;
+}
+
+/*
+Name: readEncoder1Change
+Description: Returns the number of rotary clicks registered by encoder 1. Actual clicks are divided out by ENC_SENSITIVITY to prevent
+misreads from small variations in the encoder rotation.
+Returns: int "difference"
+Parameters: None
+*/
+int readEncoder1Change(){
+  int difference;
+
+  #if DUMMY
+    int input;
+
+    Serial.println("ENTER ENCODER 1");
+    while(Serial.available() == 0){
+
+    }
+    input = Serial.parseInt();
+
+    difference = input;
+    // Serial.print("Encoder1 Change: ");
+    Serial.println(difference);
+  #endif
+
+  #if !DUMMY
+  enc1New = encoder1.read();
+
+  difference = enc1New - enc1Old;
+  #endif
+
+  if(abs(difference) >= ENC_Sensitivity){
+    enc1Old = enc1New;
+    return difference / ENC_Sensitivity;
+  }else{
+    return 0;
+  }
+}
+
+/*
+Name: readEncoder2Change
+Description: Returns the number of rotary clicks registered by encoder 2. Actual clicks are divided out by ENC_SENSITIVITY to prevent
+misreads from small variations in the encoder rotation.
+Returns: int "difference"
+Parameters: None
+*/
+int readEncoder2Change(){
+  int difference;
+
+  #if DUMMY
+    int input;
+
+    Serial.println("ENTER ENCODER 2");
+    while(Serial.available() == 0){
+
+    }
+    input = Serial.parseInt();
+
+    difference = input;
+    Serial.println(difference);
+  #endif
+
+  #if !DUMMY
+  enc2New = encoder2.read();
+
+  difference = enc2New - enc2Old;
+  #endif
+
+  if(abs(difference) >= ENC_Sensitivity){
+    enc2Old = enc2New;
+    return difference / ENC_Sensitivity;
+  }else{
+    return 0;
+  }
+}
+
+
+/*
+Name: resetMenu
+Description: Resets all the global selector variables for the UI's menu.
+Returns: Nothing (edits global variables)
+Parameters: None
+*/
+void resetMenu(){
+  menuSelected = 0;
+  menuSelecting = 0;
+  chDataSelected = 0;
+  chDataSelecting = 0;
+}
+
+
+/*
+Name: updateButton1
+Description: Updates the menu selection process based on the value of button 1. (Per cycle button 1 check)
+Returns: Nothing (edits global variables)
+Parameters: None
+*/
+void updateButton1(){  
+  if(checkButton1() == true){
+    //Open menu 
+    if(showMenu == 0){
+      showMenu = 1;
+        return;
+    }
+
+    // Close menu
+    if(menuSelected == 0){
+      showMenu = 0;
+      resetMenu();
+      return;
+    }
+    
+    // Go back to "main menu" unless "channels" is selected, then go back to "main channels menu"
+    if(menuSelected > 0){
+      if(menuSelected == 1){
+        if(chDataSelected > 0){
+          chDataSelected = 0;
+          chDataSelecting = 0;
+          return;
+        }else{
+          resetMenu();
+        }
+      }else{
+        resetMenu();
+        return;
+      }
+    }
+  }
+}
+
+/*
+Name: updateTrigger
+Description: Updates the trigger voltage's value based on an inputted number of increments (increments being read from the UI).
+Returns: Nothing (edits global variables)
+Parameters: int "increments"
+*/
+void updateTrigger(int increments){
+  triggerVoltage += increments*TRIGGER_Sensitivity;
+
+  bound(triggerVoltage, 0, MAX_TRIGGER);
+}
+
+/*
+Name: clampZoomOffset
+Description: Works out how many record samples the zoom window covers at the current HScale (as extractPlottingData will spread across the
+screen) and keeps zoomOffset where that window stays inside the record. Called whenever either changes, so a pan never starts from an offset
+left over from a shorter timebase.
+Returns: Nothing (edits global variables)
+Parameters: None
+*/
+void clampZoomOffset(){
+  zoomSamples = (int)((32.0*HScale)/sampleDt);
+  bound(zoomSamples, 1, NUM_SAMPLES);
+  bound(zoomOffset, -trigIndex, NUM_SAMPLES - zoomSamples - trigIndex);
+}
+
+/*
+Name: hscaleStep
+Description: The timebase as a whole number of HSCALE_Sensitivity steps, for comparing two HScales without comparing doubles. HScale only leaves
+that grid when clamped to a limit worked out from the record (see shortestHScale), and those round to the nearest step.
+Returns: int (step index)
+Parameters: double "scale" (an HScale)
+*/
+int hscaleStep(double scale){
+  return (int)lround(scale/HSCALE_Sensitivity);
+}
+
+/*
+Name: updateHScale
+Description: Updates the horizontal scale's value based on an inputted number of increments (increments being read from the UI). From
+HSCALE_COARSE up the steps are 10x coarser, so the longer timebases the deep record allows are a few turns away rather than hundreds.
+Returns: Nothing (edits global variable)
+Parameters: int "increments"
+*/
+void updateHScale(int increments){
+  HScale += increments*((HScale >= HSCALE_COARSE) ? 10*HSCALE_Sensitivity : HSCALE_Sensitivity);
+
+  bound(HScale, MIN_HSCALE, MAX_HSCALE);
+  clampZoomOffset(); // The zoom window's width follows HScale
+}
+
+/*
+Name: updateVScale
+Description: Updates a channel's vertical scale value based on an inputted number of increments (increments being read from the UI).
+Returns: Nothing (edits global variable)
+Parameters: int "ch" (0 = channel 1, 1 = channel 2), int "increments"
+*/
+void updateVScale(int ch, int increments){
+  double &VScale = (ch == 0) ? CH1_VScale : CH2_VScale;
+
+  VScale += increments*VSCALE_Sensitivity;
+
+  bound(VScale, VSCALE_Sensitivity, MAX_VSCALE); // VScale divides the voltage when mapping to pixels, so it can't reach 0
+}
+
+/*
+Name: updateVPos
+Description: Updates a channel's vertical position based on an inputted number of increments (increments being read from the UI).
+Returns: Nothing (edits global variable)
+Parameters: int "ch" (0 = channel 1, 1 = channel 2), int "increments"
+*/
+void updateVPos(int ch, int increments){
+  int &VPos = (ch == 0) ? CH1_VPos : CH2_VPos;
+
+  VPos += increments*VPOS_Sensitivity;
+
+  bound(VPos, -MAX_VPOS, MAX_VPOS);
+}
+
+/*
+Name: updateMathVScale
+Description: Updates the math channel's vertical scale based on an inputted number of increments (increments being read from the UI).
+Returns: Nothing (edits global variable)
+Parameters: int "increments"
+*/
+void updateMathVScale(int increments){
+  mathVScale += increments*MATH_VSCALE_Sensitivity;
+
+  bound(mathVScale, MATH_VSCALE_Sensitivity, MAX_MATH_VSCALE);
+}
+
+/*
+Name: moveCursors
+Description: Moves the cursor pair by the inputted number of increments (increments being read from the UI), CURSOR_STEP_PIXELS screen pixels
+per increment. Time cursors are kept in record samples so they read back at full resolution whatever the HScale; voltage cursors in volts.
+Returns: Nothing (edits global variables)
+Parameters: int "increments1" (cursor 1), int "increments2" (cursor 2)
+*/
+void moveCursors(int increments1, int increments2){
+  if(cursorMode == CURSOR_TIME){
+    int step = (int)(CURSOR_STEP_PIXELS*plotStride);
+    if(step < 1){
+      step = 1;
+    }
+    cursorT1 += increments1*step;
+    cursorT2 += increments2*step;
+    bound(cursorT1, 0, NUM_SAMPLES - 1);
+    bound(cursorT2, 0, NUM_SAMPLES - 1);
+  }
+
+  if(cursorMode == CURSOR_VOLT){
+    double VScale = (cursorChannel == 0) ? CH1_VScale : CH2_VScale;
+    double step = CURSOR_STEP_PIXELS*VScale/120.0; // volts per screen pixel
+    // Screen rows grow downwards with voltage, so a positive increment (moving the line up) lowers the level
+    cursorV1 -= increments1*step;
+    cursorV2 -= increments2*step;
+    bound(cursorV1, lowerVoltage, upperVoltage);
+    bound(cursorV2, lowerVoltage, upperVoltage);
+  }
+}
+
+/*
+Name: updateRunControl
+Description: Run/Stop/Single: the run/stop press stops a running (or armed) acquisition and restarts a stopped one; the single press arms
+an acquisition that runs until a record triggers and then stops on it (see completeSingle).
+Returns: Nothing (edits global variables)
+Parameters: bool "runStopPressed", bool "singlePressed"
+*/
+void updateRunControl(bool runStopPressed, bool singlePressed){
+  if(runStopPressed){
+    acquisitionRunning = !acquisitionRunning; // An armed single is running, so this press stops it
+    singleArmed = false;
+  }
+  if(singlePressed){
+    acquisitionRunning = true;
+    singleArmed = true;
+  }
+}
+
+/*
+Name: panZoom
+Description: Moves the zoom view's window along the record by the inputted number of increments (increments being read from the UI), a
+1/ZOOM_PAN_STEPS of the window's width per increment. The window is kept inside the record.
+Returns: Nothing (edits global variable)
+Parameters: int "increments"
+*/
+void panZoom(int increments){
+  clampZoomOffset(); // Fresh zoomSamples for the step, whatever HScale was when the window was last drawn
+  int step = zoomSamples/ZOOM_PAN_STEPS;
+  if(step < 1){
+    step = 1;
+  }
+  zoomOffset += increments*step;
+  clampZoomOffset();
+}
+
+/*
+Name: wrapSelection
+Description: Wraps a menu selector into the range 0 to (count - 1), so scrolling past either end of a menu comes back around the other side.
+Returns: int (the wrapped selector)
+Parameters: int "value" (selector), int "count" (number of selectable entries)
+*/
+int wrapSelection(int value, int count){
+  return ((value % count) + count) % count;
+}
+
+/*
+Name: updateTriggerTime
+Description: Steps one of the trigger times up or down by TRIG_TIME_STEP per inputted increment (increments being read from the UI).
+Returns: Nothing (edits the provided variable)
+Parameters: double& "time" (triggerTime1 or triggerTime2), int "increments"
+*/
+void updateTriggerTime(double& time, int increments){
+  time *= pow(TRIG_TIME_STEP, increments);
+
+  bound(time, MIN_TRIG_TIME, MAX_TRIG_TIME);
+}
+
+/*
+Name: updateTriggerSettings
+Description: Updates the trigger menu: encoder 1 picks an entry (level, source, type, upper level, time 1, time 2 or hysteresis) and encoder 2
+changes it.
+Returns: Nothing (edits global variables)
+Parameters: int "itemIncrements", int "increments"
+*/
+void updateTriggerSettings(int itemIncrements, int increments){
+  triggerMenuItem = wrapSelection(triggerMenuItem + itemIncrements, TRIG_NUM_ITEMS);
+
+  switch(triggerMenuItem){
+    case TRIG_ITEM_LEVEL:
+      updateTrigger(increments);
+    break;
+    case TRIG_ITEM_SOURCE:
+      triggerSource = wrapSelection(triggerSource + increments, TRIG_NUM_SOURCES);
+    break;
+    case TRIG_ITEM_TYPE:
+      triggerType = wrapSelection(triggerType + increments, TRIG_NUM_TYPES);
+    break;
+    case TRIG_ITEM_UPPER:
+      triggerUpper += increments*TRIGGER_Sensitivity;
+      bound(triggerUpper, 0, MAX_TRIGGER);
+    break;
+    case TRIG_ITEM_TIME1:
+      updateTriggerTime(triggerTime1, increments);
+    break;
+    case TRIG_ITEM_TIME2:
+      updateTriggerTime(triggerTime2, increments);
+    break;
+    case TRIG_ITEM_HYST:
+      triggerHysteresis += increments*TRIGGER_Sensitivity;
+      bound(triggerHysteresis, 0, MAX_TRIGGER);
+    break;
+  }
+}
+
+/*
+Name: updateProcessing
+Description: Updates the acquisition processing mode (a button press steps to the next mode) and its averaging count (in powers of two, from
+the inputted number of increments). Any change restarts the average.
+Returns: Nothing (edits global variables)
+Parameters: bool "nextMode", int "increments"
+*/
+void updateProcessing(bool nextMode, int increments){
+  if(!nextMode && increments == 0){
+    return;
+  }
+
+  if(nextMode){
+    procMode = wrapSelection(procMode + 1, PROC_NUM_MODES);
+  }
+  avgLog2 += increments;
+  bound(avgLog2, 1, (procMode == PROC_HIRES) ? HIRES_MAX_LOG2 : AVG_MAX_LOG2);
+
+  avgAcquired = 0;
+}
+
+/*
+Name: updateDecode
+Description: Updates the protocol decoder's settings: a button press steps to the next protocol, encoder 1 picks the UART baud rate and encoder 2
+moves the logic threshold.
+Returns: Nothing (edits global variables)
+Parameters: bool "nextProtocol", int "baudIncrements", int "thresholdIncrements"
+*/
+void updateDecode(bool nextProtocol, int baudIncrements, int thresholdIncrements){
+  if(nextProtocol){
+    decodeProtocol = wrapSelection(decodeProtocol + 1, DECODE_NUM_PROTOCOLS);
+  }
+
+  decodeBaudIndex += baudIncrements;
+  bound(decodeBaudIndex, 0, DECODE_NUM_BAUDS - 1);
+
+  decodeThreshold += thresholdIncrements*DECODE_THRESHOLD_Sensitivity;
+  bound(decodeThreshold, 0, MAX_TRIGGER);
+}
+
+/*
+Name: updateMask
+Description: Updates the mask test's settings: encoder 2 picks a mask menu entry, its button acts on that entry (toggling testing or stop-on-fail,
+asking for a new mask from the current capture, or clearing the counters), and encoder 1 changes the tolerance used for new masks. Starting the
+test or clearing the counters also restarts a stopped acquisition.
+Returns: Nothing (edits global variables)
+Parameters: bool "act", int "toleranceIncrements", int "itemIncrements"
+*/
+void updateMask(bool act, int toleranceIncrements, int itemIncrements){
+  maskMenuItem = wrapSelection(maskMenuItem + itemIncrements, MASK_NUM_ITEMS);
+
+  maskTolerance += toleranceIncrements*MASK_TOLERANCE_Sensitivity;
+  bound(maskTolerance, MASK_TOLERANCE_Sensitivity, MAX_MASK_TOLERANCE);
+
+  if(!act){
+    return;
+  }
+
+  switch(maskMenuItem){
+    case MASK_ITEM_TEST:
+      maskTesting = !maskTesting;
+    break;
+    case MASK_ITEM_STOP:
+      maskStopOnFail = !maskStopOnFail;
+    break;
+    case MASK_ITEM_MAKE:
+      maskMakePending = true;
+    break;
+  }
+
+  if(maskMenuItem == MASK_ITEM_RESET || (maskMenuItem == MASK_ITEM_TEST && maskTesting)){
+    maskPassCount = 0;
+    maskFailCount = 0;
+    maskLastFailed = false;
+    acquisitionRunning = true;
+  }
+}
+
+/*
+Name: updateRefs
+Description: Updates the reference waveform selections: encoder 1 picks the slot, encoder 2 the action, and a button press asks for the action
+to be run on the slot (by runRefAction(), once the current capture is complete).
+Returns: Nothing (edits global variables)
+Parameters: bool "act", int "slotIncrements", int "actionIncrements"
+*/
+void updateRefs(bool act, int slotIncrements, int actionIncrements){
+  refSlot = wrapSelection(refSlot + slotIncrements, REF_NUM_SLOTS);
+  refAction = wrapSelection(refAction + actionIncrements, REF_NUM_ACTIONS);
+
+  if(act){
+    refPendingAction = refAction;
+  }
+}
+
+/*
+Name: updateUI
+Description: The central UI function. Uses a switchcase to determine which global variable is currently selected for editing. To the user, this is what
+allows them to edit the oscilloscope's control values (ex: trigger voltage, or whether or not to display a waveform)
+Returns: Nothing (edits global variables)
+Parameters: None
+*/
+void updateUI(){
+  #if !DUMMY
+  updateRunControl(checkButton3(), checkButton4()); // The DUMMY loop acquires every time through regardless
+  #endif
+
+  // With the menu closed and the zoom controls taken (display menu), the zoom view's encoders pan its window (encoder 1) and change its
+  // timebase (encoder 2)
+  if(showMenu == 0 && displayMode == DISPLAY_ZOOM && zoomEncoders){
+    panZoom(readEncoder1Change());
+    updateHScale(readEncoder2Change());
+    updateButton1();
+    return;
+  }
+
+  // With the menu closed, the encoders move the cursors (if any are shown)
+  if(showMenu == 0 && cursorMode != CURSOR_OFF){
+    moveCursors(readEncoder1Change(), readEncoder2Change());
+    updateButton1();
+    return;
+  }
+
+  switch(menuSelected){
+    
+    case 0: //"General Menu"
+      menuSelecting += readEncoder2Change();
+      menuSelecting = wrapSelection(menuSelecting, MAIN_MENU_OPTIONS + 1); // Bound the selector to the menu box (0) and its options
+      if(checkButton2() == true){
+        menuSelected = menuSelecting;
+      }
+    break;
+
+    case 1: //"Channels Menu"
+      switch(chDataSelected){
+        case 0: //"Channels Menu"
+          chDataSelecting += readEncoder2Change();
+          chDataSelecting = wrapSelection(chDataSelecting, CH_MENU_OPTIONS + 1); // Bound the selector to the menu box (0) and its options
+          if(checkButton2() == true){
+          chDataSelected = chDataSelecting;
+          }
+        break;
+        case 1: // "Show Wave 1"
+          if(checkButton2() == true){
+            if(showWave1 == true){
+              showWave1 = false;
+            }else{
+              showWave1 = true;
+            }
+          }
+        break;
+        case 2: // "Show wave 2"
+          if(checkButton2() == true){
+            if(showWave2 == true){
+              showWave2 = false;
+            }else{
+              showWave2 = true;
+            }
+          }
+        break;
+        case 3: // "Show CH1 measurements"
+          if(checkButton2() == true){
+            if(showMeas1 == true){
+              showMeas1 = false;
+            }else{
+              showMeas1 = true;
+            }
+          }
+        break;
+        case 4: // "Show CH2 measurements"
+          if(checkButton2() == true){
+            if(showMeas2 == true){
+              showMeas2 = false;
+            }else{
+              showMeas2 = true;
+            }
+          }
+        break;
+        case 5: // "CH1 coupling"
+          if(checkButton2() == true){
+            CH1_AC = !CH1_AC;
+          }
+        break;
+        case 6: // "CH2 coupling"
+          if(checkButton2() == true){
+            CH2_AC = !CH2_AC;
+          }
+        break;
+        case 7: // "Measurement statistics" (starting them clears the old ones)
+          if(checkButton2() == true){
+            showStats = !showStats;
+            if(showStats){
+              resetStats();
+            }
+          }
+        break;
+        case 8: // "Reset statistics"
+          if(checkButton2() == true){
+            resetStats();
+          }
+        break;
+        case 9: // "Frequency counter"
+          if(checkButton2() == true){
+            freqCounterOn = !freqCounterOn;
+          }
+        break;
+        default: // "General Menu"
+          menuSelecting += readEncoder2Change();
+          menuSelecting = wrapSelection(menuSelecting, MAIN_MENU_OPTIONS + 1);
+          if(checkButton2() == true){
+            menuSelecting = menuSelected;
+          }
+      }
+    break;
+
+    case 2: // "Trigger selection" (encoder 1 picks an entry and encoder 2 changes it, encoder 2's button runs autoset)
+      updateTriggerSettings(readEncoder1Change(), readEncoder2Change());
+      if(checkButton2() == true && acquisitionRunning){
+        autosetPending = true; // Not while stopped: autoset acquires records of its own over the held one
+      }
+    break;
+    case 3: // "Scaling selection" (encoder 2's button swaps which channel encoder 1 scales)
+      if(checkButton2() == true){
+        scaleChannel = 1 - scaleChannel;
+      }
+      updateVScale(scaleChannel, readEncoder1Change());
+      updateHScale(readEncoder2Change());
+    break;
+    case 4: // "Position selection"
+      updateVPos(0, readEncoder1Change());
+      updateVPos(1, readEncoder2Change());
+    break;
+    case 5: { // "Math selection" (encoder 1 scales, encoder 2 picks the operation)
+      updateMathVScale(readEncoder1Change());
+      int increments = readEncoder2Change();
+      if(increments != 0){
+        setMathOp(wrapSelection(mathOp + increments, MATH_NUM_OPS));
+      }
+    }
+    break;
+    case 6: // "Display selection" (encoder 2's button steps through YT/XY/Zoom, encoder 1 picks the interpolation, encoder 2 hands the
+            // encoders to the zoom window or back)
+      interpMode = wrapSelection(interpMode + readEncoder1Change(), INTERP_NUM_MODES);
+      if(readEncoder2Change() != 0){
+        zoomEncoders = !zoomEncoders;
+      }
+      if(checkButton2() == true){
+        displayMode = wrapSelection(displayMode + 1, DISPLAY_NUM_MODES);
+        zoomOffset = 0; // The zoom window starts at the trigger, where the YT view does
+      }
+    break;
+    case 7: // "Cursor selection" (encoder 2's button changes the mode, encoder 1 picks the channel read)
+      if(checkButton2() == true){
+        cursorMode = wrapSelection(cursorMode + 1, CURSOR_NUM_MODES);
+      }
+      if(readEncoder1Change() != 0){
+        cursorChannel = 1 - cursorChannel;
+      }
+    break;
+    case 8: // "Acquire selection" (encoder 2's button changes the processing mode, encoder 1 the averaging count)
+      updateProcessing(checkButton2(), readEncoder1Change());
+    break;
+    case 9: // "Decode selection" (encoder 2's button changes the protocol, encoder 1 the baud rate, encoder 2 the logic threshold)
+      updateDecode(checkButton2(), readEncoder1Change(), readEncoder2Change());
+    break;
+    case 10: // "Mask selection" (encoder 2 picks an entry and its button acts on it, encoder 1 sets the tolerance)
+      updateMask(checkButton2(), readEncoder1Change(), readEncoder2Change());
+    break;
+    case 11: // "Reference selection" (encoder 1 picks the slot, encoder 2 the action, and encoder 2's button runs it)
+      updateRefs(checkButton2(), readEncoder1Change(), readEncoder2Change());
+    break;
+  }
+
+  updateButton1();
+}
+
+
+/*
+Name: UITerninalTest
+Description: Used for testing & debugging. Replaces the oscilloscope's screen with terminal print outs of the menu. (For use in DUMMY mode)
+Returns: Nothing (prints to terminal)
+Parameters: None
+*/
+void UITerminalTest(){
+  Serial.println("------------------- UI Test ----------------------");
+
+  updateButton1();
+  
+  #if DUMMY
+  if(showMenu == true){
+  Serial.println("_____MENU_____");
+  Serial.print("Select-ed: ");
+  switch(menuSelected){
+    case 0:
+    Serial.println("Menu");
+    break;
+
+    case 1:
+    Serial.println("Channels");
+    Serial.print("dataSelect-ed: ");
+    switch(chDataSelected){
+      case 0:
+      Serial.println("Channel Menu");
+      break;
+      
+      case 1:
+      Serial.println("showWave1");
+      break;
+
+      case 2:
+      Serial.println("showWave2");
+      break;
+
+      case 3:
+      Serial.println("showMeas1");
+      break;
+
+      case 4:
+      Serial.println("showMeas2");
+      break;
+
+      case 5:
+      Serial.println("CH1 Coupling");
+      break;
+
+      case 6:
+      Serial.println("CH2 Coupling");
+      break;
+
+      case 7:
+      Serial.println("Meas Stats");
+      break;
+
+      case 8:
+      Serial.println("Reset Stats");
+      break;
+
+      case 9:
+      Serial.println("Freq Counter");
+      break;
+    }
+    Serial.print("dataSelect-ing: ");
+    switch(chDataSelecting){
+      case 0:
+      Serial.println("Channel Menu");
+      break;
+      
+      case 1:
+      Serial.println("showWave1");
+      break;
+
+      case 2:
+      Serial.println("showWave2");
+      break;
+
+      case 3:
+      Serial.println("showMeas1");
+      break;
+
+      case 4:
+      Serial.println("showMeas2");
+      break;
+
+      case 5:
+      Serial.println("CH1 Coupling");
+      break;
+
+      case 6:
+      Serial.println("CH2 Coupling");
+      break;
+
+      case 7:
+      Serial.println("Meas Stats");
+      break;
+
+      case 8:
+      Serial.println("Reset Stats");
+      break;
+
+      case 9:
+      Serial.println("Freq Counter");
+      break;
+    }
+
+    break;
+
+    case 2:
+    Serial.println("Trigger Voltage");
+    break;
+    
+    case 3:
+    Serial.println("Scaling");
+    break;
+
+    case 4:
+    Serial.println("Position");
+    break;
+
+    case 5:
+    Serial.println("Math");
+    break;
+
+    case 6:
+    Serial.println("Display");
+    break;
+
+    case 7:
+    Serial.println("Cursors");
+    break;
+
+    case 8:
+    Serial.println("Acquire");
+    break;
+
+    case 9:
+    Serial.println("Decode");
+    break;
+
+    case 10:
+    Serial.println("Mask");
+    break;
+
+    case 11:
+    Serial.println("Refs");
+    break;
+  }
+
+  Serial.print("Select-ing: ");
+  switch(menuSelecting){
+    case 0:
+    Serial.println("Menu");
+    break;
+
+    case 1:
+    Serial.println("Channels");
+    break;
+
+    case 2:
+    Serial.println("Trigger Voltage");
+    break;
+    
+    case 3:
+    Serial.println("Scaling");
+    break;
+
+    case 4:
+    Serial.println("Position");
+    break;
+
+    case 5:
+    Serial.println("Math");
+    break;
+
+    case 6:
+    Serial.println("Display");
+    break;
+
+    case 7:
+    Serial.println("Cursors");
+    break;
+
+    case 8:
+    Serial.println("Acquire");
+    break;
+
+    case 9:
+    Serial.println("Decode");
+    break;
+
+    case 10:
+    Serial.println("Mask");
+    break;
+
+    case 11:
+    Serial.println("Refs");
+    break;
+  }
+
+  Serial.println("CURRENT VALUES:");
+  Serial.print("Trigger Voltage: ");
+  Serial.println(triggerVoltage);
+  Serial.print("Trigger Hysteresis: ");
+  Serial.println(triggerHysteresis);
+  Serial.print("Trigger Source: ");
+  Serial.println(triggerSourceNames[triggerSource]);
+  Serial.print("Trigger Type: ");
+  Serial.println(triggerTypeNames[triggerType]);
+  Serial.print("Trigger Upper: ");
+  Serial.println(triggerUpper);
+  Serial.print("Trigger Time 1/2 (us): ");
+  Serial.print(triggerTime1*1E6);
+  Serial.print("/");
+  Serial.println(triggerTime2*1E6);
+  Serial.print("H_Scale: ");
+  Serial.println(HScale);
+  Serial.print("CH1 V_Scale: ");
+  Serial.println(CH1_VScale);
+  Serial.print("CH2 V_Scale: ");
+  Serial.println(CH2_VScale);
+  Serial.print("CH1 V_Pos: ");
+  Serial.println(CH1_VPos);
+  Serial.print("CH2 V_Pos: ");
+  Serial.println(CH2_VPos);
+  Serial.print("Math: ");
+  Serial.println(mathOpName());
+  Serial.print("Math V_Scale: ");
+  Serial.println(mathVScale);
+  Serial.print("Display Mode: ");
+  Serial.println(displayModeNames[displayMode]);
+  Serial.print("Zoom Offset: ");
+  Serial.println(zoomOffset);
+  Serial.print("Zoom Encoders: ");
+  Serial.println(zoomEncoders ? "Zoom" : "Menu");
+  Serial.print("Run State: ");
+  Serial.println(singleArmed ? "Single" : (acquisitionRunning ? "Run" : "Stop"));
+  Serial.print("Interpolation: ");
+  Serial.println(interpModeNames[interpMode]);
+  Serial.print("Cursor Mode: ");
+  Serial.println(cursorMode);
+  Serial.print("Cursor Channel: ");
+  Serial.println(cursorChannel + 1);
+  Serial.print("Processing Mode: ");
+  Serial.println(procMode);
+  Serial.print("Averaging Count: ");
+  Serial.println(1 << avgLog2);
+  Serial.print("Decode: ");
+  Serial.println(decodeProtocolNames[decodeProtocol]);
+  Serial.print("Decode Baud: ");
+  Serial.println(decodeBaudRates[decodeBaudIndex]);
+  Serial.print("Decode Threshold: ");
+  Serial.println(decodeThreshold);
+  Serial.print("Mask Testing: ");
+  Serial.println(maskTesting);
+  Serial.print("Mask Tolerance: ");
+  Serial.println(maskTolerance);
+  Serial.print("Mask Pass/Fail: ");
+  Serial.print(maskPassCount);
+  Serial.print("/");
+  Serial.println(maskFailCount);
+  Serial.print("Ref Slot: ");
+  Serial.println(refSlot + 1);
+  Serial.print("Ref Action: ");
+  Serial.println(refAction);
+  Serial.print("CH1 AC: ");
+  Serial.println(CH1_AC);
+  Serial.print("CH2 AC: ");
+  Serial.println(CH2_AC);
+  Serial.print("showWave1: ");
+  Serial.println(showWave1);
+  Serial.print("showWave2: ");
+  Serial.println(showWave2);
+  Serial.print("showMeas1: ");
+  Serial.println(showMeas1);
+  Serial.print("showMeas2: ");
+  Serial.println(showMeas2);
+  Serial.print("showStats: ");
+  Serial.println(showStats);
+  Serial.print("freqCounterOn: ");
+  Serial.println(freqCounterOn);
+  updateUI();
+}else{
+
+}
+#endif
+}
+
+
+
+
+//--------------------------
+/* END  UI Functions */
+// -------------------------
+#endif
+
+
+
+// ------------------------------
+/* BEGIN Calibration Functions */
+// ------------------------------
+
+/*
+Name: calCRC32
+Description: Standard (reflected, 0xEDB88320) CRC-32 of a block of bytes. Used to tell a valid calibration block in EEPROM from garbage (and
+to hash rendered frames, see testFrameRegression).
+Returns: uint32_t "crc"
+Parameters: const uint8_t* "data", int "length" (number of bytes)
+*/
+uint32_t calCRC32(const uint8_t* data, int length){
+  uint32_t crc = 0xFFFFFFFF;
+  for(int i = 0; i < length; i++){
+    crc ^= data[i];
+    for(int bit = 0; bit < 8; bit++){
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+/*
+Name: calDataCRC
+Description: CRC of the calibration block, covering everything except the crc field itself
+Returns: uint32_t "crc"
+Parameters: const CalibrationData& "data"
+*/
+uint32_t calDataCRC(const CalibrationData& data){
+  return calCRC32((const uint8_t*)&data, offsetof(CalibrationData, crc));
+}
+
+/*
+Name: resetCalibrationPath
+Description: Sets one calibration path back to the ideal (uncalibrated) mapping, i.e. the inverting front end spreading upperVoltage..lowerVoltage
+over the ADC's 0..ADC_MAX_COUNT range.
+Returns: Nothing (edits the provided path)
+Parameters: CalibrationPath& "path"
+*/
+void resetCalibrationPath(CalibrationPath& path){
+  path.gain = -(upperVoltage - lowerVoltage)/(ADC_MAX_COUNT*1.0);
+  path.offset = upperVoltage;
+  for(int k = 0; k < CAL_NUM_POINTS; k++){
+    path.refCount[k] = (ADC_MAX_COUNT*1.0*k)/(CAL_NUM_POINTS - 1);
+    path.residual[k] = 0;
+  }
+  path.valid = 0;
+}
+
+/*
+Name: resetCalibration
+Description: Resets every calibration path to the ideal mapping (does not touch the EEPROM)
+Returns: Nothing (edits global variable)
+Parameters: None
+*/
+void resetCalibration(){
+  memset(&calData, 0, sizeof(calData));
+  calData.magic = CAL_MAGIC;
+  calData.version = CAL_VERSION;
+  for(int ch = 0; ch < NUM_CHANNELS; ch++){
+    for(int adcNum = 0; adcNum < 2; adcNum++){
+      resetCalibrationPath(calData.path[ch][adcNum]);
+    }
+  }
+  calData.crc = calDataCRC(calData);
+}
+
+/*
+Name: loadCalibration
+Description: Reads the calibration block from EEPROM. If it is missing, from an older layout, or fails its CRC, the ideal mapping is used instead.
+Returns: bool (true if a valid calibration was loaded)
+Parameters: None
+*/
+bool loadCalibration(){
+  EEPROM.get(CAL_EEPROM_ADDR, calData);
+
+  if(calData.magic != CAL_MAGIC || calData.version != CAL_VERSION || calData.crc != calDataCRC(calData)){
+    Serial.println("No valid calibration in EEPROM - using ideal values");
+    resetCalibration();
+    return false;
+  }
+  return true;
+}
+
+/*
+Name: saveCalibration
+Description: Stamps the calibration block with its CRC and writes it to EEPROM
+Returns: Nothing
+Parameters: None
+*/
+void saveCalibration(){
+  calData.magic = CAL_MAGIC;
+  calData.version = CAL_VERSION;
+  calData.crc = calDataCRC(calData);
+  EEPROM.put(CAL_EEPROM_ADDR, calData);
+}
+
+/*
+Name: calPathVolts
+Description: Evaluates a calibration path at a (possibly fractional) count: the linear fit plus, if CAL_LINEARITY is set, the residual
+interpolated between the measured reference points (held constant past the outermost points).
+Returns: double "volts"
+Parameters: const CalibrationPath& "path", double "count"
+*/
+double calPathVolts(const CalibrationPath& path, double count){
+  double volts = path.gain*count + path.offset;
+
+  #if CAL_LINEARITY
+  if(count <= path.refCount[0]){
+    volts += path.residual[0];
+  }else if(count >= path.refCount[CAL_NUM_POINTS - 1]){
+    volts += path.residual[CAL_NUM_POINTS - 1];
+  }else{
+    for(int k = 0; k < CAL_NUM_POINTS - 1; k++){
+      if(count <= path.refCount[k + 1]){
+        double span = path.refCount[k + 1] - path.refCount[k];
+        double frac = (span > 0) ? (count - path.refCount[k])/span : 0;
+        volts += path.residual[k] + frac*(path.residual[k + 1] - path.residual[k]);
+        break;
+      }
+    }
+  }
+  #endif
+
+  return volts;
+}
+
+/*
+Name: buildVoltageLUTs
+Description: Precomputes the count -> volts tables used by updateVoltageData(), so that calibration costs one table read per sample. Each channel
+uses the path of the ADC that produces its samples: its own ADC in dual mode, ADC0 in interleaved mode (ADC1's samples are mapped into ADC0's
+counts by correctInterleaveMismatch). Also loads the interleave gain/offset from the tables when the interleaved channel is calibrated on both ADCs.
+Returns: Nothing (updates global arrays)
+Parameters: None
+*/
+void buildVoltageLUTs(){
+  int ch1ADC = CAL_ADC0; // Channel 1 is on ADC0 in both dual and interleaved mode
+  int ch2ADC = (acqMode == ACQ_DUAL) ? CAL_ADC1 : CAL_ADC0;
+
+  // The calibration is in ADC counts, the tables in processed counts
+  for(int count = 0; count <= PROC_MAX_CODE; count++){
+    double adcCount = count/(double)(1 << PROC_EXTRA_BITS);
+    countToVolts1[count] = calPathVolts(calData.path[0][ch1ADC], adcCount);
+    countToVolts2[count] = calPathVolts(calData.path[1][ch2ADC], adcCount);
+  }
+  voltageLUTVersion++;
+
+  interleaveCalibrated = false;
+  if(acqMode != ACQ_DUAL){
+    int ch = (acqMode == ACQ_INTERLEAVE_CH1) ? 0 : 1;
+    const CalibrationPath& path0 = calData.path[ch][CAL_ADC0];
+    const CalibrationPath& path1 = calData.path[ch][CAL_ADC1];
+
+    if(path0.valid && path1.valid && path0.gain != 0){
+      // gain0*c0 + offset0 = gain1*c1 + offset1  =>  c0 = (gain1/gain0)*c1 + (offset1 - offset0)/gain0
+      interleaveGain = path1.gain/path0.gain;
+      interleaveOffset = (path1.offset - path0.offset)/path0.gain;
+      interleaveCalibrated = true;
+    }
+  }
+}
+
+/*
+Name: measureReferenceCount
+Description: Averages CAL_AVERAGES single reads of a pin on one ADC. The ADCs are re-armed for dual-mode sampling afterwards.
+Returns: double "count" (average raw value)
+Parameters: int "pin", int "adcNum" (CAL_ADC0 or CAL_ADC1)
+*/
+double measureReferenceCount(int pin, int adcNum){
+  ADC_Module* module = (adcNum == CAL_ADC0) ? adc->adc0 : adc->adc1;
+  uint32_t sum = 0;
+
+  while(adc->adc0->isConverting() || adc->adc1->isConverting());
+
+  for(int n = 0; n < CAL_AVERAGES; n++){
+    sum += module->analogRead(pin);
+  }
+
+  adc->startSynchronizedSingleRead(CH1_PIN, CH2_PIN);
+
+  return (sum*1.0)/CAL_AVERAGES;
+}
+
+/*
+Name: waitForCalibrationStep
+Description: Shows a calibration instruction on screen and over serial, then waits for the user to confirm with encoder 2's button (or by sending
+any line over serial). Encoder 1's button aborts.
+Returns: bool (true to continue, false if aborted)
+Parameters: const char* "line1", const char* "line2"
+*/
+bool waitForCalibrationStep(const char* line1, const char* line2){
+  Serial.println(line1);
+  Serial.println(line2);
+
+  oScopeImage.clear(tgx::RGB32_Black);
+  oScopeImage.drawText("CALIBRATION", {10, 30}, CHANGE_VALUE_FONT, WHITE);
+  oScopeImage.drawText(line1, {10, 80}, CHANGE_VALUE_FONT, WHITE);
+  oScopeImage.drawText(line2, {10, 110}, CHANGE_VALUE_FONT, WHITE);
+  oScopeImage.drawText("Enc 2 button: continue   Enc 1 button: abort", {10, 220}, MENU_FONT, WHITE);
+  tft.update(fb);
+
+  while(true){
+    button1.update();
+    button2.update();
+    if(button1.fell()){
+      return false;
+    }
+    if(button2.fell()){
+      return true;
+    }
+    if(Serial.available() > 0){
+      Serial.readStringUntil('\n');
+      return true;
+    }
+  }
+}
+
+/*
+Name: fitCalibrationPath
+Description: Least-squares fit of volts = gain*count + offset through the measured reference points, then stores each point's residual
+(the linearity table) sorted by count.
+Returns: Nothing (edits the provided path)
+Parameters: CalibrationPath& "path", const double "counts[]" (measured count for each of calRefVoltages)
+*/
+void fitCalibrationPath(CalibrationPath& path, const double counts[]){
+  double sumX = 0;
+  double sumY = 0;
+  double sumXY = 0;
+  double sumXX = 0;
+  int order[CAL_NUM_POINTS];
+
+  for(int k = 0; k < CAL_NUM_POINTS; k++){
+    sumX += counts[k];
+    sumY += calRefVoltages[k];
+    sumXY += counts[k]*calRefVoltages[k];
+    sumXX += counts[k]*counts[k];
+    order[k] = k;
+  }
+
+  double denom = CAL_NUM_POINTS*sumXX - sumX*sumX;
+  if(denom == 0){
+    Serial.println("Calibration failed: reference levels all read the same");
+    return;
+  }
+
+  path.gain = (CAL_NUM_POINTS*sumXY - sumX*sumY)/denom;
+  path.offset = (sumY - path.gain*sumX)/CAL_NUM_POINTS;
+
+  // The front end inverts, so sort the points by count (insertion sort, CAL_NUM_POINTS is tiny)
+  for(int a = 1; a < CAL_NUM_POINTS; a++){
+    for(int b = a; b > 0 && counts[order[b]] < counts[order[b - 1]]; b--){
+      int tmp = order[b];
+      order[b] = order[b - 1];
+      order[b - 1] = tmp;
+    }
+  }
+
+  for(int k = 0; k < CAL_NUM_POINTS; k++){
+    int src = order[k];
+    path.refCount[k] = counts[src];
+    path.residual[k] = calRefVoltages[src] - (path.gain*counts[src] + path.offset);
+  }
+  path.valid = 1;
+}
+
+/*
+Name: runCalibration
+Description: Interactive calibration of one channel. For each of calRefVoltages the user applies that voltage to the probe and confirms; the level is
+measured on every ADC that can convert the channel. A gain/offset (and linearity residuals) is fitted per ADC path, saved to EEPROM, and the
+lookup tables are rebuilt.
+Returns: bool (true if the calibration completed and was saved)
+Parameters: int "ch" (0 = channel 1, 1 = channel 2)
+*/
+bool runCalibration(int ch){
+  int pin = (ch == 0) ? CH1_PIN : CH2_PIN;
+  bool pathUsable[2];
+  double counts[2][CAL_NUM_POINTS];
+  char line1[40];
+
+  pathUsable[CAL_ADC0] = (ch == 0) || interleaveCH2Available;
+  pathUsable[CAL_ADC1] = (ch == 1) || interleaveCH1Available;
+
+  for(int k = 0; k < CAL_NUM_POINTS; k++){
+    snprintf(line1, sizeof(line1), "Apply %.3f V to CH%d", calRefVoltages[k], ch + 1);
+    if(!waitForCalibrationStep(line1, "then press encoder 2")){
+      Serial.println("Calibration aborted");
+      return false;
+    }
+
+    for(int adcNum = 0; adcNum < 2; adcNum++){
+      if(pathUsable[adcNum]){
+        counts[adcNum][k] = measureReferenceCount(pin, adcNum);
+        Serial.print("ADC");
+        Serial.print(adcNum);
+        Serial.print(" count: ");
+        Serial.println(counts[adcNum][k]);
+      }
+    }
+  }
+
+  for(int adcNum = 0; adcNum < 2; adcNum++){
+    if(pathUsable[adcNum]){
+      fitCalibrationPath(calData.path[ch][adcNum], counts[adcNum]);
+    }
+  }
+
+  saveCalibration();
+  buildVoltageLUTs();
+  Serial.println("Calibration saved");
+  return true;
+}
+
+/*
+Name: printCalibration
+Description: Used for testing & debugging. Prints the gain/offset and residuals of every calibration path.
+Returns: Nothing
+Parameters: None
+*/
+void printCalibration(){
+  for(int ch = 0; ch < NUM_CHANNELS; ch++){
+    for(int adcNum = 0; adcNum < 2; adcNum++){
+      const CalibrationPath& path = calData.path[ch][adcNum];
+      Serial.print("CH");
+      Serial.print(ch + 1);
+      Serial.print(" ADC");
+      Serial.print(adcNum);
+      Serial.print(path.valid ? " (calibrated)" : " (ideal)");
+      Serial.print(" gain: ");
+      Serial.print(path.gain, 6);
+      Serial.print(" offset: ");
+      Serial.print(path.offset, 4);
+      Serial.print(" residuals: [");
+      for(int k = 0; k < CAL_NUM_POINTS; k++){
+        Serial.print(path.residual[k], 4);
+        if(k == CAL_NUM_POINTS - 1){
+          Serial.println("]");
+        }else{
+          Serial.print(", ");
+        }
+      }
+    }
+  }
+}
+
+// ------------------------------
+/* END Calibration Functions */
+// ------------------------------
+
+
+
+// -----------------------------------
+/* BEGIN Interpolation Functions */
+// -----------------------------------
+
+/*
+Name: buildSincTable
+Description: Builds the polyphase sin(x)/x table. Phase p places a point p/INTERP_PHASES of a sample past a record sample, from the
+INTERP_TAPS samples around it, weighted by a Lanczos (sinc-windowed) sinc. Each phase is scaled to sum to exactly 1 so a flat signal stays flat.
+Returns: Nothing (fills sincTable)
+Parameters: None
+*/
+void buildSincTable(){
+  const double lobes = INTERP_TAPS/2;
+
+  for(int phase = 0; phase < INTERP_PHASES; phase++){
+    double fraction = phase/(double)INTERP_PHASES;
+    double weights[INTERP_TAPS];
+    double total = 0;
+
+    for(int k = 0; k < INTERP_TAPS; k++){
+      double x = (k - (INTERP_TAPS/2 - 1)) - fraction; // Tap k is sample (base - 3 + k), the point is at base + fraction
+      weights[k] = 1;
+      if(x != 0){
+        weights[k] = (sin(M_PI*x)/(M_PI*x))*(sin(M_PI*x/lobes)/(M_PI*x/lobes));
+      }
+      total += weights[k];
+    }
+
+    int sum = 0;
+    for(int k = 0; k < INTERP_TAPS; k++){
+      sincTable[phase][k] = (int16_t)lround(weights[k]/total*(1 << INTERP_FRAC_BITS));
+      sum += sincTable[phase][k];
+    }
+    sincTable[phase][INTERP_TAPS/2 - 1 + (fraction >= 0.5)] += (1 << INTERP_FRAC_BITS) - sum; // Rounding left over goes on the nearest tap
+  }
+}
+
+/*
+Name: shortestHScale
+Description: The shortest timebase that can be shown: one sample per column (HScaleMin), or INTERP_MAX_ZOOM columns per sample when
+interpolating
+Returns: double "HScale"
+Parameters: None
+*/
+double shortestHScale(){
+  return (interpMode == INTERP_OFF) ? HScaleMin : HScaleMin/INTERP_MAX_ZOOM;
+}
+
+/*
+Name: reconstructTrace
+Description: Makes one point per screen column from a channel's record at a stride below one sample, column i being at record position
+start + i*stride (wrapping around the record): the nearest sample (INTERP_OFF), a straight line between the two samples around it, or the
+sin(x)/x table's phase nearest to its fraction of a sample applied to the INTERP_TAPS samples around it. The samples the frame spans (under
+LX, plus the taps' reach) are unpacked once up front.
+Returns: Nothing (fills out)
+Parameters: int "ch" (0 or 1), double "start", double "stride" (< 1), int "mode" (INTERP_ value), uint16_t "out[]" (LX points, processed
+counts)
+*/
+void reconstructTrace(int ch, double start, double stride, int mode, uint16_t out[]){
+  sample_t span[LX + INTERP_TAPS + 2];
+  int first = (int)start - (INTERP_TAPS/2 - 1);
+  int last = (int)(start + (LX - 1)*stride) + INTERP_TAPS/2 + 1;
+  loadRecordSpan(ch, first, last - first + 1, span);
+
+  for(int i = 0; i < LX; i++){
+    double position = start + i*stride;
+    int base = (int)position;
+    double fraction = position - base;
+    int value;
+
+    if(mode == INTERP_LINEAR){
+      int a = span[base - first];
+      int b = span[base + 1 - first];
+      value = a + (int)lround(fraction*(b - a));
+    }else if(mode == INTERP_SINC){
+      int phase = (int)(fraction*INTERP_PHASES + 0.5);
+      if(phase == INTERP_PHASES){
+        base++;
+        phase = 0;
+      }
+      const int16_t* taps = sincTable[phase];
+      const sample_t* around = &span[base - (INTERP_TAPS/2 - 1) - first];
+      int32_t sum = 1 << (INTERP_FRAC_BITS - 1);
+
+      for(int k = 0; k < INTERP_TAPS; k++){
+        sum += taps[k]*around[k];
+      }
+      value = sum >> INTERP_FRAC_BITS;
+      bound(value, 0, PROC_MAX_CODE); // Sinc rings past the samples at sharp edges
+    }else{
+      value = span[base + (fraction >= 0.5) - first];
+    }
+
+    out[i] = value;
+  }
+}
+
+/*
+Name: benchmarkInterpolation
+Description: Used for testing & debugging. Reconstructs a synthesized sine (10 samples per period) on both channels at strides from 1/2 to
+1/INTERP_MAX_ZOOM with each interpolation mode, and reports the cycles per frame (both channels) and the RMS error against the sine itself.
+Overwrites the record.
+Returns: Nothing (prints to terminal)
+Parameters: None
+*/
+void benchmarkInterpolation(){
+  const double period = 10;
+  const double amplitude = PROC_MAX_CODE*0.4;
+  const double center = PROC_MAX_CODE/2.0;
+  uint16_t points[LX];
+
+  for(int i = 0; i < NUM_SAMPLES; i++){
+    for(int ch = 0; ch < NUM_CHANNELS; ch++){
+      setRecordSample(ch, i, (int)lround(center + amplitude*sin(2*M_PI*i/period)));
+    }
+  }
+
+  Serial.println("Mode, stride, cycles/frame, error (counts RMS)");
+  for(int mode = 0; mode < INTERP_NUM_MODES; mode++){
+    for(int zoom = 2; zoom <= INTERP_MAX_ZOOM; zoom *= 2){
+      double stride = 1.0/zoom;
+      double start = 100.37; // Off the sample grid, as a sub-sample trigger would be
+
+      uint32_t cycles = ARM_DWT_CYCCNT;
+      for(int ch = 0; ch < NUM_CHANNELS; ch++){
+        reconstructTrace(ch, start, stride, mode, points);
+      }
+      cycles = ARM_DWT_CYCCNT - cycles;
+
+      double sumSq = 0;
+      for(int i = 0; i < LX; i++){
+        double error = points[i] - (center + amplitude*sin(2*M_PI*(start + i*stride)/period));
+        sumSq += error*error;
+      }
+
+      Serial.print(interpModeNames[mode]);
+      Serial.print(", 1/");
+      Serial.print(zoom);
+      Serial.print(", ");
+      Serial.print(cycles);
+      Serial.print(", ");
+      Serial.println(sqrt(sumSq/LX), 2);
+    }
+  }
+}
+
+// -----------------------------------
+/* END Interpolation Functions */
+// -----------------------------------
+
+
+
+// ----------------------
+/* BEGIN ADC FUNCTIONS */
+// ----------------------
+
+/*
+Name: setAcquisitionMode
+Description: Switches to an acquisition mode (ACQ_ value), updating the sample spacing (sampleDt), the usable HScale range and the voltage tables
+to match, and restarting anything that depends on the old record timing.
+Returns: Nothing (updates global variables)
+Parameters: int "mode"
+*/
+void setAcquisitionMode(int mode){
+  acqMode = mode;
+  avgAcquired = 0; // The record's timing changed, so restart any averaging
+
+  // A different pin (or no interleaving at all) means the old mismatch estimate no longer applies
+  interleaveGain = 1.0;
+  interleaveOffset = 0.0;
+  interleaveCalibrated = false;
+
+  if(acqMode == ACQ_DUAL){
+    sampleDt = ADC_SAMPLE_DT;
+  }else{
+    sampleDt = ADC_SAMPLE_DT/2.0;
+  }
+
+  HScaleMax = RecordLimits<NUM_SAMPLES>::hscaleMax(sampleDt);
+  HScaleMin = RecordLimits<NUM_SAMPLES>::hscaleMin(sampleDt);
+
+  // The interleaved channel is converted in ADC0's count domain, so its lookup table (and the mismatch correction) change with the mode
+  buildVoltageLUTs();
+}
+
+/*
+Name: updateAcquisitionMode
+Description: Chooses how the two ADCs are used based on which channels are enabled. If only one channel is in use (neither its waveform nor its
+measurements are shown for the other, the math channel is off, and the display is not in XY mode), both ADCs are pointed at that channel's pin and interleaved to double the sample rate. The sample spacing
+(sampleDt) and the usable HScale range are updated to match the new mode.
+Returns: Nothing (updates global variables)
+Parameters: None
+*/
+void updateAcquisitionMode(){
+  // The math channel and the XY display need both channels sampled at the same instants
+  bool bothInUse = (mathOp != MATH_OFF) || (displayMode == DISPLAY_XY);
+  bool ch1InUse = showWave1 || showMeas1 || bothInUse || triggerSource == TRIG_SRC_CH1; // The trigger source has to be sampled too
+  bool ch2InUse = showWave2 || showMeas2 || bothInUse || triggerSource == TRIG_SRC_CH2;
+  int newMode = ACQ_DUAL;
+
+  if(ch1InUse && !ch2InUse && interleaveCH1Available){
+    newMode = ACQ_INTERLEAVE_CH1;
+  }else if(ch2InUse && !ch1InUse && interleaveCH2Available){
+    newMode = ACQ_INTERLEAVE_CH2;
+  }
+
+  if(newMode != acqMode){
+    setAcquisitionMode(newMode);
+  }
+}
+
+/*
+Name: extTrigTicks
+Description: Combines a coarse (channel 0, IP bus / 128) and a fine (channel 1, IP bus / 8) count of the external trigger timer into one count
+of fine ticks: the fine count's 16 bits, with the 4 above them taken from the wrap of the fine count that lies nearest the coarse count. Both
+channels run from the same clock, so the two only disagree by their prescalers' phase (a fraction of a coarse tick).
+Returns: uint32_t "ticks" (fine ticks, wrapping at EXT_TRIG_CLOCK_MASK)
+Parameters: uint16_t "coarse", uint16_t "fine"
+*/
+uint32_t extTrigTicks(uint16_t coarse, uint16_t fine){
+  uint32_t approx = (uint32_t)coarse*16;
+  return (fine + ((approx - fine + 0x8000) & 0xF0000)) & EXT_TRIG_CLOCK_MASK;
+}
+
+/*
+Name: readExtTrigClock
+Description: Reads the external trigger timer now (reading channel 0 latches channel 1 into its hold register, so the two go together)
+Returns: uint32_t "ticks" (see extTrigTicks)
+Parameters: None
+*/
+uint32_t readExtTrigClock(){
+  uint16_t coarse = TMR4_CNTR0;
+  uint16_t fine = TMR4_HOLD1;
+  return extTrigTicks(coarse, fine);
+}
+
+/*
+Name: armExternalTrigger
+Description: Clears both channels' input edge flags, so they capture the next rising edge on EXT_TRIG_PIN (a channel captures once per clear)
+Returns: Nothing
+Parameters: None
+*/
+void armExternalTrigger(){
+  TMR4_SCTRL0 &= ~TMR_SCTRL_IEF;
+  TMR4_SCTRL1 &= ~TMR_SCTRL_IEF;
+}
+
+/*
+Name: updateExternalTrigger
+Description: Starts/stops the external trigger timer to follow the trigger source: QuadTimer 4's channels 0 and 1 count the IP bus clock (/128
+and /8) and both capture rising edges on counter input 1, which EXT_TRIG_PIN is muxed to. The two are enabled together.
+Returns: Nothing (updates global variables)
+Parameters: None
+*/
+void updateExternalTrigger(){
+  bool wanted = (triggerSource == TRIG_SRC_EXT);
+  if(wanted == extTrigAttached){
+    return;
+  }
+
+  if(wanted){
+    CCM_CCGR6 |= CCM_CCGR6_QTIMER4(CCM_CCGR_ON);
+
+    TMR4_ENBL &= ~((1 << 0) | (1 << 1));
+    TMR4_CTRL0 = 0;
+    TMR4_CTRL1 = 0;
+    TMR4_CSCTRL0 = 0;
+    TMR4_CSCTRL1 = 0;
+    TMR4_LOAD0 = 0;
+    TMR4_LOAD1 = 0;
+    TMR4_CNTR0 = 0;
+    TMR4_CNTR1 = 0;
+    TMR4_SCTRL0 = TMR_SCTRL_CAPTURE_MODE(1); // Capture on the secondary input's rising edge
+    TMR4_SCTRL1 = TMR_SCTRL_CAPTURE_MODE(1);
+    TMR4_CTRL0 = TMR_CTRL_CM(1) | TMR_CTRL_PCS(8 + 7) | TMR_CTRL_SCS(1);
+    TMR4_CTRL1 = TMR_CTRL_CM(1) | TMR_CTRL_PCS(8 + 3) | TMR_CTRL_SCS(1);
+    TMR4_ENBL |= (1 << 0) | (1 << 1);
+
+    IOMUXC_SW_MUX_CTL_PAD_GPIO_B0_10 = 1; // ALT1: QTIMER4_TIMER1
+  }else{
+    TMR4_CTRL0 = 0;
+    TMR4_CTRL1 = 0;
+  }
+  extTrigAttached = wanted;
+}
+
+/*
+Name: externalTriggerPosition
+Description: Places the external trigger's capture in the last record: the record's start and end stamps give the timer value of every
+sample, so the edge's offset from the start in ticks scales to an offset in samples (to a fraction of a sample). An edge captured after the
+record ended doesn't count.
+Returns: double "position" (record samples, -1 if no edge arrived during the record)
+Parameters: None
+*/
+double externalTriggerPosition(){
+  if(!(TMR4_SCTRL0 & TMR_SCTRL_IEF) || !(TMR4_SCTRL1 & TMR_SCTRL_IEF)){
+    return -1;
+  }
+
+  uint32_t stamp = extTrigTicks(TMR4_CAPT0, TMR4_CAPT1);
+  uint32_t span = (recordEndStamp - recordStartStamp) & EXT_TRIG_CLOCK_MASK; // Masked differences survive the clock wrapping
+  uint32_t offset = (stamp - recordStartStamp) & EXT_TRIG_CLOCK_MASK;
+  if(span == 0 || offset >= span){
+    return -1;
+  }
+  return ((double)offset*NUM_SAMPLES)/span;
+}
+
+/*
+Name: sampleInterleaved
+Description: Sample a single pin with both ADCs, ADC1 started INTERLEAVE_PHASE_NS after ADC0, so that even indexes of the record come from ADC0
+and odd indexes from ADC1. Each ADC is restarted as soon as its own conversion finishes, which keeps the two converters half a conversion apart
+for the whole record. The ADCs are left with a synchronized read pending, as sampleChannels() expects in dual mode.
+Returns: Nothing (updates sampleStore)
+Parameters: int "pin" (pin to sample), int "ch" (the record channel to fill)
+*/
+void sampleInterleaved(int pin, int ch){
+  // Let any conversion left over from the previous record finish before re-pointing the ADCs
+  while(adc->adc0->isConverting() || adc->adc1->isConverting());
+
+  armExternalTrigger(); // For this record
+  recordStartStamp = readExtTrigClock();
+  adc->adc0->startSingleRead(pin);
+  delayNanoseconds(INTERLEAVE_PHASE_NS);
+  adc->adc1->startSingleRead(pin);
+
+  // Each ADC is restarted before its sample is packed, so the packing overlaps the next conversion
+  for(int i = 0; i < NUM_SAMPLES; i += 2){
+    while(adc->adc0->isConverting());
+    int even = adc->adc0->readSingle();
+    adc->adc0->startSingleRead(pin);
+    setRecordSample(ch, i, even);
+
+    while(adc->adc1->isConverting());
+    int odd = adc->adc1->readSingle();
+    adc->adc1->startSingleRead(pin);
+    setRecordSample(ch, i + 1, odd);
+  }
+  recordEndStamp = readExtTrigClock();
+
+  while(adc->adc0->isConverting() || adc->adc1->isConverting());
+  adc->startSynchronizedSingleRead(CH1_PIN, CH2_PIN);
+}
+
+/*
+Name: estimateInterleaveMismatch
+Description: Estimates the gain/offset that maps the ADC1 (odd) samples of an interleaved record onto the ADC0 (even) samples from the
+record's statistics, and averages it into interleaveGain/interleaveOffset. Only used when the interleaved channel isn't calibrated on both ADCs.
+Returns: Nothing (updates global variables)
+Parameters: int "ch" (the interleaved record channel)
+*/
+void estimateInterleaveMismatch(int ch){
+  sample_t window[RECORD_WINDOW];
+  int64_t sum0 = 0;
+  int64_t sum1 = 0;
+  uint64_t sumSq0 = 0;
+  uint64_t sumSq1 = 0;
+  const int halfCount = NUM_SAMPLES/2;
+
+  for(int base = 0; base < NUM_SAMPLES; base += RECORD_WINDOW){
+    int n = min(RECORD_WINDOW, NUM_SAMPLES - base);
+    loadRecordWindow(ch, base, n, window);
+    for(int i = 0; i < n; i += 2){
+      int a = window[i];
+      int b = window[i + 1];
+      sum0 += a;
+      sum1 += b;
+      sumSq0 += (uint64_t)(a*a);
+      sumSq1 += (uint64_t)(b*b);
+    }
+  }
+
+  double mean0 = (sum0*1.0)/halfCount;
+  double mean1 = (sum1*1.0)/halfCount;
+  double var0 = (sumSq0*1.0)/halfCount - mean0*mean0;
+  double var1 = (sumSq1*1.0)/halfCount - mean1*mean1;
+
+  double gain = interleaveGain;
+  if(var0 > 4.0 && var1 > 4.0){ // Need at least ~2 counts of spread on each ADC to trust a gain estimate
+    gain = sqrt(var0/var1);
+  }
+  double offset = mean0 - gain*mean1;
+
+  interleaveGain += (gain - interleaveGain)/INTERLEAVE_SMOOTHING;
+  interleaveOffset += (offset - interleaveOffset)/INTERLEAVE_SMOOTHING;
+}
+
+/*
+Name: correctInterleaveMismatch
+Description: The two ADCs never have exactly the same gain and offset, which shows up as a sawtooth 'fence' on an interleaved record. This
+maps the ADC1 (odd) samples onto the ADC0 (even) samples in 16.16 fixed point. The gain/offset comes from the calibration tables when the
+channel is calibrated on both ADCs, otherwise it is estimated from the record itself: both halves see the same signal, so their mean and
+variance should match. The estimate is averaged over INTERLEAVE_SMOOTHING acquisitions, and the gain is only re-estimated when the signal
+has enough variance to measure it (a DC input only updates the offset).
+Returns: Nothing (updates sampleStore and global variables)
+Parameters: int "ch" (the interleaved record channel)
+*/
+void correctInterleaveMismatch(int ch){
+  sample_t window[RECORD_WINDOW];
+  if(!interleaveCalibrated){
+    estimateInterleaveMismatch(ch);
+  }
+
+  int32_t gainQ16 = (int32_t)(interleaveGain*65536.0);
+  int32_t offsetQ16 = (int32_t)(interleaveOffset*65536.0) + 32768; // + 0.5 so the shift rounds to nearest
+
+  for(int base = 0; base < NUM_SAMPLES; base += RECORD_WINDOW){
+    int n = min(RECORD_WINDOW, NUM_SAMPLES - base);
+    loadRecordWindow(ch, base, n, window);
+    for(int i = 1; i < n; i += 2){
+      int corrected = (window[i]*gainQ16 + offsetQ16) >> 16;
+      bound(corrected, 0, ADC_MAX_COUNT);
+      window[i] = corrected;
+    }
+    saveRecordWindow(ch, base, n, window);
+  }
+}
+
+/*
+Name: sampleChannels
+Description: Sample ADC0 and ADC1 on the Teensy 4.1 (for channel 1 & 2) NUM_SAMPLES times, and pack the samples straight into the record
+(sampleStore), STORE_RECORD_BITS bits each: the ADC has 10-bit resolution, and the record keeps the processed counts it becomes in place. In
+the interleaved modes (see updateAcquisitionMode) both ADCs fill the one enabled channel's record at twice the rate instead.
+Returns: Nothing (updates sampleStore)
+Parameters: None
+*/
+void sampleChannels(){
+  #if DUMMY
+    for(int i = 0; i < NUM_SAMPLES; i++){
+      setRecordSample(0, i, i%1023);
+      setRecordSample(1, i, 1023 - i%1023);
+    }
+  #endif
+
+  #if !DUMMY
+  if(acqMode == ACQ_INTERLEAVE_CH1){
+    sampleInterleaved(CH1_PIN, 0);
+    correctInterleaveMismatch(0);
+    return;
+  }
+  if(acqMode == ACQ_INTERLEAVE_CH2){
+    sampleInterleaved(CH2_PIN, 1);
+    correctInterleaveMismatch(1);
+    return;
+  }
+
+  for(int i = 0; i < NUM_SAMPLES; i++){
+  while(adc->adc0->isConverting() || adc->adc1->isConverting());
+
+  uint16_t ch1Val = adc->adc0->readSingle();
+  uint16_t ch2Val = adc->adc1->readSingle();
+
+  adc->startSynchronizedSingleRead(CH1_PIN, CH2_PIN);
+
+  // Packed while the next pair converts
+  setRecordSample(0, i, ch1Val);
+  setRecordSample(1, i, ch2Val);
+
+  // Sample 0 was started at the end of the last record, so the record's clock (and the external trigger) starts with sample 1
+  if(i == 0){
+    recordStartStamp = readExtTrigClock();
+    armExternalTrigger();
+  }
+  }
+  recordEndStamp = readExtTrigClock();
+  recordStartStamp -= ((recordEndStamp - recordStartStamp) & EXT_TRIG_CLOCK_MASK)/(NUM_SAMPLES - 1); // Back one sample, to where sample 0 sits on that clock
+  #endif
+}
+
+/*
+Name: processNormal
+Description: Streaming kernel for single acquisitions: scales a window of a record from ADC counts to processed counts.
+Returns: Nothing (updates the provided array)
+Parameters: SampleT "data[]", int "n" (samples in the window)
+*/
+template<typename SampleT>
+void processNormal(SampleT data[], int n){
+  for(int i = 0; i < n; i++){
+    data[i] <<= PROC_EXTRA_BITS;
+  }
+}
+
+/*
+Name: processAverageExp
+Description: Streaming kernel for the exponential average: each sample's accumulator (16.16 fixed point ADC counts) moves 1/avgCount of the
+way towards the new sample, then the window is replaced with the accumulator in processed counts. The first acquisition seeds the accumulators.
+Returns: Nothing (updates the provided arrays)
+Parameters: SampleT "data[]", int32_t "accum[]" (the window's accumulators), int "n" (samples in the window)
+*/
+template<typename SampleT>
+void processAverageExp(SampleT data[], int32_t accum[], int n){
+  const int outShift = AVG_FRAC_BITS - PROC_EXTRA_BITS;
+  const int32_t round = 1 << (outShift - 1);
+
+  if(avgAcquired == 0){
+    for(int i = 0; i < n; i++){
+      accum[i] = data[i] << AVG_FRAC_BITS;
+      data[i] <<= PROC_EXTRA_BITS;
+    }
+    return;
+  }
+
+  for(int i = 0; i < n; i++){
+    int32_t acc = accum[i];
+    acc += ((data[i] << AVG_FRAC_BITS) - acc) >> avgLog2;
+    accum[i] = acc;
+    data[i] = (acc + round) >> outShift;
+  }
+}
+
+/*
+Name: processAverageBlock
+Description: Streaming kernel for the block average: adds the window into each sample's accumulator and replaces the window with the average of
+the acquisitions so far in this block (a multiply by a precomputed reciprocal rather than a divide per sample).
+Returns: Nothing (updates the provided arrays)
+Parameters: SampleT "data[]", int32_t "accum[]" (the window's accumulators), int "n" (samples in the window)
+*/
+template<typename SampleT>
+void processAverageBlock(SampleT data[], int32_t accum[], int n){
+  const uint32_t scale = ((uint32_t)(1 << PROC_EXTRA_BITS) << 16)/(avgAcquired + 1); // (processed counts per ADC count / n) in 16.16
+
+  for(int i = 0; i < n; i++){
+    int32_t acc = (avgAcquired == 0) ? data[i] : accum[i] + data[i];
+    accum[i] = acc;
+    data[i] = (int)(((uint64_t)acc*scale + 32768) >> 16);
+  }
+}
+
+// The high-res filter's state between the windows of one record
+template<typename SampleT>
+struct HiResFilter {
+  SampleT history[1 << HIRES_MAX_LOG2]; // The raw samples in the running sum, by record index modulo the filter's length
+  int sum;
+  int length; // Record length
+  int last;   // The record's last raw sample, which stands in for the samples past its end
+};
+
+/*
+Name: processHiResBegin
+Description: Readies the high-res filter for a record: fills its running sum with the window of sample 0 (samples -half to taps - half - 1,
+the ones before the record padded with its first sample).
+Returns: Nothing (sets up the filter)
+Parameters: HiResFilter& "filter", const SampleT "data[]" (the record's first raw samples, at least min(length, taps - half) of them),
+int "length" (record length), int "last" (the record's last raw sample)
+*/
+template<typename SampleT>
+void processHiResBegin(HiResFilter<SampleT>& filter, const SampleT data[], int length, int last){
+  const int taps = 1 << avgLog2;
+  const int half = taps/2;
+
+  filter.sum = 0;
+  filter.length = length;
+  filter.last = last;
+  for(int k = 0; k < taps; k++){
+    int index = k - half;
+    filter.history[k] = (index < 0) ? data[0] : ((index < length) ? data[index] : last);
+    filter.sum += filter.history[k];
+  }
+}
+
+/*
+Name: processHiRes
+Description: Streaming kernel for high-res mode: replaces each sample with the sum of the avgCount samples centered on it (avgCount/2 before it
+to avgCount/2 - 1 after), scaled to processed counts. Centering the boxcar keeps the filtered trace on the trigger point, rather than
+(avgCount - 1)/2 samples early; with an even count the window's center is half a sample before the sample it replaces. The filter's ring
+buffer keeps the raw values the running sum needs, so a window is filtered in place in one pass, carrying on from the previous window. The
+record's ends are padded with its first and last samples.
+Returns: Nothing (updates the provided array and the filter)
+Parameters: HiResFilter& "filter" (set up by processHiResBegin), SampleT "data[]" (raw samples from record index first: the n to filter, then
+the taps - half after them that the sum looks ahead to, where the record has them), int "first", int "n"
+*/
+template<typename SampleT>
+void processHiRes(HiResFilter<SampleT>& filter, SampleT data[], int first, int n){
+  const int taps = 1 << avgLog2;
+  const int half = taps/2;
+  const int shift = avgLog2 - PROC_EXTRA_BITS; // Sum of taps ADC counts -> processed counts
+  const int round = (shift > 0) ? (1 << (shift - 1)) : 0;
+  int sum = filter.sum;
+
+  for(int i = first; i < first + n; i++){
+    data[i - first] = (shift >= 0) ? ((sum + round) >> shift) : (sum << -shift);
+
+    // Slide the window on: the sample entering is still ahead of the one just written
+    int index = i + taps - half;
+    int next = (index < filter.length) ? data[index - first] : filter.last;
+    int slot = i & (taps - 1);
+    sum += next - filter.history[slot];
+    filter.history[slot] = next;
+  }
+  filter.sum = sum;
+}
+
+/*
+Name: processAcquisition
+Description: Runs the selected acquisition processing (procMode) over the record(s) sampled this loop, leaving them in processed counts. Each
+channel is unpacked, processed and packed back a window at a time (with the high-res filter's lookahead unpacked past the window's end).
+In interleaved mode only the interleaved channel was sampled, so the other channel's (already processed) record is left alone.
+Returns: Nothing (updates sampleStore and global variables)
+Parameters: None
+*/
+void processAcquisition(){
+  sample_t window[RECORD_WINDOW + (1 << HIRES_MAX_LOG2)];
+  const int ahead = (procMode == PROC_HIRES) ? (1 << avgLog2) - (1 << avgLog2)/2 : 0;
+
+  for(int ch = 0; ch < NUM_CHANNELS; ch++){
+    if((acqMode == ACQ_INTERLEAVE_CH1 && ch != 0) || (acqMode == ACQ_INTERLEAVE_CH2 && ch != 1)){
+      continue;
+    }
+
+    HiResFilter<sample_t> filter;
+    for(int base = 0; base < NUM_SAMPLES; base += RECORD_WINDOW){
+      int n = min(RECORD_WINDOW, NUM_SAMPLES - base);
+      loadRecordWindow(ch, base, min(n + ahead, NUM_SAMPLES - base), window);
+
+      switch(procMode){
+        case PROC_AVG_EXP:   processAverageExp(window, &avgAccum[ch][base], n);   break;
+        case PROC_AVG_BLOCK: processAverageBlock(window, &avgAccum[ch][base], n); break;
+        case PROC_HIRES:
+          if(base == 0){
+            processHiResBegin(filter, window, NUM_SAMPLES, recordSample(ch, NUM_SAMPLES - 1));
+          }
+          processHiRes(filter, window, base, n);
+        break;
+        default:             processNormal(window, n);
+      }
+      saveRecordWindow(ch, base, n, window);
+    }
+  }
+
+  if(procMode == PROC_AVG_EXP){
+    avgAcquired++;
+  }
+  if(procMode == PROC_AVG_BLOCK){
+    avgAcquired++;
+    if(avgAcquired >= (1 << avgLog2)){
+      avgAcquired = 0;
+    }
+  }
+}
+
+/*
+Name: recordSigma
+Description: Standard deviation of a channel's processed record, in ADC counts. Used to measure the noise (and so the effective bits) of the
+processing modes.
+Returns: double "sigma"
+Parameters: int "ch" (0 or 1)
+*/
+double recordSigma(int ch){
+  const double scale = 1 << PROC_EXTRA_BITS;
+  sample_t window[RECORD_WINDOW];
+  int64_t sum = 0;
+  uint64_t sumSq = 0;
+
+  for(int base = 0; base < NUM_SAMPLES; base += RECORD_WINDOW){
+    int n = min(RECORD_WINDOW, NUM_SAMPLES - base);
+    int32_t windowSum;
+    uint64_t windowSq;
+    loadRecordWindow(ch, base, n, window);
+    sumSquares(window, n, windowSum, windowSq);
+    sum += windowSum;
+    sumSq += windowSq;
+  }
+
+  double mean = sum/(NUM_SAMPLES*scale);
+  double variance = sumSq/(NUM_SAMPLES*scale*scale) - mean*mean;
+  return (variance > 0) ? sqrt(variance) : 0;
+}
+
+/*
+Name: effectiveBits
+Description: Theoretical effective resolution of a processing mode: averaging N uncorrelated noise samples improves it by 0.5*log2(N) bits,
+up to the PROC_EXTRA_BITS the processed counts can hold.
+Returns: double "bits"
+Parameters: int "mode" (procMode value), int "log2Count" (avgLog2 value)
+*/
+double effectiveBits(int mode, int log2Count){
+  if(mode == PROC_NORMAL){
+    return ADC_RESOLUTION;
+  }
+  double gain = 0.5*log2Count;
+  if(gain > PROC_EXTRA_BITS){
+    gain = PROC_EXTRA_BITS;
+  }
+  return ADC_RESOLUTION + gain;
+}
+
+/*
+Name: benchmarkAveraging
+Description: Used for testing & debugging. For every averaging/high-res mode and count, runs enough acquisitions to settle, then reports the
+processing cost per frame (CPU cycles, both channels) and the effective bits: theoretical, and measured from channel 1's noise relative to a
+single acquisition. Channel 1's input should be grounded or held at DC while this runs.
+Returns: Nothing
+Parameters: None
+*/
+void benchmarkAveraging(){
+  const char* modeNames[PROC_NUM_MODES] = {"Normal", "AvgExp", "AvgBlock", "HiRes"};
+  int savedMode = procMode;
+  int savedLog2 = avgLog2;
+
+  Serial.println("Channel 1 should be grounded (or held at DC) for this test");
+
+  procMode = PROC_NORMAL;
+  sampleChannels();
+  processAcquisition();
+  double rawSigma = recordSigma(0);
+  Serial.print("Single acquisition noise (counts RMS): ");
+  Serial.println(rawSigma, 3);
+  Serial.println("Mode, N, cycles/frame, theoretical bits, measured bits");
+
+  for(int mode = PROC_AVG_EXP; mode < PROC_NUM_MODES; mode++){
+    int maxLog2 = (mode == PROC_HIRES) ? HIRES_MAX_LOG2 : AVG_MAX_LOG2;
+
+    for(int log2Count = 1; log2Count <= maxLog2; log2Count++){
+      int acquisitions = 1;
+      if(mode == PROC_AVG_EXP){
+        acquisitions = 4 << log2Count; // ~4 time constants to settle
+      }else if(mode == PROC_AVG_BLOCK){
+        acquisitions = 1 << log2Count;
+      }
+
+      procMode = mode;
+      avgLog2 = log2Count;
+      avgAcquired = 0;
+
+      uint32_t cycles = 0;
+      for(int a = 0; a < acquisitions; a++){
+        sampleChannels();
+        uint32_t start = ARM_DWT_CYCCNT;
+        processAcquisition();
+        cycles = ARM_DWT_CYCCNT - start;
+      }
+
+      double sigma = recordSigma(0);
+
+      Serial.print(modeNames[mode]);
+      Serial.print(", ");
+      Serial.print(1 << log2Count);
+      Serial.print(", ");
+      Serial.print(cycles);
+      Serial.print(", ");
+      Serial.print(effectiveBits(mode, log2Count), 2);
+      Serial.print(", ");
+      if(sigma > 0 && rawSigma > 0){
+        Serial.println(ADC_RESOLUTION + log2(rawSigma/sigma), 2);
+      }else{
+        Serial.println("n/a (no noise measured)");
+      }
+    }
+  }
+
+  procMode = savedMode;
+  avgLog2 = savedLog2;
+  avgAcquired = 0;
+}
+
+/*
+Name: updateVoltageData
+Description: The voltage stage for channel 1 and channel 2. The record stays in counts: a sample is converted into the real-world voltage it
+represents through the calibrated lookup tables wherever it is used, so no volts record is kept. Here the mean voltage of each record
+(offset1/offset2) is accumulated a window at a time, and where in the signal data the trigger voltage first appears is determined and stored
+for read-back later.
+Returns: Nothing (updates global variables)
+Parameters: None
+*/
+void updateVoltageData(){
+  const float* tables[NUM_CHANNELS] = {countToVolts1, countToVolts2};
+  double sums[NUM_CHANNELS] = {0, 0};
+  sample_t window[RECORD_WINDOW];
+
+  for(int ch = 0; ch < NUM_CHANNELS; ch++){
+    for(int base = 0; base < NUM_SAMPLES; base += RECORD_WINDOW){
+      int n = min(RECORD_WINDOW, NUM_SAMPLES - base);
+      loadRecordWindow(ch, base, n, window);
+      for(int i = 0; i < n; i++){
+        // Look up the calibrated voltage for each raw value (see buildVoltageLUTs)
+        sums[ch] += tables[ch][window[i]];
+      }
+    }
+  }
+
+  // Determine where the trigger voltage starts in the trigger source's waveform. With hysteresis, that is the first rising crossing of the
+  // trigger voltage after the signal has been below (triggerVoltage - triggerHysteresis), so noise around the level can't trigger. Without
+  // it, the first sample within +/- 5% of the trigger voltage. Searched on the raw counts (see findTriggerIndex), or, for the pulse width,
+  // runt, timeout and slew triggers, by the streaming trigger (see triggerScan). A replayed capture has no external trigger to go with it.
+  switch(triggerSource){
+    case TRIG_SRC_CH1:
+      trigIndex = findTrigger(0, countToVolts1);
+    break;
+    case TRIG_SRC_CH2:
+      trigIndex = findTrigger(1, countToVolts2);
+    break;
+    case TRIG_SRC_EXT:
+      // No edge (-1) leaves trigIndex at 0, untriggered, like the channel triggers; so does an edge right on sample 0, which has no sample
+      // before it to have been triggered from
+      trigPosition = replaying ? -1 : externalTriggerPosition();
+      trigIndex = (trigPosition < 0) ? 0 : (int)ceil(trigPosition);
+      if(trigIndex == 0){
+        trigPosition = 0;
+      }
+    break;
+    default: // Free-run
+      trigIndex = 0;
+  }
+
+  // Where the source crossed the trigger level between the trigger sample and the one before, so interpolated traces stay put from one
+  // record to the next instead of jumping by whole samples
+  if(triggerSource == TRIG_SRC_CH1 || triggerSource == TRIG_SRC_CH2){
+    int src = (triggerSource == TRIG_SRC_CH2);
+    trigPosition = trigIndex;
+    if(trigIndex > 0){
+      double before = tables[src][recordSample(src, trigIndex - 1)];
+      double at = tables[src][recordSample(src, trigIndex)];
+      if(before != at && (before - triggerVoltage)*(at - triggerVoltage) <= 0){
+        trigPosition = trigIndex - 1 + (triggerVoltage - before)/(at - before);
+      }
+    }
+  }else if(triggerSource == TRIG_SRC_FREE){
+    trigPosition = 0;
+  }
+
+  // Mean of each record (the DC level removed by AC coupling)
+  offset1 = sums[0]/NUM_SAMPLES;
+  offset2 = sums[1]/NUM_SAMPLES;
+}
+
+/*
+Name: extractPlottingData
+Description: Using the horizontal scale (HScale) and the time-per-sample (smapleDt), index the NUM_SAMPLES length array 
+to extract 320 points for plotting on the 320-pixel wide TFT display. Both the voltages (for measurements) and the raw values (for drawing
+through the count -> pixel tables) are kept. The math channel is computed in the same pass, for the plotted points only, and the
+measurements are taken afresh from the new points (measureChannels).
+Returns: Nothing (updates global arrays)
+Parameters: None
+*/
+void extractPlottingData(){
+  int indexRange = 320;
+  double stride = 0;
+  double strideIndex = 0;;
+  
+  indexRange = (int)((32.0*HScale)/sampleDt);
+
+  bound(indexRange, 1, NUM_SAMPLES);
 
   Serial.print("indexRange: ");
   Serial.println(indexRange);
   Serial.print("Stride: ");
   Serial.println(stride);
 
-  stride = indexRange/320.0;
+  stride = indexRange/320.0;
+  plotStride = stride;
+
+  // Timebases shorter than the sample rate: each column is reconstructed between samples, starting at the exact trigger position
+  plotInterpolated = (stride < 1 && interpMode != INTERP_OFF);
+  if(stride < 1){
+    double start = plotInterpolated ? trigPosition : trigIndex;
+    for(int ch = 0; ch < NUM_CHANNELS; ch++){
+      reconstructTrace(ch, start, stride, interpMode, sigRaw[ch]);
+    }
+    for(int i = 0; i < 320; i++){
+      sig1Data[i] = countToVolts1[sigRaw[0][i]];
+      sig2Data[i] = countToVolts2[sigRaw[1][i]];
+      if(mathOp != MATH_OFF){
+        mathData[i] = mathValue(sig1Data[i], sig2Data[i]);
+      }
+    }
+    measureChannels();
+    return;
+  }
+
+  for(int i = 0; i < 320; i++){
+
+    if(strideIndex >= NUM_SAMPLES){
+      Serial.println("Attempt to index past data array! - Stopped");
+      strideIndex = NUM_SAMPLES - 1;
+      break;
+    }
+
+    // Both channels are taken from the same index (the trigger source's), so each column shows them at the same instant
+    int index = (trigIndex + (int)(strideIndex))%NUM_SAMPLES;
+
+    for(int ch = 0; ch < NUM_CHANNELS; ch++){
+      sigRaw[ch][i] = recordSample(ch, index);
+    }
+    sig1Data[i] = countToVolts1[sigRaw[0][i]];
+    sig2Data[i] = countToVolts2[sigRaw[1][i]];
+
+    // Math channel, evaluated only for the plotted points
+    if(mathOp != MATH_OFF){
+      mathData[i] = mathValue(sig1Data[i], sig2Data[i]);
+    }
+
+    strideIndex += stride;
+    
+  }
+  measureChannels();
+}
+
+/*
+Name: recordMinMax
+Description: Lowest and highest of count samples of a channel's record from record index "index", wrapping around the end of the record.
+The samples are unpacked and scanned a window at a time.
+Returns: Nothing (sets low and high)
+Parameters: int "ch" (0 or 1), int "index", int "count" (1 to NUM_SAMPLES), int& "low", int& "high"
+*/
+void recordMinMax(int ch, int index, int count, int& low, int& high){
+  sample_t window[RECORD_WINDOW];
+  low = INT16_MAX;
+  high = INT16_MIN;
+
+  while(count > 0){
+    index %= NUM_SAMPLES;
+    int n = min(count, min(RECORD_WINDOW, NUM_SAMPLES - index));
+    int windowLow, windowHigh;
+    loadRecordWindow(ch, index, n, window);
+    minMax(window, n, windowLow, windowHigh);
+    low = min(low, windowLow);
+    high = max(high, windowHigh);
+    index += n;
+    count -= n;
+  }
+}
+
+/*
+Name: decimateColumns
+Description: Min/max decimation: for each of the 320 screen columns, finds the lowest and highest raw value among every record sample the
+column covers, starting "start" samples into the record and "stride" samples per column (wrapping around the end of the record). Columns
+narrower than a sample hold that one sample.
+Returns: Nothing (fills the provided arrays)
+Parameters: int "ch" (0 or 1), int "start" (record index of the first column), double "stride" (samples per column), uint16_t
+"colMin[]"/"colMax[]" (LX columns each)
+*/
+void decimateColumns(int ch, int start, double stride, uint16_t colMin[], uint16_t colMax[]){
+  double strideIndex = 0;
+
+  for(int i = 0; i < LX; i++){
+    int first = (int)strideIndex;
+    int last = (int)(strideIndex + stride);
+    bound(first, 0, NUM_SAMPLES - 1);
+    bound(last, first + 1, NUM_SAMPLES);
+
+    int low, high;
+    recordMinMax(ch, start + first, last - first, low, high);
+
+    colMin[i] = low;
+    colMax[i] = high;
+    strideIndex += stride;
+  }
+}
+
+/*
+Name: extractPeakColumns
+Description: Peak detect: min/max decimates both channels from the trigger at the stride last used by extractPlottingData, so narrow
+glitches between the plotted points are not missed.
+Returns: Nothing (updates global arrays)
+Parameters: None
+*/
+void extractPeakColumns(){
+  decimateColumns(0, trigIndex, plotStride, sig1ColMin, sig1ColMax);
+  decimateColumns(1, trigIndex, plotStride, sig2ColMin, sig2ColMax);
+}
+
+/*
+Name: extractZoomOverview
+Description: Fills the zoom view's upper pane: the whole record min/max decimated into the screen width. It depends on nothing but the
+record, so it only needs redoing when a new one is acquired or replayed, not on a pan or a timebase change.
+Returns: Nothing (updates global arrays)
+Parameters: None
+*/
+void extractZoomOverview(){
+  for(int ch = 0; ch < NUM_CHANNELS; ch++){
+    decimateColumns(ch, 0, (double)NUM_SAMPLES/LX, zoomOverviewMin[ch], zoomOverviewMax[ch]);
+  }
+}
+
+/*
+Name: extractZoomColumns
+Description: Fills the zoom view's lower pane from the stored record: the window starting zoomOffset samples from the trigger at the stride
+last used by extractPlottingData. The window is kept inside the record, so it never wraps. Nothing here acquires, so panning and zooming a
+held record cost only this one decimation (the overview is extractZoomOverview's).
+Returns: Nothing (updates global variables)
+Parameters: None
+*/
+void extractZoomColumns(){
+  clampZoomOffset();
+  zoomStart = trigIndex + zoomOffset;
+  bound(zoomStart, 0, NUM_SAMPLES - zoomSamples);
+
+  for(int ch = 0; ch < NUM_CHANNELS; ch++){
+    decimateColumns(ch, zoomStart, plotStride, zoomWindowMin[ch], zoomWindowMax[ch]);
+  }
+}
+
+/*
+Name: printRawChannelData
+Description: Used for testing & debugging. Prints out the first 20 values of the NUM_SAMPLES-long record (both channels)
+Returns: Nothing
+Parameters: None
+*/
+void printRawChannelData(){
+  Serial.println("Channel 1 Data (first 20 values):");
+  Serial.print("[");
+  for(int i = 0; i < 20; i++){
+    Serial.print(recordSample(0, i));
+    if(i == NUM_SAMPLES - 1){
+      Serial.println("]");
+    }else{
+      Serial.print(", ");
+    }
+  }
+  
+  Serial.println("Channel 2 Data (first 20 values):");
+  Serial.print("[");
+  for(int i = 0; i < 20; i++){
+    Serial.print(recordSample(1, i));
+    if(i == 19){
+      Serial.println("]");
+    }else{
+      Serial.print(", ");
+    }
+  }
+}
+
+
+/*
+Name: printPlottingData
+Description: Used for testing & debugging. Prints out all 320 values of the "plotting data" arrays (both channels).
+Returns: Nothing
+Parameters: None
+*/
+void printPlottingData(){
+  Serial.println("Channel One Plotting Data -----------");
+    Serial.print("[");
+    for(int i = 0; i < 320; i++){
+      Serial.print(sig1Data[i]);
+      if(i == 319){
+        Serial.println("]");
+      }else{
+        Serial.print(", ");
+      }
+    }
+
+    Serial.println("Channel Two Plotting Data -----------");
+    Serial.print("[");
+    for(int i = 0; i < 320; i++){
+      Serial.print(sig2Data[i]);
+      if(i == 319){
+        Serial.println("]");
+      }else{
+        Serial.print(", ");
+      }
+    }
+}
+
+
+// ----------------------
+/* END ADC FUNCTIONS */
+// ----------------------
+
+
+
+
+
+
+
+
+// -----------------------------------
+/* BEGIN Protocol Decoder Functions */
+// -----------------------------------
+
+/*
+Name: firstCodeAbove
+Description: Finds the lowest (flipped) processed count whose calibrated voltage is at or above a level. Flipping the counts with decodeFlip makes
+the count -> volts table rise for both inverting and non-inverting front ends, so one comparison works for either.
+Returns: int (flipped processed count, or PROC_MAX_CODE + 1 if no count reaches the level)
+Parameters: const float "countToVolts[]" (channel's table), int "flip", double "volts"
+*/
+int firstCodeAbove(const float countToVolts[], int flip, double volts){
+  for(int code = 0; code <= PROC_MAX_CODE; code++){
+    if(countToVolts[code ^ flip] >= volts){
+      return code;
+    }
+  }
+  return PROC_MAX_CODE + 1;
+}
+
+/*
+Name: updateDecodeThresholds
+Description: Converts the logic threshold (plus/minus DECODE_HYSTERESIS) into processed counts for each channel, so the records can be thresholded
+without converting them to volts. Only redone when the threshold or the calibration tables change.
+Returns: Nothing (updates global variables)
+Parameters: None
+*/
+void updateDecodeThresholds(){
+  if(decodeThresholdBuilt == decodeThreshold && decodeVoltageVersion == voltageLUTVersion){
+    return;
+  }
+
+  for(int ch = 0; ch < NUM_CHANNELS; ch++){
+    const float* countToVolts = (ch == 0) ? countToVolts1 : countToVolts2;
+    decodeFlip[ch] = (countToVolts[PROC_MAX_CODE] < countToVolts[0]) ? PROC_MAX_CODE : 0;
+    decodeHighCode[ch] = firstCodeAbove(countToVolts, decodeFlip[ch], decodeThreshold + DECODE_HYSTERESIS);
+    decodeLowCode[ch] = firstCodeAbove(countToVolts, decodeFlip[ch], decodeThreshold - DECODE_HYSTERESIS);
+  }
+
+  decodeThresholdBuilt = decodeThreshold;
+  decodeVoltageVersion = voltageLUTVersion;
+}
+
+/*
+Name: extractEdges
+Description: Thresholds one channel's record (with hysteresis) into a list of the sample indexes where its logic level changes. This is the only
+pass over the samples (unpacked a window at a time); the decoders work from the (much shorter) edge lists. Edges past DECODE_MAX_EDGES are
+dropped.
+Returns: Nothing (updates global arrays)
+Parameters: int "ch" (0 = channel 1, 1 = channel 2)
+*/
+void extractEdges(int ch){
+  sample_t window[RECORD_WINDOW];
+  uint16_t* edges = decodeEdges[ch];
+  int flip = decodeFlip[ch];
+  int highCode = decodeHighCode[ch];
+  int lowCode = decodeLowCode[ch];
+  int numEdges = 0;
+
+  bool level = (recordSample(ch, 0) ^ flip) >= (highCode + lowCode)/2;
+  decodeStartLevel[ch] = level;
+
+  for(int base = 0; base < NUM_SAMPLES; base += RECORD_WINDOW){
+    int n = min(RECORD_WINDOW, NUM_SAMPLES - base);
+    loadRecordWindow(ch, base, n, window);
+    for(int i = (base == 0) ? 1 : 0; i < n; i++){
+      int code = window[i] ^ flip;
+      if(level ? (code < lowCode) : (code >= highCode)){
+        level = !level;
+        if(numEdges < DECODE_MAX_EDGES){
+          edges[numEdges++] = base + i;
+        }
+      }
+    }
+  }
+
+  decodeNumEdges[ch] = numEdges;
+}
+
+/*
+Name: levelAfterEdge
+Description: Logic level of a channel just after one of its edges (every edge toggles the level from decodeStartLevel)
+Returns: bool (true = high)
+Parameters: int "ch", int "edge" (index into the channel's edge list)
+*/
+bool levelAfterEdge(int ch, int edge){
+  return decodeStartLevel[ch] ^ ((edge & 1) == 0);
+}
+
+// Walks forward through one channel's edge list to give its logic level at increasing sample indexes
+struct EdgeCursor {
+  int ch;
+  int next;   // Next edge not yet passed
+  bool level; // Level before that edge
+};
+
+/*
+Name: levelAt
+Description: Logic level of the cursor's channel at a sample index. Indexes must not decrease between calls on the same cursor.
+Returns: bool (true = high)
+Parameters: EdgeCursor& "cursor", int "index" (record sample)
+*/
+bool levelAt(EdgeCursor& cursor, int index){
+  while(cursor.next < decodeNumEdges[cursor.ch] && decodeEdges[cursor.ch][cursor.next] <= index){
+    cursor.level = !cursor.level;
+    cursor.next++;
+  }
+  return cursor.level;
+}
+
+/*
+Name: addAnnotation
+Description: Records one decoded byte or bus condition for drawing (ignored once DECODE_MAX_ANNOTATIONS are stored)
+Returns: Nothing (updates global arrays)
+Parameters: int "row" (0 = by channel 1, 1 = by channel 2), int "start", int "end" (record samples), int "value", int "flags" (ANNOT_...)
+*/
+void addAnnotation(int row, int start, int end, int value, int flags){
+  if(decodeNumAnnotations >= DECODE_MAX_ANNOTATIONS){
+    return;
+  }
+  DecodeAnnotation& annotation = decodeAnnotations[decodeNumAnnotations++];
+  annotation.start = start;
+  annotation.end = (end < NUM_SAMPLES) ? end : (NUM_SAMPLES - 1);
+  annotation.value = value;
+  annotation.flags = flags;
+  annotation.row = row;
+}
+
+/*
+Name: decodeUARTChannel
+Description: Decodes one channel as an idle-high 8N1 UART line at the selected baud rate. Each falling edge after the previous stop bit starts a
+frame; the data bits (LSB first) and the stop bit are read at their centers. A low stop bit is flagged as a framing error.
+Returns: Nothing (adds annotations)
+Parameters: int "ch"
+*/
+void decodeUARTChannel(int ch){
+  double bitSamples = 1.0/(decodeBaudRates[decodeBaudIndex]*sampleDt);
+  if(bitSamples < 2){
+    return; // Too fast to decode at this sample rate
+  }
+
+  int searchFrom = 0; // Earliest sample a start bit may begin at
+  int edge = 0;
+  while(edge < decodeNumEdges[ch]){
+    int start = decodeEdges[ch][edge];
+    if(levelAfterEdge(ch, edge) || start < searchFrom){
+      edge++;
+      continue;
+    }
+
+    EdgeCursor cursor = {ch, edge + 1, false};
+    int value = 0;
+    for(int bit = 0; bit < 8; bit++){
+      int center = start + (int)((bit + 1.5)*bitSamples);
+      if(center >= NUM_SAMPLES){
+        return;
+      }
+      if(levelAt(cursor, center)){
+        value |= 1 << bit;
+      }
+    }
+
+    int stopCenter = start + (int)(9.5*bitSamples);
+    if(stopCenter >= NUM_SAMPLES){
+      return;
+    }
+    int flags = levelAt(cursor, stopCenter) ? 0 : ANNOT_ERROR;
+    addAnnotation(ch, start, start + (int)(10*bitSamples), value, flags);
+
+    searchFrom = stopCenter;
+    edge = cursor.next;
+  }
+}
+
+/*
+Name: decodeUART
+Description: Decodes both channels as independent UART lines (e.g. TX and RX)
+Returns: Nothing (adds annotations)
+Parameters: None
+*/
+void decodeUART(){
+  decodeUARTChannel(0);
+  decodeUARTChannel(1);
+}
+
+/*
+Name: decodeSPI
+Description: Decodes channel 1 as SCK and channel 2 as MOSI (SPI mode 0, MSB first). Data is read on each rising clock edge and grouped into
+bytes. With no chip select, a pause longer than DECODE_SPI_GAP clock periods ends a word; an unfinished word is flagged as an error.
+Returns: Nothing (adds annotations)
+Parameters: None
+*/
+void decodeSPI(){
+  EdgeCursor data = {1, 0, decodeStartLevel[1]};
+  int bits = 0;
+  int value = 0;
+  int wordStart = 0;
+  int lastRise = -1;
+  int period = 0;
+
+  for(int edge = 0; edge < decodeNumEdges[0]; edge++){
+    if(!levelAfterEdge(0, edge)){
+      continue; // Falling clock edge
+    }
+    int t = decodeEdges[0][edge];
+
+    if(bits > 0 && period > 0 && (t - lastRise) > DECODE_SPI_GAP*period){
+      addAnnotation(1, wordStart, lastRise, value, ANNOT_ERROR);
+      bits = 0;
+      value = 0;
+    }
+    if(bits > 0){
+      period = t - lastRise;
+    }else{
+      wordStart = t;
+    }
+
+    value = (value << 1) | (levelAt(data, t) ? 1 : 0);
+    bits++;
+    lastRise = t;
+
+    if(bits == 8){
+      addAnnotation(1, wordStart, t, value, 0);
+      bits = 0;
+      value = 0;
+    }
+  }
+}
+
+/*
+Name: decodeI2C
+Description: Decodes channel 1 as SCL and channel 2 as SDA. The two edge lists are merged in time order: an SDA edge while SCL is high is a start
+(falling) or stop (rising) condition, and each rising SCL edge inside a frame reads one SDA bit (8 data bits MSB first, then the ACK bit). The
+first byte after a start is flagged as the address.
+Returns: Nothing (adds annotations)
+Parameters: None
+*/
+void decodeI2C(){
+  int sclEdge = 0;
+  int sdaEdge = 0;
+  bool scl = decodeStartLevel[0];
+  bool sda = decodeStartLevel[1];
+  bool inFrame = false;
+  bool addressNext = false;
+  int bits = 0;
+  int value = 0;
+  int byteStart = 0;
+
+  while(sclEdge < decodeNumEdges[0] || sdaEdge < decodeNumEdges[1]){
+    bool takeSCL = (sdaEdge >= decodeNumEdges[1])
+                || (sclEdge < decodeNumEdges[0] && decodeEdges[0][sclEdge] <= decodeEdges[1][sdaEdge]);
+
+    if(takeSCL){
+      int t = decodeEdges[0][sclEdge++];
+      scl = !scl;
+      if(!scl || !inFrame){
+        continue;
+      }
+      if(bits == 0){
+        byteStart = t;
+      }
+      if(bits < 8){
+        value = (value << 1) | (sda ? 1 : 0);
+        bits++;
+      }else{ // ACK bit
+        addAnnotation(1, byteStart, t, value, (sda ? ANNOT_NACK : 0) | (addressNext ? ANNOT_ADDRESS : 0));
+        addressNext = false;
+        bits = 0;
+        value = 0;
+      }
+    }else{
+      int t = decodeEdges[1][sdaEdge++];
+      sda = !sda;
+      if(!scl){
+        continue;
+      }
+      if(!sda){ // Start (or repeated start)
+        addAnnotation(1, t, t, 0, ANNOT_START);
+        inFrame = true;
+        addressNext = true;
+        bits = 0;
+        value = 0;
+      }else if(inFrame){ // Stop
+        addAnnotation(1, t, t, 0, ANNOT_STOP);
+        inFrame = false;
+      }
+    }
+  }
+}
+
+// Decoder table (indexed by decodeProtocol, named in decodeProtocolNames). Each decoder reads the edge lists and fills decodeAnnotations, so a
+// new protocol only needs its function, a DECODE_ number and an entry here.
+void (*const protocolDecoders[DECODE_NUM_PROTOCOLS])() = {NULL, decodeUART, decodeSPI, decodeI2C};
+
+/*
+Name: runProtocolDecoder
+Description: Thresholds both records into edges and runs the selected protocol's decoder over them
+Returns: Nothing (updates global arrays)
+Parameters: None
+*/
+void runProtocolDecoder(){
+  decodeNumAnnotations = 0;
+  if(decodeProtocol == DECODE_OFF){
+    return;
+  }
+
+  updateDecodeThresholds();
+  extractEdges(0);
+  extractEdges(1);
+  protocolDecoders[decodeProtocol]();
+}
+
+/*
+Name: synthBus
+Description: Used by the decoder self-test. Holds both channels' records at logic levels (3.3 V or 0 V, in processed counts) for a number of
+samples, starting at (and advancing) a write position.
+Returns: Nothing (edits sampleStore)
+Parameters: bool "level1", bool "level2", int "samples", int& "pos"
+*/
+void synthBus(bool level1, bool level2, int samples, int& pos){
+  int code1 = decodeFlip[0] ^ (level1 ? decodeHighCode[0] + 40 : decodeLowCode[0] - 40);
+  int code2 = decodeFlip[1] ^ (level2 ? decodeHighCode[1] + 40 : decodeLowCode[1] - 40);
+  bound(code1, 0, PROC_MAX_CODE);
+  bound(code2, 0, PROC_MAX_CODE);
+
+  for(int i = 0; i < samples && pos < NUM_SAMPLES; i++, pos++){
+    setRecordSample(0, pos, code1);
+    setRecordSample(1, pos, code2);
+  }
+}
+
+/*
+Name: checkDecoded
+Description: Used by the decoder self-test. Runs one protocol over the synthesized records and compares the decoded bytes (bus conditions are
+skipped) with the expected ones.
+Returns: bool (true if every expected byte was decoded, in order, with the expected flags)
+Parameters: int "protocol", const char* "name", const uint8_t "expected[]", const uint8_t "expectedFlags[]", int "count"
+*/
+bool checkDecoded(int protocol, const char* name, const uint8_t expected[], const uint8_t expectedFlags[], int count){
+  decodeProtocol = protocol;
+  runProtocolDecoder();
+
+  int found = 0;
+  bool pass = true;
+  for(int i = 0; i < decodeNumAnnotations; i++){
+    const DecodeAnnotation& annotation = decodeAnnotations[i];
+    if(annotation.flags & (ANNOT_START | ANNOT_STOP)){
+      continue;
+    }
+    if(found >= count || annotation.value != expected[found] || annotation.flags != expectedFlags[found]){
+      pass = false;
+    }
+    found++;
+  }
+  pass = pass && (found == count);
+
+  Serial.print(name);
+  Serial.print(": ");
+  Serial.print(found);
+  Serial.print(" bytes decoded - ");
+  Serial.println(pass ? "PASS" : "FAIL");
+  return pass;
+}
+
+/*
+Name: testProtocolDecoders
+Description: Used for testing & debugging. Synthesizes a UART, an SPI and an I2C transfer into the records, checks each decoder returns the bytes
+that were sent, and reports how long thresholding and decoding a full record takes. The records are overwritten (the next acquisition replaces them).
+Returns: Nothing (prints to terminal)
+Parameters: None
+*/
+void testProtocolDecoders(){
+  int savedProtocol = decodeProtocol;
+  bool allPass = true;
+  int pos;
+
+  updateDecodeThresholds();
+
+  // UART: "Hi!" on channel 1 at the selected baud rate, channel 2 idle
+  const uint8_t uartBytes[] = {'H', 'i', '!'};
+  const uint8_t uartFlags[] = {0, 0, 0};
+  double bitSamples = 1.0/(decodeBaudRates[decodeBaudIndex]*sampleDt);
+  pos = 0;
+  synthBus(true, true, 100, pos);
+  double bitEdge = pos;
+  for(int i = 0; i < 3; i++){
+    for(int bit = -1; bit <= 9; bit++){ // Start bit, 8 data bits, stop bit
+      bool level = (bit < 0) ? false : (bit > 7) ? true : ((uartBytes[i] >> bit) & 1);
+      bitEdge += bitSamples;
+      synthBus(level, true, (int)bitEdge - pos, pos);
+    }
+    bitEdge += 2*bitSamples; // Idle gap
+    synthBus(true, true, (int)bitEdge - pos, pos);
+  }
+  synthBus(true, true, NUM_SAMPLES, pos);
+  allPass &= checkDecoded(DECODE_UART, "UART", uartBytes, uartFlags, 3);
+
+  // SPI: two words (mode 0, 4 sample half periods) separated by an idle pause
+  const uint8_t spiBytes[] = {0x3C, 0xA5};
+  const uint8_t spiFlags[] = {0, 0};
+  pos = 0;
+  synthBus(false, false, 50, pos);
+  for(int i = 0; i < 2; i++){
+    for(int bit = 7; bit >= 0; bit--){
+      bool data = (spiBytes[i] >> bit) & 1;
+      synthBus(false, data, 4, pos);
+      synthBus(true, data, 4, pos);
+    }
+    synthBus(false, false, 60, pos);
+  }
+  synthBus(false, false, NUM_SAMPLES, pos);
+  allPass &= checkDecoded(DECODE_SPI, "SPI", spiBytes, spiFlags, 2);
+
+  // I2C: start, address 0x50 (write), data 0x5A (both acknowledged), stop
+  const uint8_t i2cBytes[] = {0xA0, 0x5A};
+  const uint8_t i2cFlags[] = {ANNOT_ADDRESS, 0};
+  pos = 0;
+  synthBus(true, true, 50, pos);
+  synthBus(true, false, 5, pos);  // Start: SDA falls with SCL high
+  for(int i = 0; i < 2; i++){
+    for(int bit = 8; bit >= 0; bit--){ // 8 data bits then the ACK (SDA held low)
+      bool data = (bit == 0) ? false : ((i2cBytes[i] >> (bit - 1)) & 1);
+      synthBus(false, data, 5, pos);
+      synthBus(true, data, 5, pos);
+    }
+  }
+  synthBus(false, false, 5, pos);
+  synthBus(true, false, 5, pos);
+  synthBus(true, true, NUM_SAMPLES, pos); // Stop: SDA rises with SCL high
+  allPass &= checkDecoded(DECODE_I2C, "I2C", i2cBytes, i2cFlags, 2);
+
+  // Cost of one full record (thresholding both channels plus decoding)
+  uint32_t start = ARM_DWT_CYCCNT;
+  runProtocolDecoder();
+  uint32_t cycles = ARM_DWT_CYCCNT - start;
+  Serial.print("Edges + I2C decode: ");
+  Serial.print(cycles);
+  Serial.println(" cycles per record");
+
+  Serial.println(allPass ? "Decoder self-test PASSED" : "Decoder self-test FAILED");
+
+  decodeProtocol = savedProtocol;
+  runProtocolDecoder();
+}
+
+
+// ---------------------------------
+/* END Protocol Decoder Functions */
+// ---------------------------------
+
+
+
+
+// ----------------------------
+/* BEGIN Mask Test Functions */
+// ----------------------------
+
+/*
+Name: maskDataCRC
+Description: CRC of the mask block, covering everything except the crc field itself
+Returns: uint32_t "crc"
+Parameters: const MaskData& "data"
+*/
+uint32_t maskDataCRC(const MaskData& data){
+  return calCRC32((const uint8_t*)&data, offsetof(MaskData, crc));
+}
+
+/*
+Name: loadMask
+Description: Reads the mask from EEPROM (stored after the calibration block). A missing or corrupt mask leaves testing without a mask.
+Returns: bool (true if a valid mask was loaded)
+Parameters: None
+*/
+bool loadMask(){
+  EEPROM.get(MASK_EEPROM_ADDR, maskData);
+  maskValid = (maskData.magic == MASK_MAGIC && maskData.version == MASK_VERSION && maskData.crc == maskDataCRC(maskData));
+  return maskValid;
+}
+
+/*
+Name: saveMask
+Description: Stamps the mask with its CRC and writes it to EEPROM
+Returns: Nothing
+Parameters: None
+*/
+void saveMask(){
+  maskData.magic = MASK_MAGIC;
+  maskData.version = MASK_VERSION;
+  maskData.crc = maskDataCRC(maskData);
+  EEPROM.put(MASK_EEPROM_ADDR, maskData);
+}
+
+/*
+Name: buildMask
+Description: Builds a new mask in maskData from the current capture's peak-detect columns. Each column's band covers its neighbours' peaks too
+(allowing a column of timing jitter) and is widened by maskTolerance, converted to counts with the channel's average volts-per-count. The
+channels whose waveforms are shown are the ones tested.
+Returns: Nothing (updates global variables)
+Parameters: None
+*/
+void buildMask(){
+  extractPeakColumns();
+
+  maskData.channels = (showWave1 ? 1 : 0) | (showWave2 ? 2 : 0);
+  maskData.hscaleStep = hscaleStep(HScale);
+
+  for(int ch = 0; ch < NUM_CHANNELS; ch++){
+    const float* countToVolts = (ch == 0) ? countToVolts1 : countToVolts2;
+    const uint16_t* colMin = (ch == 0) ? sig1ColMin : sig2ColMin;
+    const uint16_t* colMax = (ch == 0) ? sig1ColMax : sig2ColMax;
+    double voltsPerCount = fabs(countToVolts[PROC_MAX_CODE] - countToVolts[0])/PROC_MAX_CODE;
+    int tolerance = (int)(maskTolerance/voltsPerCount + 0.5);
+
+    for(int i = 0; i < LX; i++){
+      int low = colMin[i];
+      int high = colMax[i];
+      for(int n = i - 1; n <= i + 1; n += 2){
+        if(n >= 0 && n < LX){
+          low = (colMin[n] < low) ? colMin[n] : low;
+          high = (colMax[n] > high) ? colMax[n] : high;
+        }
+      }
+      low -= tolerance;
+      high += tolerance;
+      bound(low, 0, PROC_MAX_CODE);
+      bound(high, 0, PROC_MAX_CODE);
+      maskData.low[ch][i] = low;
+      maskData.high[ch][i] = high;
+    }
+  }
+}
+
+/*
+Name: makeMask
+Description: Builds a new mask from the current capture (see buildMask), saves it to EEPROM and clears the counters
+Returns: Nothing (updates global variables)
+Parameters: None
+*/
+void makeMask(){
+  buildMask();
+  saveMask();
+  maskValid = true;
+  maskPassCount = 0;
+  maskFailCount = 0;
+  maskLastFailed = false;
+}
+
+/*
+Name: saveMaskFailure
+Description: Keeps a copy of the current (failing) capture for printMaskFailure()
+Returns: Nothing (updates global arrays)
+Parameters: None
+*/
+void saveMaskFailure(){
+  memcpy(maskFailRecord, sampleStore, sizeof(maskFailRecord));
+  maskFailTrigIndex = trigIndex;
+  maskFailSaved = true;
+}
+
+/*
+Name: runMaskTest
+Description: Compares the current capture's peak-detect columns with the mask (one low and one high compare per column per tested channel) and
+updates the pass/fail counters. A failing capture is saved, and stops acquisition if stop-on-fail is set. Captures taken at a different HScale than
+the mask (or a held capture, once acquisition has stopped) are not tested. A new mask asked for from the UI is made here.
+Returns: Nothing (updates global variables)
+Parameters: None
+*/
+void runMaskTest(){
+  if(maskMakePending){
+    maskMakePending = false;
+    makeMask();
+  }
+
+  if(!maskTesting || !maskValid || !acquisitionRunning || hscaleStep(HScale) != maskData.hscaleStep){
+    return;
+  }
+
+  extractPeakColumns();
+
+  maskFailColumn = -1;
+  for(int ch = 0; ch < NUM_CHANNELS && maskFailColumn < 0; ch++){
+    if((maskData.channels & (1 << ch)) == 0){
+      continue;
+    }
+    const uint16_t* colMin = (ch == 0) ? sig1ColMin : sig2ColMin;
+    const uint16_t* colMax = (ch == 0) ? sig1ColMax : sig2ColMax;
+    const uint16_t* low = maskData.low[ch];
+    const uint16_t* high = maskData.high[ch];
+
+    for(int i = 0; i < LX; i++){
+      if(colMin[i] < low[i] || colMax[i] > high[i]){
+        maskFailColumn = i;
+        break;
+      }
+    }
+  }
+
+  maskLastFailed = (maskFailColumn >= 0);
+  if(!maskLastFailed){
+    maskPassCount++;
+    return;
+  }
+
+  maskFailCount++;
+  saveMaskFailure();
+  if(maskStopOnFail){
+    acquisitionRunning = false;
+  }
+}
+
+/*
+Name: printMaskFailure
+Description: Prints the last failing capture over serial as "sample, CH1 volts, CH2 volts" lines, starting at the trigger index
+Returns: Nothing (prints to terminal)
+Parameters: None
+*/
+void printMaskFailure(){
+  if(!maskFailSaved){
+    Serial.println("No failing capture saved");
+    return;
+  }
+
+  Serial.print("Failing capture (fails so far: ");
+  Serial.print(maskFailCount);
+  Serial.println(")");
+  Serial.println("sample, CH1 (V), CH2 (V)");
+  for(int i = 0; i < NUM_SAMPLES; i++){
+    Serial.print(i);
+    Serial.print(", ");
+    int index = (maskFailTrigIndex + i) % NUM_SAMPLES;
+    Serial.print(countToVolts1[storeField<NUM_CHANNELS, STORE_RECORD_BITS, 0>(maskFailRecord, 0, index)], 4);
+    Serial.print(", ");
+    Serial.println(countToVolts2[storeField<NUM_CHANNELS, STORE_RECORD_BITS, 0>(maskFailRecord, 1, index)], 4);
+  }
+}
+
+/*
+Name: testMaskTest
+Description: Used for testing & debugging. Makes a mask from a synthesized 2 V p-p sine on both channels and runs the mask test on: the same
+record (passes), a 3 V p-p sine (fails), the same record a timebase step away (not tested) and at an HScale re-derived 1 ppm off (tested, as
+it is the same step). The mask, its counters and the scope settings are restored afterwards; the failing capture kept for printMaskFailure
+is the test's own.
+Returns: Nothing (prints to terminal)
+Parameters: None
+*/
+void testMaskTest(){
+  const char* names[] = {"Same record", "Larger signal", "Next timebase step", "HScale 1 ppm off"};
+  // {p-p volts, HScale, tested, passes}
+  const double cases[][4] = {
+    {2.0, 50E-6,                      1, 1},
+    {3.0, 50E-6,                      1, 0},
+    {2.0, 50E-6 + HSCALE_Sensitivity, 0, 0},
+    {2.0, 50E-6*(1 + 1E-6),           1, 1},
+  };
+  MaskData savedMask = maskData;
+  bool savedFlags[5] = {maskValid, maskTesting, maskStopOnFail, maskLastFailed, acquisitionRunning};
+  uint32_t savedCounts[2] = {maskPassCount, maskFailCount};
+  int savedFailColumn = maskFailColumn;
+  bool savedWave[2] = {showWave1, showWave2};
+  bool savedAC[2] = {CH1_AC, CH2_AC};
+  double savedHScale = HScale;
+  double savedTolerance = maskTolerance;
+  bool allPass = true;
+
+  showWave1 = showWave2 = true;
+  CH1_AC = CH2_AC = false;
+  maskTolerance = 0.2;
+  maskStopOnFail = false;
+  acquisitionRunning = true;
+
+  for(int c = -1; c < (int)(sizeof(cases)/sizeof(cases[0])); c++){
+    double amplitude = (c < 0) ? 2.0 : cases[c][0];
+    for(int ch = 0; ch < NUM_CHANNELS; ch++){
+      const float* countToVolts = (ch == 0) ? countToVolts1 : countToVolts2;
+      for(int i = 0; i < NUM_SAMPLES; i++){
+        setRecordSample(ch, i, voltsToCode(countToVolts, 1.0 + sin(2*M_PI*1000*i*sampleDt)*amplitude/2));
+      }
+    }
+    HScale = (c < 0) ? 50E-6 : cases[c][1];
+    updateVoltageData();
+    extractPlottingData();
+
+    if(c < 0){
+      buildMask(); // Not makeMask: the one in EEPROM stays
+      maskValid = maskTesting = true;
+      continue;
+    }
+
+    uint32_t before = maskPassCount + maskFailCount;
+    runMaskTest();
+    bool tested = (maskPassCount + maskFailCount != before);
+    bool passes = tested && !maskLastFailed;
+    bool pass = (tested == (cases[c][2] != 0)) && (passes == (cases[c][3] != 0));
+    allPass &= pass;
+
+    Serial.print(names[c]);
+    Serial.print(tested ? (passes ? ": tested, passed" : ": tested, failed") : ": not tested");
+    Serial.println(pass ? " - PASS" : " - FAIL");
+  }
+  Serial.println(allPass ? "Mask self-test PASSED" : "Mask self-test FAILED");
+
+  maskData = savedMask;
+  maskValid = savedFlags[0];
+  maskTesting = savedFlags[1];
+  maskStopOnFail = savedFlags[2];
+  maskLastFailed = savedFlags[3];
+  acquisitionRunning = savedFlags[4];
+  maskPassCount = savedCounts[0];
+  maskFailCount = savedCounts[1];
+  maskFailColumn = savedFailColumn;
+  showWave1 = savedWave[0];
+  showWave2 = savedWave[1];
+  CH1_AC = savedAC[0];
+  CH2_AC = savedAC[1];
+  HScale = savedHScale;
+  maskTolerance = savedTolerance;
+}
+
+
+// --------------------------
+/* END Mask Test Functions */
+// --------------------------
+
+
+
+
+// -------------------------------------
+/* BEGIN Reference Waveform Functions */
+// -------------------------------------
+
+/*
+Name: saveRefSlot
+Description: Copies one channel's plotted trace and the first REF_RECORD_LENGTH samples of its record from the trigger on (wrapping around the
+end of the record) into a reference slot, and shows it
+Returns: Nothing (updates global variables)
+Parameters: int "slot", int "ch" (0 = channel 1, 1 = channel 2)
+*/
+void saveRefSlot(int slot, int ch){
+  RefSlot& ref = refSlots[slot];
+  const uint16_t* raw = sigRaw[ch];
+  sample_t window[RECORD_WINDOW];
+
+  memcpy(ref.trace, raw, sizeof(ref.trace));
+  for(int first = 0; first < REF_RECORD_LENGTH; first += RECORD_WINDOW){
+    int n = min(RECORD_WINDOW, REF_RECORD_LENGTH - first);
+    loadRecordSpan(ch, trigIndex + first, n, window);
+    for(int i = 0; i < n; i++){
+      refRecords[slot][first + i] = window[i];
+    }
+  }
+
+  ref.channel = ch;
+  ref.sampleDt = sampleDt;
+  ref.stride = plotStride;
+  ref.hasRecord = true;
+  ref.valid = true;
+  ref.shown = true;
+  ref.mappedLUTBuild = -1;
+}
+
+/*
+Name: packRefSlot
+Description: Fills the stored form of a slot (as written to EEPROM or the start of an SD file), CRC included
+Returns: Nothing (edits the provided struct)
+Parameters: int "slot", RefStoredTrace& "stored"
+*/
+void packRefSlot(int slot, RefStoredTrace& stored){
+  const RefSlot& ref = refSlots[slot];
+  stored.magic = REF_MAGIC;
+  stored.version = REF_VERSION;
+  stored.channel = ref.channel;
+  stored.sampleDt = ref.sampleDt;
+  stored.stride = ref.stride;
+  memcpy(stored.trace, ref.trace, sizeof(stored.trace));
+  stored.crc = calCRC32((const uint8_t*)&stored, offsetof(RefStoredTrace, crc));
+}
+
+/*
+Name: unpackRefSlot
+Description: Checks a stored reference and, if it is valid, loads it into a slot (shown, without a full record until one is read)
+Returns: bool (true if the stored reference was valid)
+Parameters: int "slot", const RefStoredTrace& "stored"
+*/
+bool unpackRefSlot(int slot, const RefStoredTrace& stored){
+  if(stored.magic != REF_MAGIC || stored.version != REF_VERSION || stored.channel > 1
+     || stored.crc != calCRC32((const uint8_t*)&stored, offsetof(RefStoredTrace, crc))){
+    return false;
+  }
+
+  RefSlot& ref = refSlots[slot];
+  ref.channel = stored.channel;
+  ref.sampleDt = stored.sampleDt;
+  ref.stride = stored.stride;
+  memcpy(ref.trace, stored.trace, sizeof(ref.trace));
+  ref.hasRecord = false;
+  ref.valid = true;
+  ref.shown = true;
+  ref.mappedLUTBuild = -1;
+  return true;
+}
+
+/*
+Name: refFileName
+Description: Name of a slot's file on the SD card (REF1.BIN to REF4.BIN)
+Returns: Nothing (fills the provided buffer)
+Parameters: int "slot" (0 to REF_NUM_SLOTS - 1), char* "name" (at least 12 chars)
+*/
+void refFileName(int slot, char* name){
+  snprintf(name, 12, "REF%c.BIN", '1' + slot); // One digit, so the name always fits 8.3
+}
+
+/*
+Name: writeRefSD
+Description: Writes a slot to the SD card: the stored trace followed by its record (if the slot has one)
+Returns: bool (true if written)
+Parameters: int "slot"
+*/
+bool writeRefSD(int slot){
+  if(!sdAvailable){
+    return false;
+  }
+
+  char name[12];
+  RefStoredTrace stored;
+  refFileName(slot, name);
+  packRefSlot(slot, stored);
+
+  SD.remove(name);
+  File file = SD.open(name, FILE_WRITE);
+  if(!file){
+    return false;
+  }
+  bool ok = file.write((const uint8_t*)&stored, sizeof(stored)) == sizeof(stored);
+  if(refSlots[slot].hasRecord){
+    ok = ok && file.write((const uint8_t*)refRecords[slot], sizeof(refRecords[slot])) == sizeof(refRecords[slot]);
+  }
+  file.close();
+  return ok;
+}
+
+/*
+Name: readRefSD
+Description: Reads a slot back from the SD card (the full record too, if the file has one)
+Returns: bool (true if a valid reference was read)
+Parameters: int "slot"
+*/
+bool readRefSD(int slot){
+  if(!sdAvailable){
+    return false;
+  }
+
+  char name[12];
+  RefStoredTrace stored;
+  refFileName(slot, name);
+
+  File file = SD.open(name, FILE_READ);
+  if(!file){
+    return false;
+  }
+  bool ok = file.read(&stored, sizeof(stored)) == (int)sizeof(stored) && unpackRefSlot(slot, stored);
+  if(ok){
+    refSlots[slot].hasRecord = file.read(refRecords[slot], sizeof(refRecords[slot])) == (int)sizeof(refRecords[slot]);
+  }
+  file.close();
+  return ok;
+}
+
+/*
+Name: runRefAction
+Description: Runs the reference action asked for from the UI (if any) on the selected slot. Saving needs a valid slot to store from; EEPROM
+actions only apply to the first REF_EEPROM_SLOTS slots.
+Returns: Nothing (updates global variables)
+Parameters: None
+*/
+void runRefAction(){
+  if(refPendingAction < 0){
+    return;
+  }
+
+  int action = refPendingAction;
+  RefSlot& ref = refSlots[refSlot];
+  RefStoredTrace stored;
+  bool ok = true;
+  refPendingAction = -1;
+
+  switch(action){
+    case REF_ACT_SAVE_CH1:
+      saveRefSlot(refSlot, 0);
+    break;
+    case REF_ACT_SAVE_CH2:
+      saveRefSlot(refSlot, 1);
+    break;
+    case REF_ACT_SHOW:
+      ref.shown = !ref.shown;
+    break;
+    case REF_ACT_CLEAR:
+      ref.valid = false;
+    break;
+    case REF_ACT_WRITE_EEPROM:
+      ok = ref.valid && refSlot < REF_EEPROM_SLOTS;
+      if(ok){
+        packRefSlot(refSlot, stored);
+        EEPROM.put(REF_EEPROM_ADDR + refSlot*sizeof(RefStoredTrace), stored);
+      }
+    break;
+    case REF_ACT_READ_EEPROM:
+      ok = refSlot < REF_EEPROM_SLOTS;
+      if(ok){
+        EEPROM.get(REF_EEPROM_ADDR + refSlot*sizeof(RefStoredTrace), stored);
+        ok = unpackRefSlot(refSlot, stored);
+      }
+    break;
+    case REF_ACT_WRITE_SD:
+      ok = ref.valid && writeRefSD(refSlot);
+    break;
+    case REF_ACT_READ_SD:
+      ok = readRefSD(refSlot);
+    break;
+  }
+
+  if(!ok){
+    Serial.print("Reference action failed on slot ");
+    Serial.println(refSlot + 1);
+  }
+}
+
+/*
+Name: mapRefSlot
+Description: Maps a reference to a screen row per column through its channel's count -> pixel table, at the current time per column. With a
+record the columns are re-sampled from it; otherwise the stored trace is stretched/squeezed. Columns past the end of the reference get
+REF_NO_ROW. Only called when the time per column or the channel's table has changed, so drawing a reference costs the same as a live trace.
+Returns: Nothing (updates the slot)
+Parameters: int "slot"
+*/
+void mapRefSlot(int slot){
+  RefSlot& ref = refSlots[slot];
+  const uint8_t* countToPixel = (ref.channel == 0) ? countToPixel1 : countToPixel2;
+  double columnTime = plotStride*sampleDt;
+  double samplesPerColumn = columnTime/ref.sampleDt;
+
+  double tracePerColumn = samplesPerColumn/ref.stride;
+
+  // The small bias keeps an unchanged timebase mapping each column back onto itself despite rounding
+  for(int i = 0; i < LX; i++){
+    if(ref.hasRecord){
+      int sample = (int)(i*samplesPerColumn + 1E-6);
+      ref.rows[i] = (sample < REF_RECORD_LENGTH) ? countToPixel[refRecords[slot][sample]] : REF_NO_ROW;
+    }else{
+      int column = (int)(i*tracePerColumn + 1E-6);
+      ref.rows[i] = (column < LX) ? countToPixel[ref.trace[column]] : REF_NO_ROW;
+    }
+  }
+
+  ref.mappedColumnTime = columnTime;
+  ref.mappedLUTBuild = pixelLUTBuild[ref.channel];
+}
+
+
+// -----------------------------------
+/* END Reference Waveform Functions */
+// -----------------------------------
+
+
+
+
+// ------------------------------------
+/* BEGIN Frequency Counter Functions */
+// ------------------------------------
+
+/*
+Name: startFrequencyTimer
+Description: Sets QuadTimer 4 up to count FREQ_PIN's rising edges: channel 2 counts its input pin and reloads from 0 at 0xFFFF, and channel 3
+counts channel 2's compares, so together they make a free-running 32 bit count
+Returns: Nothing (sets up the timer)
+Parameters: None
+*/
+void startFrequencyTimer(){
+  CCM_CCGR6 |= CCM_CCGR6_QTIMER4(CCM_CCGR_ON);
+
+  TMR4_CTRL2 = 0;
+  TMR4_CTRL3 = 0;
+  TMR4_SCTRL2 = 0;
+  TMR4_SCTRL3 = 0;
+  TMR4_CSCTRL2 = 0;
+  TMR4_CSCTRL3 = 0;
+  TMR4_LOAD2 = 0;
+  TMR4_LOAD3 = 0;
+  TMR4_COMP12 = 0xFFFF;
+  TMR4_COMP13 = 0xFFFF;
+  TMR4_CNTR2 = 0;
+  TMR4_CNTR3 = 0;
+
+  TMR4_CTRL3 = TMR_CTRL_CM(7) | TMR_CTRL_PCS(4 + 2) | TMR_CTRL_LENGTH; // Cascaded on channel 2's output
+  TMR4_CTRL2 = TMR_CTRL_CM(1) | TMR_CTRL_PCS(2) | TMR_CTRL_LENGTH;     // Rising edges of counter input 2
+  TMR4_ENBL |= (1 << 2) | (1 << 3);
+
+  IOMUXC_SW_MUX_CTL_PAD_GPIO_B0_11 = 1; // ALT1: QTIMER4_TIMER2
+}
+
+/*
+Name: stopFrequencyTimer
+Description: Stops QuadTimer 4's channels 2 and 3 (see startFrequencyTimer)
+Returns: Nothing
+Parameters: None
+*/
+void stopFrequencyTimer(){
+  TMR4_CTRL2 = 0;
+  TMR4_CTRL3 = 0;
+}
+
+/*
+Name: readFrequencyTimer
+Description: Reads the 32 bit edge count (reading channel 2 latches channel 3 into its hold register, so the halves go together) and the cycle
+counter at the same moment
+Returns: uint32_t "count" (edges since the timer was started, wrapping)
+Parameters: uint32_t& "stamp" (set to the cycle counter at the read)
+*/
+uint32_t readFrequencyTimer(uint32_t& stamp){
+  noInterrupts();
+  uint16_t low = TMR4_CNTR2;
+  uint16_t high = TMR4_HOLD3;
+  stamp = ARM_DWT_CYCCNT;
+  interrupts();
+  return ((uint32_t)high << 16) | low;
+}
+
+/*
+Name: gatedFrequency
+Description: A gate's edges over its length. Edges are counted whole while the gate starts and ends anywhere in a period, so the reading is
+good to +/-1 edge over the gate.
+Returns: double "frequency" (Hz, 0 if no edges were counted)
+Parameters: uint32_t "edges", uint32_t "ticks" (gate length), double "clockHz" (clock the gate was timed with)
+*/
+double gatedFrequency(uint32_t edges, uint32_t ticks, double clockHz){
+  if(edges == 0 || ticks == 0){
+    return 0;
+  }
+  return edges*clockHz/ticks;
+}
+
+/*
+Name: updateFrequencyCounter
+Description: Starts/stops the edge counting timer to follow freqCounterOn and, at the end of each gate, reads the count and updates
+freqMeasured and freqDigits. A gate with fewer than FREQ_MIN_EDGES edges is stretched up to FREQ_MAX_GATE_MS.
+Returns: Nothing (updates global variables)
+Parameters: None
+*/
+void updateFrequencyCounter(){
+  if(!freqCounterOn){
+    if(freqCounterRunning){
+      stopFrequencyTimer();
+      freqCounterRunning = false;
+    }
+    freqMeasured = 0;
+    return;
+  }
+
+  if(!freqCounterRunning){
+    startFrequencyTimer();
+    freqGateCount = readFrequencyTimer(freqGateStamp);
+    freqGateStart = millis();
+    freqCounterRunning = true;
+  }
+
+  uint32_t elapsed = millis() - freqGateStart;
+  if(elapsed < FREQ_GATE_MS){
+    return;
+  }
+
+  uint32_t stamp;
+  uint32_t count = readFrequencyTimer(stamp);
+  uint32_t edges = count - freqGateCount; // Unsigned differences survive the count and the cycle counter wrapping
+  if(edges < FREQ_MIN_EDGES && elapsed < FREQ_MAX_GATE_MS){
+    return;
+  }
+
+  freqMeasured = gatedFrequency(edges, stamp - freqGateStamp, F_CPU_ACTUAL);
+  freqDigits = 1;
+  for(uint32_t rest = edges; rest >= 10 && freqDigits < 7; rest /= 10){
+    freqDigits++;
+  }
+
+  freqGateCount = count;
+  freqGateStamp = stamp;
+  freqGateStart = millis();
+}
+
+
+// ----------------------------------
+/* END Frequency Counter Functions */
+// ----------------------------------
+
+
+
+
+// --------------------------
+/* BEGIN Autoset Functions */
+// --------------------------
+
+/*
+Name: summarizeRecord
+Description: Measures one channel's record for autoset: its range and mean, and its fundamental period from the rising crossings of the
+mid level (with AUTOSET_HYSTERESIS, so noise doesn't add crossings), averaged over every whole cycle in the record. Two passes over the
+record, each a window at a time through the channel's count -> volts table.
+Returns: Nothing (fills the provided summary)
+Parameters: int "ch" (0 or 1), SignalSummary& "summary"
+*/
+void summarizeRecord(int ch, SignalSummary& summary){
+  const float* countToVolts = (ch == 0) ? countToVolts1 : countToVolts2;
+  sample_t window[RECORD_WINDOW];
+  double sum = 0;
+  summary.min = countToVolts[recordSample(ch, 0)];
+  summary.max = summary.min;
+  for(int base = 0; base < NUM_SAMPLES; base += RECORD_WINDOW){
+    int n = min(RECORD_WINDOW, NUM_SAMPLES - base);
+    loadRecordWindow(ch, base, n, window);
+    for(int i = 0; i < n; i++){
+      double volts = countToVolts[window[i]];
+      sum += volts;
+      if(volts < summary.min){
+        summary.min = volts;
+      }else if(volts > summary.max){
+        summary.max = volts;
+      }
+    }
+  }
+  summary.mean = sum/NUM_SAMPLES;
+  summary.period = 0;
+
+  double amplitude = summary.max - summary.min;
+  if(amplitude < AUTOSET_MIN_AMPLITUDE){
+    return;
+  }
+
+  double mid = (summary.max + summary.min)/2;
+  double armLevel = mid - AUTOSET_HYSTERESIS*amplitude;
+  bool armed = false;
+  int crossings = 0;
+  int firstCrossing = 0;
+  int lastCrossing = 0;
+  for(int base = 0; base < NUM_SAMPLES; base += RECORD_WINDOW){
+    int n = min(RECORD_WINDOW, NUM_SAMPLES - base);
+    loadRecordWindow(ch, base, n, window);
+    for(int i = 0; i < n; i++){
+      double volts = countToVolts[window[i]];
+      if(volts < armLevel){
+        armed = true;
+      }else if(armed && volts >= mid){
+        armed = false;
+        if(crossings == 0){
+          firstCrossing = base + i;
+        }
+        lastCrossing = base + i;
+        crossings++;
+      }
+    }
+  }
+
+  if(crossings >= 2){
+    summary.period = ((lastCrossing - firstCrossing)*sampleDt)/(crossings - 1);
+  }
+}
+
+/*
+Name: roundUp125
+Description: Rounds a (positive) value up to the next step of the 1-2-5 sequence (..., 0.5, 1, 2, 5, 10, ...)
+Returns: double "step"
+Parameters: double "value"
+*/
+double roundUp125(double value){
+  double decade = pow(10, floor(log10(value)));
+  const double steps[] = {1, 2, 5, 10};
+  for(int i = 0; i < 4; i++){
+    if(steps[i]*decade >= value*(1 - 1E-9)){
+      return steps[i]*decade;
+    }
+  }
+  return 10*decade;
+}
+
+/*
+Name: applyAutoset
+Description: Sets the scope up from the channel summaries. Each shown channel gets the smallest 1-2-5 VScale that fits its peak-to-peak into
+AUTOSET_FILL of its band (the whole screen for one channel; the top and bottom halves for two), positioned so its mid level is centered in the
+band. The timebase shows AUTOSET_PERIODS periods of the first channel with a period, and the trigger goes to that channel's 50% level with
+AUTOSET_HYSTERESIS (with that channel as the source, unless the external trigger is in use).
+Returns: Nothing (edits global variables)
+Parameters: const SignalSummary "summaries[]" (channel 1, channel 2)
+*/
+void applyAutoset(const SignalSummary summaries[]){
+  bool bothShown = summaries[0].active && summaries[1].active;
+  int bandHalfHeight = bothShown ? LY/4 : LY/2;
+  int trigChannel = -1;
+
+  for(int ch = 0; ch < NUM_CHANNELS; ch++){
+    const SignalSummary& summary = summaries[ch];
+    if(!summary.active){
+      continue;
+    }
+
+    double amplitude = summary.max - summary.min;
+    double mid = (summary.max + summary.min)/2;
+    double level = ((ch == 0) ? CH1_AC : CH2_AC) ? (mid - summary.mean) : mid; // AC coupling already removes the mean
+
+    double VScale = VSCALE_Sensitivity;
+    if(amplitude >= AUTOSET_MIN_AMPLITUDE){
+      VScale = roundUp125((amplitude/2)*120/(AUTOSET_FILL*bandHalfHeight));
+    }else{
+      VScale = roundUp125((fabs(level) > VSCALE_Sensitivity) ? fabs(level) : VSCALE_Sensitivity); // Flat: keep it on screen
+    }
+    bound(VScale, VSCALE_Sensitivity, MAX_VSCALE);
+
+    // Band centers: channel 1 in the top half and channel 2 in the bottom half when both are shown
+    int center = bothShown ? ((ch == 0) ? LY/4 : -LY/4) : 0;
+    int VPos = center + (int)round((level/VScale)*120);
+    bound(VPos, -MAX_VPOS, MAX_VPOS);
+
+    if(ch == 0){
+      CH1_VScale = VScale;
+      CH1_VPos = VPos;
+    }else{
+      CH2_VScale = VScale;
+      CH2_VPos = VPos;
+    }
+
+    if(trigChannel < 0 && summary.period > 0){
+      trigChannel = ch;
+    }
+  }
+
+  if(trigChannel < 0){
+    HScale = HScaleMax; // No periodic signal: widest view
+    return;
+  }
+
+  const SignalSummary& trig = summaries[trigChannel];
+  HScale = ceil(AUTOSET_PERIODS*trig.period/32/HSCALE_Sensitivity)*HSCALE_Sensitivity; // 32 HScale units across the screen
+  bound(HScale, shortestHScale(), HScaleMax);
+
+  triggerVoltage = (trig.max + trig.min)/2;
+  bound(triggerVoltage, 0, MAX_TRIGGER);
+  triggerHysteresis = AUTOSET_HYSTERESIS*(trig.max - trig.min);
+  if(triggerSource != TRIG_SRC_EXT){
+    triggerSource = (trigChannel == 0) ? TRIG_SRC_CH1 : TRIG_SRC_CH2;
+  }
+}
+
+/*
+Name: autosetFromRecords
+Description: Runs autoset on the records already through the voltage stage (updateVoltageData)
+Returns: Nothing (edits global variables)
+Parameters: SignalSummary "summaries[]" (filled in, channel 1 and channel 2)
+*/
+void autosetFromRecords(SignalSummary summaries[]){
+  summaries[0].active = showWave1;
+  summaries[1].active = showWave2;
+  summarizeRecord(0, summaries[0]);
+  summarizeRecord(1, summaries[1]);
+  applyAutoset(summaries);
+}
+
+/*
+Name: runAutoset
+Description: Takes one fresh record (plain sampling, no averaging, so the result doesn't depend on old acquisitions), sets the scope up from
+it, and reports how long it took
+Returns: Nothing (edits global variables)
+Parameters: None
+*/
+void runAutoset(){
+  SignalSummary summaries[2];
+  int savedMode = procMode;
+  uint32_t start = ARM_DWT_CYCCNT;
+
+  procMode = PROC_NORMAL;
+  sampleChannels();
+  processAcquisition();
+  updateVoltageData();
+  autosetFromRecords(summaries);
+  procMode = savedMode;
+  avgAcquired = 0;
+
+  Serial.print("Autoset took ");
+  Serial.print((ARM_DWT_CYCCNT - start)/(F_CPU_ACTUAL/1000000.0));
+  Serial.println(" us");
+}
+
+/*
+Name: synthRecord
+Description: Used by the autoset self-test. Fills one channel's record with a sine or square wave (in processed counts)
+Returns: Nothing (edits sampleStore)
+Parameters: int "ch", bool "square", double "frequency" (Hz), double "amplitude" (volts peak-to-peak), double "level" (mid level volts)
+*/
+void synthRecord(int ch, bool square, double frequency, double amplitude, double level){
+  const float* countToVolts = (ch == 0) ? countToVolts1 : countToVolts2;
+
+  for(int i = 0; i < NUM_SAMPLES; i++){
+    double phase = sin(2*M_PI*frequency*i*sampleDt + 0.3);
+    if(square){
+      phase = (phase >= 0) ? 1 : -1;
+    }
+    setRecordSample(ch, i, voltsToCode(countToVolts, level + phase*amplitude/2));
+  }
+}
+
+/*
+Name: testAutoset
+Description: Used for testing & debugging. Runs autoset on synthesized signals (one channel and two channel cases) and checks that the period is
+found, each trace fits its band without being tiny, and the trigger sits at the 50% level. The scope settings are restored afterwards.
+Returns: Nothing (prints to terminal)
+Parameters: None
+*/
+void testAutoset(){
+  // {CH1 shown, square, frequency, p-p, level, CH2 shown, square, frequency, p-p, level}
+  const double cases[][10] = {
+    {1, 0, 1000,  2.0, 1.0,   0, 0, 0,    0,   0},
+    {1, 1, 5000,  3.3, 1.65,  1, 0, 5000, 0.5, -0.5},
+    {1, 0, 20000, 0.4, 2.0,   1, 1, 2500, 8.0, 0},
+    {0, 0, 0,     0,   0,     1, 0, 700,  1.0, 0.2},
+  };
+  double savedVScale[2] = {CH1_VScale, CH2_VScale};
+  int savedVPos[2] = {CH1_VPos, CH2_VPos};
+  bool savedWave[2] = {showWave1, showWave2};
+  bool savedAC[2] = {CH1_AC, CH2_AC};
+  double savedHScale = HScale;
+  double savedTrigger = triggerVoltage;
+  double savedHysteresis = triggerHysteresis;
+  int savedSource = triggerSource;
+  bool allPass = true;
+
+  CH1_AC = false;
+  CH2_AC = false;
+
+  for(int c = 0; c < (int)(sizeof(cases)/sizeof(cases[0])); c++){
+    SignalSummary summaries[2];
+    showWave1 = cases[c][0] != 0;
+    showWave2 = cases[c][5] != 0;
+    synthRecord(0, cases[c][1] != 0, cases[c][2], cases[c][3], cases[c][4]);
+    synthRecord(1, cases[c][6] != 0, cases[c][7], cases[c][8], cases[c][9]);
+    updateVoltageData();
+    autosetFromRecords(summaries);
+
+    bool pass = true;
+    int bandHalfHeight = (showWave1 && showWave2) ? LY/4 : LY/2;
+    int trigChannel = showWave1 ? 0 : 1;
+    for(int ch = 0; ch < NUM_CHANNELS; ch++){
+      if(!summaries[ch].active){
+        continue;
+      }
+      double frequency = cases[c][5*ch + 2];
+      double amplitude = cases[c][5*ch + 3];
+      double halfPixels = (amplitude/2)/((ch == 0) ? CH1_VScale : CH2_VScale)*120;
+      pass &= fabs(summaries[ch].period*frequency - 1) < 0.01;
+      pass &= halfPixels <= AUTOSET_FILL*bandHalfHeight + 1 && halfPixels >= AUTOSET_FILL*bandHalfHeight/2.5 - 1;
+    }
+    double trigAmplitude = cases[c][5*trigChannel + 3];
+    double expectedTrigger = cases[c][5*trigChannel + 4];
+    bound(expectedTrigger, 0, MAX_TRIGGER);
+    pass &= fabs(triggerVoltage - expectedTrigger) < 0.02*trigAmplitude + 0.01;
+    pass &= (savedSource == TRIG_SRC_EXT) || triggerSource == ((trigChannel == 0) ? TRIG_SRC_CH1 : TRIG_SRC_CH2);
+    allPass &= pass;
+
+    Serial.print("Case ");
+    Serial.print(c + 1);
+    Serial.print(": VScale ");
+    Serial.print(CH1_VScale);
+    Serial.print("/");
+    Serial.print(CH2_VScale);
+    Serial.print(", HScale ");
+    Serial.print(HScale*1E6);
+    Serial.print("us, trigger ");
+    Serial.print(triggerVoltage, 3);
+    Serial.println(pass ? " - PASS" : " - FAIL");
+  }
+  Serial.println(allPass ? "Autoset self-test PASSED" : "Autoset self-test FAILED");
+
+  CH1_VScale = savedVScale[0];
+  CH2_VScale = savedVScale[1];
+  CH1_VPos = savedVPos[0];
+  CH2_VPos = savedVPos[1];
+  showWave1 = savedWave[0];
+  showWave2 = savedWave[1];
+  CH1_AC = savedAC[0];
+  CH2_AC = savedAC[1];
+  HScale = savedHScale;
+  triggerVoltage = savedTrigger;
+  triggerHysteresis = savedHysteresis;
+  triggerSource = savedSource;
+}
+
+
+// ------------------------
+/* END Autoset Functions */
+// ------------------------
+
+
+
+
+
+//--------------------------
+/* BEGIN Display Functions */
+// -------------------------
+
+/*
+Name: intToCharArr
+Description: Converts an integer-type value into an array of chars to allow printing of numbers.
+Returns: A char pointer (char array) representing an integer value
+Parameters: int "num"
+*/
+const char* intToCharArr(int num){
+  static char charArr[12]; // Until the next call (a String's buffer would be gone as soon as it returned)
+  snprintf(charArr, sizeof(charArr), "%d", num);
+  return charArr;
+}
+
+/*
+Name: doubletoCharArr 
+Description: Converts a double-type value into an array of chars to allow printing of numbers
+Returns: a char pointer (char array) representing a double value
+Parameters: double "num"
+*/
+const char* doubleToCharArr(double num){
+  static char charArr[24]; // Until the next call, as in intToCharArr
+  snprintf(charArr, sizeof(charArr), "%.2f", num); // Two decimals, as String(double) gave
+  return charArr;
+}
+
+/*
+Name: formatEngineeringDigits
+Description: Formats a value with an SI prefix (n, u, m, k, M) and a unit, keeping up to the given number of significant digits,
+e.g. 0.0000123 "s" -> "12.3us"
+Returns: Nothing (writes into the provided buffer)
+Parameters: char* "buffer", int "size" (of buffer), double "value", const char* "unit", int "digits"
+*/
+void formatEngineeringDigits(char* buffer, int size, double value, const char* unit, int digits){
+  const char* prefixes[] = {"n", "u", "m", "", "k", "M"};
+  int prefix = 3;
+  double magnitude = fabs(value);
+
+  if(magnitude != 0){
+    while(magnitude < 1 && prefix > 0){
+      magnitude *= 1000;
+      value *= 1000;
+      prefix--;
+    }
+    while(magnitude >= 1000 && prefix < 5){
+      magnitude /= 1000;
+      value /= 1000;
+      prefix++;
+    }
+  }
+
+  snprintf(buffer, size, "%.*g%s%s", digits, value, prefixes[prefix], unit);
+}
+
+/*
+Name: formatEngineering
+Description: formatEngineeringDigits with 4 significant digits (enough for values read off the sample buffer)
+Returns: Nothing (writes into the provided buffer)
+Parameters: char* "buffer", int "size" (of buffer), double "value", const char* "unit"
+*/
+void formatEngineering(char* buffer, int size, double value, const char* unit){
+  formatEngineeringDigits(buffer, size, value, unit, 4);
+}
+
+/*
+Name: updateCursorReadouts
+Description: Recomputes the cursor readouts from the full-resolution record (not the 320 plotted points). Time cursors: delta T between the two
+sample positions and delta V of cursorChannel's trace at those exact samples. Voltage cursors: the difference between the two levels.
+Returns: Nothing (updates global variables)
+Parameters: None
+*/
+void updateCursorReadouts(){
+  if(cursorMode == CURSOR_TIME){
+    const float* countToVolts = (cursorChannel == 0) ? countToVolts1 : countToVolts2;
+
+    cursorDeltaT = (cursorT2 - cursorT1)*sampleDt;
+    cursorDeltaV = countToVolts[recordSample(cursorChannel, (trigIndex + cursorT2)%NUM_SAMPLES)]
+                 - countToVolts[recordSample(cursorChannel, (trigIndex + cursorT1)%NUM_SAMPLES)];
+  }
+
+  if(cursorMode == CURSOR_VOLT){
+    cursorDeltaT = 0;
+    cursorDeltaV = cursorV2 - cursorV1;
+  }
+}
+
+/*
+Name: drawAxes
+Description: Uses the TGX library to draw a collection of vertical & horizontal lines, making the oscilloscope's 
+X & Y axes.
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+void drawAxes()
+  {
+    // Draw X-axis
+    oScopeImage.drawFastHLine(tgx::iVec2 {0, 120}, 320, WHITE);
+
+    //Draw Y-axis
+    oScopeImage.drawFastVLine(tgx::iVec2 {160, 0}, 240, WHITE);
+   
+    // Draw small markers along the X-axis
+    for(int i = 0; i <= 32; i++){
+      oScopeImage.drawFastVLine(tgx::iVec2 {i*10, 115}, 10, WHITE);
+    }
+
+    // Draw small markers along the Y-axis
+    for(int i = 0; i <= 24; i++){
+      oScopeImage.drawFastHLine(tgx::iVec2 {155, i*10}, 10, WHITE);
+    }
+  }
+
+
+/*
+Name: displayTriggerVoltage
+Description: Reads the global "triggerVoltage" variable and displays it on screen. Most accurate units are also printed (mV or V).
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayTriggerVoltage(){
+    // The external and free-run sources have no level to show
+    if(triggerSource == TRIG_SRC_EXT || triggerSource == TRIG_SRC_FREE){
+      oScopeImage.drawText((triggerSource == TRIG_SRC_EXT) ? "Ext Trig" : "Free Run", {240, 10}, TRIG_VOLT_FONT, WHITE);
+      return;
+    }
+    
+    // Display "Volt Trig" heading (or the trigger type, for the qualified triggers)
+    oScopeImage.drawText((triggerType == TRIG_EDGE) ? "Volt Trig: " : triggerTypeNames[triggerType], {240, 10}, TRIG_VOLT_FONT, WHITE);
+    
+    if(abs(triggerVoltage) < 1){
+      oScopeImage.drawText(intToCharArr((int)(triggerVoltage*1000)), {285, 10}, TRIG_VOLT_FONT, WHITE); // Display trigger voltage value
+      oScopeImage.drawText("mV", {305, 10}, TRIG_VOLT_FONT, WHITE); // Add "mV" units
+    } else {
+      oScopeImage.drawText(doubleToCharArr(triggerVoltage), {285, 10}, TRIG_VOLT_FONT, WHITE); // Display trigger voltage value
+      oScopeImage.drawText("V", {305, 10}, TRIG_VOLT_FONT, WHITE); // Add "V" units
+    }
+    
+  }
+
+
+/*
+Name: displayHScale
+Description: Reads the global "HScale" variable and displays its value on screen.
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayHScale(){
+    // On-screen positions are hard-coded here for our given display arrangement
+    oScopeImage.drawText("Horz: ", {265, 230}, SCALE_FONT, WHITE);
+    oScopeImage.drawText(doubleToCharArr(HScale*1000000.0), {295, 230}, SCALE_FONT, WHITE);
+  }
+
+
+/*
+Name: displayRunState
+Description: Shows whether acquisition is running, stopped (the held record is shown), or armed for a single acquisition.
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayRunState(){
+    if(singleArmed){
+      oScopeImage.drawText("Single", {265, 215}, SCALE_FONT, SINGLE_COLOR);
+    }else if(acquisitionRunning){
+      oScopeImage.drawText("Run", {265, 215}, SCALE_FONT, RUN_COLOR);
+    }else{
+      oScopeImage.drawText("Stop", {265, 215}, SCALE_FONT, STOP_COLOR);
+    }
+  }
+
+
+/*
+Name: displayVScale
+Description: Reads the global variables "CH1_VScale" and "CH2_VScale" and displays their values on screen in each channel's color.
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayVScale(){
+    // On-screen positions are hard-coded here for our given display arrangement
+    oScopeImage.drawText("V1: ", {140, 230}, SCALE_FONT, CH1_COLOR);
+    oScopeImage.drawText(doubleToCharArr(CH1_VScale), {160, 230}, SCALE_FONT, CH1_COLOR);
+    oScopeImage.drawText("V2: ", {200, 230}, SCALE_FONT, CH2_COLOR);
+    oScopeImage.drawText(doubleToCharArr(CH2_VScale), {220, 230}, SCALE_FONT, CH2_COLOR);
+  }
+
+/*
+Name: displayChannelMarkers
+Description: Draws a short tick at the left edge of the screen, in each shown channel's color, at the row where that channel's 0 V (or, when
+AC coupled, its mean) is plotted. Shows where each trace has been moved to with the position controls.
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayChannelMarkers(){
+    if(showWave1){
+      int row = LY/2 - CH1_VPos;
+      bound(row, 0, LY - 1);
+      oScopeImage.drawFastHLine(tgx::iVec2 {0, row}, 6, CH1_COLOR);
+    }
+    if(showWave2){
+      int row = LY/2 - CH2_VPos;
+      bound(row, 0, LY - 1);
+      oScopeImage.drawFastHLine(tgx::iVec2 {0, row}, 6, CH2_COLOR);
+    }
+  }
+
+
+  void displayOffsets(){
+    // On-screen positions are hard-coded here for our given display arrangement
+    oScopeImage.drawText("Offset1: ", {220, 120}, SCALE_FONT, WHITE);
+    oScopeImage.drawText(doubleToCharArr(offset1*1.0), {280, 120}, SCALE_FONT, WHITE);
+    oScopeImage.drawText("Offset2: ", {220, 140}, SCALE_FONT, WHITE);
+    oScopeImage.drawText(doubleToCharArr(offset2*1.0), {280, 140}, SCALE_FONT, WHITE);
+  }
+
+/*
+Name: displayStatLine
+Description: Draws one measurement's running statistics as "mean +/-sigma" (engineering units)
+Returns: Nothing (shows on display)
+Parameters: const MeasStats& "stats", const char* "unit", int "x", int "y", tgx::RGB565 "color"
+*/
+  void displayStatLine(const MeasStats& stats, const char* unit, int x, int y, tgx::RGB565 color){
+    char mean[16];
+    char sigma[16];
+    char text[40];
+
+    formatEngineering(mean, sizeof(mean), stats.mean, unit);
+    formatEngineering(sigma, sizeof(sigma), statSigma(stats), unit);
+    snprintf(text, sizeof(text), "%s +/-%s", mean, sigma);
+    oScopeImage.drawText(text, {x, y}, MEAS_FONT, color);
+  }
+
+/*
+Name: displayStatsMeas
+Description: Shows a channel's measurements as their running statistics: the number of acquisitions in the heading, then peak-to-peak and period
+as mean +/- standard deviation. Laid out like the single-shot measurements, starting at the given heading row.
+Returns: Nothing (shows on display)
+Parameters: int "ch" (0 = channel 1, 1 = channel 2), int "y" (heading row), tgx::RGB565 "color"
+*/
+  void displayStatsMeas(int ch, int y, tgx::RGB565 color){
+    const MeasStats& p2p = measStats[(ch == 0) ? STAT_CH1_P2P : STAT_CH2_P2P];
+    const MeasStats& period = measStats[(ch == 0) ? STAT_CH1_T : STAT_CH2_T];
+    char text[40]; // Room for the longest count (10 digits)
+
+    snprintf(text, sizeof(text), "CH%d Stats (n=%lu):", ch + 1, (unsigned long)p2p.count);
+    oScopeImage.drawText(text, {0, y}, MEAS_FONT, color);
+    oScopeImage.drawText("P2P:", {0, y + 15}, MEAS_FONT, color);
+    displayStatLine(p2p, "V", 25, y + 15, color);
+    oScopeImage.drawText("T:", {0, y + 30}, MEAS_FONT, color);
+    displayStatLine(period, "s", 25, y + 30, color);
+  }
+
+/*
+Name: displayFrequencyCounter
+Description: Shows the frequency counter's latest reading (to the digits its edge count supports, from the hardware count rather than the
+sample buffer)
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayFrequencyCounter(){
+    char text[24];
+
+    if(freqMeasured == 0){
+      snprintf(text, sizeof(text), "no signal");
+    }else{
+      formatEngineeringDigits(text, sizeof(text), freqMeasured, "Hz", freqDigits);
+    }
+    oScopeImage.drawText("Freq:", {100, 46}, MEAS_FONT, WHITE);
+    oScopeImage.drawText(text, {130, 46}, MEAS_FONT, WHITE);
+  }
+
+/*
+Name: displayMeas
+Description: displayMeas = "display a channel's measurements." Displays the channel's peak-to-peak voltage and period (see measureChannels),
+channel 1's at the top of the screen and channel 2's at the bottom. With statistics on, their running statistics (see addMeasStats) are shown
+instead.
+Returns: Nothing (shows on display)
+Parameters: int "ch" (0 = channel 1, 1 = channel 2)
+*/
+  void displayMeas(int ch){
+    const tgx::RGB565 color = (ch == 0) ? CH1_COLOR : CH2_COLOR;
+    const int y = (ch == 0) ? 10 : 205; // Heading row; on-screen positions are hard-coded here for our given display arrangement
+    char heading[32]; // Room for any int channel number
+
+    const double p2p = CH_P2P[ch];
+    const double period = CH_T[ch];
+
+    if(showStats){
+      displayStatsMeas(ch, y, color);
+      return;
+    }
+
+    snprintf(heading, sizeof(heading), "CH%d Measurements:", ch + 1);
+    oScopeImage.drawText(heading, {0, y}, MEAS_FONT, color);
+    oScopeImage.drawText("P2P:", {0, y + 15}, MEAS_FONT, color);
+    oScopeImage.drawText("T:", {0, y + 30}, MEAS_FONT, color);
+
+    if(abs(p2p) < 1){
+      oScopeImage.drawText(intToCharArr((int)(p2p*1000)), {25, y + 15}, MEAS_FONT, color);
+      oScopeImage.drawText("mV", {45, y + 15}, TRIG_VOLT_FONT, color); // Add "mV" units
+    } else {
+      oScopeImage.drawText(doubleToCharArr(p2p), {25, y + 15}, MEAS_FONT, color);
+      oScopeImage.drawText("V", {45, y + 15}, TRIG_VOLT_FONT, color); // Add "V" units
+    }
+
+    if(abs(period) < 0.001){
+      oScopeImage.drawText(intToCharArr((int)(period*1000000)), {15, y + 30}, MEAS_FONT, color);
+      oScopeImage.drawText("us", {35, y + 30}, TRIG_VOLT_FONT, color); // Add "micro-seconds" units
+    } else if (abs(period) < 1){
+      oScopeImage.drawText(intToCharArr((int)(period*1000)), {15, y + 30}, MEAS_FONT, color);
+      oScopeImage.drawText("ms", {35, y + 30}, TRIG_VOLT_FONT, color); // Add "milli-seconds" units
+    } else {
+      oScopeImage.drawText(doubleToCharArr(period), {15, y + 30}, MEAS_FONT, color);
+      oScopeImage.drawText("s", {35, y + 30}, TRIG_VOLT_FONT, color); // Add "seconds" units
+    }
+  }
+
+/*
+Name: pixelRow
+Description: The reference (floating point) mapping from a voltage to a screen row: 120 - position + (voltage/scalar)*120, clipped to the
+screen so that off-scale signals sit on the top/bottom edge. updatePixelLUT() uses this to fill the count -> pixel tables.
+Returns: int "row" (0 to LY-1)
+Parameters: double "voltage", double "VScale" (volts per 120 pixels), int "VPos" (pixels the 0 V line is moved up)
+*/
+int pixelRow(double voltage, double VScale, int VPos){
+  int row = (int)((LY/2) - VPos + (voltage/VScale)*120); // Y pixel coordinate = 120 - position + (voltage/scalar)*120
+  bound(row, 0, LY - 1);
+  return row;
+}
+
+/*
+Name: pixelColumn
+Description: The reference (floating point) mapping from a voltage to a screen column for the XY display: 160 + position + (voltage/scalar)*120.
+The same 120 pixels per VScale as the rows keeps the XY plot's aspect ratio square. Clipped to the screen.
+Returns: int "column" (0 to LX-1)
+Parameters: double "voltage", double "VScale" (volts per 120 pixels), int "VPos" (pixels the 0 V line is moved right)
+*/
+int pixelColumn(double voltage, double VScale, int VPos){
+  int column = (int)((LX/2) + VPos + (voltage/VScale)*120);
+  bound(column, 0, LX - 1);
+  return column;
+}
+
+/*
+Name: updatePixelLUT
+Description: Rebuilds one channel's count -> screen row table (and, for channel 1, the count -> column table used by the XY display), but only if its VScale, vertical position, calibration (count -> volts tables) or,
+when AC coupled, its DC level changed since it was last built. The DC level is removed in whole pixels and only moves once the mean has
+drifted AC_REBUILD_HYSTERESIS pixels, so a noisy mean doesn't force a rebuild every frame. With the tables up to date, drawing a trace
+is one table read per point whatever the channel's settings.
+Returns: Nothing (updates global arrays)
+Parameters: int "ch" (0 = channel 1, 1 = channel 2)
+*/
+void updatePixelLUT(int ch){
+  uint8_t* lut = (ch == 0) ? countToPixel1 : countToPixel2;
+  const float* volts = (ch == 0) ? countToVolts1 : countToVolts2;
+  double VScale = (ch == 0) ? CH1_VScale : CH2_VScale;
+  int VPos = (ch == 0) ? CH1_VPos : CH2_VPos;
+  bool AC = (ch == 0) ? CH1_AC : CH2_AC;
+  double mean = (ch == 0) ? offset1 : offset2;
+
+  int dcPixels = 0;
+  if(AC){
+    double meanPixels = (mean/VScale)*120;
+    dcPixels = pixelLUTDCPixels[ch];
+    if(fabs(meanPixels - dcPixels) > AC_REBUILD_HYSTERESIS){
+      dcPixels = (int)round(meanPixels);
+    }
+  }
+
+  if(pixelLUTVScale[ch] == VScale && pixelLUTVPos[ch] == VPos && pixelLUTDCPixels[ch] == dcPixels
+     && pixelLUTVoltageVersion[ch] == voltageLUTVersion){
+    return;
+  }
+
+  // Shifting the 0 V line down by dcPixels is the same as moving the position up by it
+  for(int count = 0; count <= PROC_MAX_CODE; count++){
+    lut[count] = pixelRow(volts[count], VScale, VPos + dcPixels);
+  }
+
+  // Channel 1 is also the X axis of the XY display
+  if(ch == 0){
+    for(int count = 0; count <= PROC_MAX_CODE; count++){
+      countToColumn1[count] = pixelColumn(volts[count], VScale, VPos - dcPixels);
+    }
+  }
+
+  pixelLUTVScale[ch] = VScale;
+  pixelLUTVPos[ch] = VPos;
+  pixelLUTDCPixels[ch] = dcPixels;
+  pixelLUTVoltageVersion[ch] = voltageLUTVersion;
+  pixelLUTBuild[ch]++;
+}
+
+/*
+Name: updatePixelLUTs
+Description: Brings both channels' count -> screen row tables up to date (see updatePixelLUT)
+Returns: Nothing (updates global arrays)
+Parameters: None
+*/
+void updatePixelLUTs(){
+  updatePixelLUT(0);
+  updatePixelLUT(1);
+}
+
+/*
+Name: displaySignal
+Description: displaySignal = "display a channel's signal (waveform)." Map all of the channel's 320 extracted raw values through its
+count -> pixel table and write them straight into the framebuffer, in the channel's color (CH1_COLOR / CH2_COLOR)
+Returns: Nothing (shows on display)
+Parameters: int "ch" (0 = channel 1, 1 = channel 2)
+*/
+  void displaySignal(int ch){
+    // Plot the channel's data points (voltage vs time)
+    drawTrace(sigRaw[ch], (ch == 0) ? countToPixel1 : countToPixel2, ((ch == 0) ? CH1_COLOR : CH2_COLOR).val);
+  }
+
+
+/*
+Name: displayMathSignal
+Description: displayMathSignal = "display the math channel's signal (waveform)." Scales the 320 math points by the math channel's own scale
+and writes them into the framebuffer in MATH_COLOR, with the operation's name under the trigger voltage.
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayMathSignal(){
+    const uint16_t color = MATH_COLOR.val;
+    const double rowScale = 120.0/mathVScale;
+
+    for(int i = 0; i < LX; i++){
+      int row = (int)((LY/2) + mathData[i]*rowScale);
+      bound(row, 0, LY - 1);
+      fb[row*LX + i] = color;
+    }
+
+    oScopeImage.drawText("M: ", {240, 25}, SCALE_FONT, MATH_COLOR);
+    oScopeImage.drawText(mathOpName(), {258, 25}, SCALE_FONT, MATH_COLOR);
+  }
+
+
+/*
+Name: displayXY
+Description: XY display: plots every sample of the record with channel 1 as X and channel 2 as Y, mapping the raw values straight to a pixel
+through the count -> column/row tables. Each hit brightens the pixel (see XY_FIRST_HIT), so the parts of the figure the signals spend the most
+time on stand out. The two channels are unpacked side by side a window at a time. Must be drawn onto a freshly cleared (black) framebuffer,
+before anything else.
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayXY(){
+    sample_t x[RECORD_WINDOW];
+    sample_t y[RECORD_WINDOW];
+
+    for(int base = 0; base < NUM_SAMPLES; base += RECORD_WINDOW){
+      int n = min(RECORD_WINDOW, NUM_SAMPLES - base);
+      loadRecordWindow(0, base, n, x);
+      loadRecordWindow(1, base, n, y);
+      for(int i = 0; i < n; i++){
+        uint16_t* pixel = &fb[countToPixel2[y[i]]*LX + countToColumn1[x[i]]];
+        uint16_t value = *pixel;
+
+        if(value == 0){
+          *pixel = XY_FIRST_HIT;
+        }else if(value >= XY_MAX_HIT - XY_HIT_STEP){
+          *pixel = XY_MAX_HIT;
+        }else{
+          *pixel = value + XY_HIT_STEP;
+        }
+      }
+    }
+
+    oScopeImage.drawText("XY", {170, 10}, SCALE_FONT, WHITE);
+  }
+
+
+/*
+Name: displayZoomPane
+Description: Draws one channel's peak-detect columns into a half-height pane: each column is a vertical bar from its lowest to its highest
+value, mapped through the channel's count -> pixel table and halved so the whole screen's scale and position fit the pane.
+Returns: Nothing (shows on display)
+Parameters: const uint16_t "colMin[]"/"colMax[]" (LX columns each), const uint8_t "lut[]" (count -> pixel table), int "top" (pane's first row),
+uint16_t "color"
+*/
+  void displayZoomPane(const uint16_t colMin[], const uint16_t colMax[], const uint8_t lut[], int top, uint16_t color){
+    for(int i = 0; i < LX; i++){
+      int row1 = top + lut[colMin[i]]/2;
+      int row2 = top + lut[colMax[i]]/2;
+      if(row1 > row2){
+        int swap = row1;
+        row1 = row2;
+        row2 = swap;
+      }
+      for(int row = row1; row <= row2; row++){
+        fb[row*LX + i] = color;
+      }
+    }
+  }
+
+
+/*
+Name: displayZoom
+Description: Zoom (dual timebase) view: the whole record in the upper pane with the zoom window boxed and the trigger marked, and the window
+magnified to the HScale timebase in the lower pane. Draws the columns extractZoomColumns() left, so nothing is re-acquired to pan or zoom.
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayZoom(){
+    const bool shown[2] = {showWave1, showWave2};
+    const uint8_t* luts[2] = {countToPixel1, countToPixel2};
+    const uint16_t colors[2] = {CH1_COLOR.val, CH2_COLOR.val};
+    char text[24];
+
+    for(int ch = 0; ch < NUM_CHANNELS; ch++){
+      if(shown[ch]){
+        displayZoomPane(zoomOverviewMin[ch], zoomOverviewMax[ch], luts[ch], 0, colors[ch]);
+        displayZoomPane(zoomWindowMin[ch], zoomWindowMax[ch], luts[ch], ZOOM_PANE_HEIGHT, colors[ch]);
+      }
+    }
+
+    // The window's place in the record, and the trigger's
+    int x1 = (int)((long)zoomStart*LX/NUM_SAMPLES);
+    int x2 = (int)((long)(zoomStart + zoomSamples)*LX/NUM_SAMPLES) - 1;
+    if(x2 < x1){
+      x2 = x1;
+    }
+    oScopeImage.drawRect({x1, x2, 0, ZOOM_PANE_HEIGHT - 1}, ZOOM_WINDOW_COLOR);
+    oScopeImage.drawFastVLine(tgx::iVec2 {(int)((long)trigIndex*LX/NUM_SAMPLES), 0}, 10, WHITE);
+
+    snprintf(text, sizeof(text), "Zoom x%.1f", (double)NUM_SAMPLES/(LX*plotStride));
+    oScopeImage.drawText(text, {170, ZOOM_PANE_HEIGHT + 10}, SCALE_FONT, ZOOM_WINDOW_COLOR);
+  }
+
+
+/*
+Name: recordColumn
+Description: Screen column a record sample is plotted at (the plotted window starts at the trigger index and wraps around the record)
+Returns: int (column, which may be off screen)
+Parameters: int "index" (record sample)
+*/
+  int recordColumn(int index){
+    if(plotInterpolated){
+      double offset = index - trigPosition;
+      return (int)floor(((offset < 0) ? offset + NUM_SAMPLES : offset)/plotStride);
+    }
+    return (int)(((index - trigIndex + NUM_SAMPLES) % NUM_SAMPLES)/plotStride);
+  }
+
+/*
+Name: displayCursors
+Description: Draws the cursor overlay: the two (dashed) cursor lines and the delta readouts. This is its own layer on top of the traces and only
+reads the cursor positions and the record, so moving a cursor never re-extracts or re-maps the waveforms.
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayCursors(){
+    const uint16_t color = CURSOR_COLOR.val;
+    char text[24];
+
+    updateCursorReadouts();
+
+    if(cursorMode == CURSOR_TIME){
+      // Through recordColumn, so at interpolated timebases the cursors follow the trace's sub-sample start (trigPosition)
+      int columns[2] = {recordColumn((trigIndex + cursorT1) % NUM_SAMPLES), recordColumn((trigIndex + cursorT2) % NUM_SAMPLES)};
+      for(int c = 0; c < 2; c++){
+        if(columns[c] < 0 || columns[c] >= LX){
+          continue; // Cursor is outside the plotted window at this HScale
+        }
+        for(int row = 0; row < LY; row += 4){
+          fb[row*LX + columns[c]] = color;
+          fb[(row + 1)*LX + columns[c]] = color;
+        }
+      }
+
+      formatEngineering(text, sizeof(text), cursorDeltaT, "s");
+      oScopeImage.drawText("dT:", {100, 10}, MEAS_FONT, CURSOR_COLOR);
+      oScopeImage.drawText(text, {125, 10}, MEAS_FONT, CURSOR_COLOR);
+
+      oScopeImage.drawText("1/dT:", {100, 22}, MEAS_FONT, CURSOR_COLOR);
+      if(cursorDeltaT != 0){
+        formatEngineering(text, sizeof(text), 1.0/fabs(cursorDeltaT), "Hz");
+        oScopeImage.drawText(text, {125, 22}, MEAS_FONT, CURSOR_COLOR);
+      }
+    }
+
+    if(cursorMode == CURSOR_VOLT){
+      double VScale = (cursorChannel == 0) ? CH1_VScale : CH2_VScale;
+      int VPos = (cursorChannel == 0) ? CH1_VPos : CH2_VPos;
+      int rows[2] = {pixelRow(cursorV1, VScale, VPos + pixelLUTDCPixels[cursorChannel]),
+                     pixelRow(cursorV2, VScale, VPos + pixelLUTDCPixels[cursorChannel])};
+      for(int r = 0; r < 2; r++){
+        for(int column = 0; column < LX; column += 4){
+          fb[rows[r]*LX + column] = color;
+          fb[rows[r]*LX + column + 1] = color;
+        }
+      }
+    }
+
+    formatEngineering(text, sizeof(text), cursorDeltaV, "V");
+    oScopeImage.drawText((cursorChannel == 0) ? "dV1:" : "dV2:", {100, 34}, MEAS_FONT, CURSOR_COLOR);
+    oScopeImage.drawText(text, {125, 34}, MEAS_FONT, CURSOR_COLOR);
+  }
+
+
+/*
+Name: displayMaskOverlay
+Description: Draws the mask's band edges for each tested channel (through the same count -> pixel tables as the traces), the first failing column
+of a failed capture, and the pass/fail/total counters under the trigger voltage ("STOP" once stop-on-fail has halted acquisition).
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayMaskOverlay(){
+    const uint16_t color = MASK_COLOR.val;
+    char text[32];
+
+    for(int ch = 0; ch < NUM_CHANNELS; ch++){
+      if((maskData.channels & (1 << ch)) == 0){
+        continue;
+      }
+      const uint8_t* countToPixel = (ch == 0) ? countToPixel1 : countToPixel2;
+      for(int i = 0; i < LX; i++){
+        fb[countToPixel[maskData.low[ch][i]]*LX + i] = color;
+        fb[countToPixel[maskData.high[ch][i]]*LX + i] = color;
+      }
+    }
+
+    if(maskLastFailed){
+      const uint16_t failColor = MASK_FAIL_COLOR.val;
+      for(int row = 0; row < LY; row += 2){
+        fb[row*LX + maskFailColumn] = failColor;
+      }
+    }
+
+    if(hscaleStep(HScale) != maskData.hscaleStep){
+      oScopeImage.drawText("Mask HScale", {240, 55}, SCALE_FONT, MASK_FAIL_COLOR);
+      return;
+    }
+    snprintf(text, sizeof(text), "F%lu/%lu", (unsigned long)maskFailCount, (unsigned long)(maskPassCount + maskFailCount));
+    oScopeImage.drawText(text, {240, 55}, SCALE_FONT, maskLastFailed ? MASK_FAIL_COLOR : WHITE);
+    if(!acquisitionRunning){
+      oScopeImage.drawText("STOP", {295, 55}, SCALE_FONT, MASK_FAIL_COLOR);
+    }
+  }
+
+
+/*
+Name: displayRefs
+Description: Overlays every shown reference slot in its own color. A slot is re-mapped to screen rows only when the time per column or its
+channel's count -> pixel table has changed; otherwise drawing it is one framebuffer write per column, like a live trace.
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayRefs(){
+    for(int slot = 0; slot < REF_NUM_SLOTS; slot++){
+      RefSlot& ref = refSlots[slot];
+      if(!ref.valid || !ref.shown){
+        continue;
+      }
+      if(ref.mappedColumnTime != plotStride*sampleDt || ref.mappedLUTBuild != pixelLUTBuild[ref.channel]){
+        mapRefSlot(slot);
+      }
+
+      const uint16_t color = refColors[slot].val;
+      for(int i = 0; i < LX; i++){
+        if(ref.rows[i] != REF_NO_ROW){
+          fb[ref.rows[i]*LX + i] = color;
+        }
+      }
+    }
+  }
+
+
+/*
+Name: displayDecodeAnnotations
+Description: Draws the protocol decoder's results as an overlay: each decoded byte is a bracket over the samples it spans with its value in hex
+(I2C addresses as the 7-bit address and R/W, "?" marking a framing error or unfinished word, "N" a missing ACK), and I2C start/stop conditions are
+marked "S"/"P". Channel 1's annotations are drawn near the top of the screen and channel 2's near the bottom.
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayDecodeAnnotations(){
+    const uint16_t color = DECODE_COLOR.val;
+    const int rowY[2] = {52, 190};
+    char text[12];
+
+    for(int i = 0; i < decodeNumAnnotations; i++){
+      const DecodeAnnotation& annotation = decodeAnnotations[i];
+      int startColumn = recordColumn(annotation.start);
+      if(startColumn >= LX){
+        continue; // Outside the plotted window
+      }
+      int endColumn = startColumn + (int)((annotation.end - annotation.start)/plotStride);
+      bound(endColumn, startColumn, LX - 1);
+      int y = rowY[annotation.row];
+
+      if(annotation.flags & (ANNOT_START | ANNOT_STOP)){
+        for(int row = y - 10; row <= y + 2; row++){
+          fb[row*LX + startColumn] = color;
+        }
+        oScopeImage.drawText((annotation.flags & ANNOT_START) ? "S" : "P", {startColumn + 2, y}, MEAS_FONT, DECODE_COLOR);
+        continue;
+      }
+
+      for(int column = startColumn; column <= endColumn; column++){
+        fb[(y + 2)*LX + column] = color;
+      }
+      fb[(y + 1)*LX + startColumn] = color;
+      fb[(y + 1)*LX + endColumn] = color;
+
+      if(annotation.flags & ANNOT_ADDRESS){
+        snprintf(text, sizeof(text), "%02X%c", annotation.value >> 1, (annotation.value & 1) ? 'R' : 'W');
+      }else{
+        snprintf(text, sizeof(text), "%02X", annotation.value);
+      }
+      if(annotation.flags & ANNOT_ERROR){
+        strcat(text, "?");
+      }
+      if(annotation.flags & ANNOT_NACK){
+        strcat(text, "N");
+      }
+      oScopeImage.drawText(text, {startColumn + 1, y}, MEAS_FONT, DECODE_COLOR);
+    }
+  }
+
+
+/*
+Name: verifyPixelLUTs
+Description: Used for testing & debugging. Checks every entry of both count -> pixel tables at a range of VScale and position settings, DC and AC
+coupled, against the mapping worked out again in floating point: 120 - position + ((volts - mean)/VScale)*120, clipped to the screen, where the
+mean (AC coupling only) is the record's own (offset1/offset2) rather than the DC level the table was built with. The table removes the DC
+level in whole pixels and lets it lag by up to AC_REBUILD_HYSTERESIS, so an AC coupled entry passes within 1 pixel; DC coupled entries must match
+exactly. The channel settings and the tables are restored afterwards.
+Returns: bool (true if every entry matched)
+Parameters: None
+*/
+  bool verifyPixelLUTs(){
+    const double testScales[] = {0.1, 0.5, 1.0, 2.5, 5.0, 10.0, 13.7, 20.0};
+    const int testPositions[] = {-MAX_VPOS, -37, 0, 50, MAX_VPOS};
+    double savedVScale1 = CH1_VScale;
+    double savedVScale2 = CH2_VScale;
+    int savedVPos1 = CH1_VPos;
+    int savedVPos2 = CH2_VPos;
+    bool savedAC1 = CH1_AC;
+    bool savedAC2 = CH2_AC;
+    int mismatches = 0;
+
+    for(int ac = 0; ac < 2; ac++){
+      for(unsigned s = 0; s < sizeof(testScales)/sizeof(testScales[0]); s++){
+        for(unsigned p = 0; p < sizeof(testPositions)/sizeof(testPositions[0]); p++){
+          CH1_VScale = testScales[s];
+          CH2_VScale = testScales[s];
+          CH1_VPos = testPositions[p];
+          CH2_VPos = -testPositions[p];
+          CH1_AC = (ac == 1);
+          CH2_AC = (ac == 1);
+          updatePixelLUTs();
+
+          for(int ch = 0; ch < NUM_CHANNELS; ch++){
+            const uint8_t* lut = (ch == 0) ? countToPixel1 : countToPixel2;
+            const float* volts = (ch == 0) ? countToVolts1 : countToVolts2;
+            double chVScale = (ch == 0) ? CH1_VScale : CH2_VScale;
+            int chVPos = (ch == 0) ? CH1_VPos : CH2_VPos;
+            double mean = (ac == 1) ? ((ch == 0) ? offset1 : offset2) : 0;
+            int tolerance = (ac == 1) ? 1 : 0; // Only the AC table's DC level is rounded and lags
+
+            for(int count = 0; count <= PROC_MAX_CODE; count++){
+              double exact = (LY/2) - chVPos + ((volts[count] - mean)/chVScale)*(LY/2);
+              bound(exact, 0, LY - 1);
+              int expected = (int)floor(exact);
+              if(abs(lut[count] - expected) > tolerance){
+                mismatches++;
+                Serial.print("Mismatch @ CH");
+                Serial.print(ch + 1);
+                Serial.print(ac ? " AC" : " DC");
+                Serial.print(", VScale ");
+                Serial.print(testScales[s]);
+                Serial.print(", VPos ");
+                Serial.print(chVPos);
+                Serial.print(", count ");
+                Serial.print(count);
+                Serial.print(": ");
+                Serial.print(lut[count]);
+                Serial.print(" vs ");
+                Serial.println(expected);
+              }
+            }
+          }
+        }
+      }
+    }
+
+    CH1_VScale = savedVScale1;
+    CH2_VScale = savedVScale2;
+    CH1_VPos = savedVPos1;
+    CH2_VPos = savedVPos2;
+    CH1_AC = savedAC1;
+    CH2_AC = savedAC2;
+    updatePixelLUTs();
+
+    Serial.print("Pixel LUT check: ");
+    Serial.println(mismatches == 0 ? "PASS" : "FAIL");
+    return mismatches == 0;
+  }
+
+
+/*
+Name: benchmarkPixelMapping
+Description: Used for testing & debugging. Times mapping one channel's 320 plotted points to screen rows with the floating point formula versus
+the count -> pixel table, plus a full table rebuild, using the Cortex-M7 cycle counter. Results are printed in CPU cycles.
+Returns: Nothing
+Parameters: None
+*/
+  void benchmarkPixelMapping(){
+    const int runs = 100;
+    volatile int sink = 0;
+    uint32_t start;
+
+    updatePixelLUTs();
+
+    start = ARM_DWT_CYCCNT;
+    for(int r = 0; r < runs; r++){
+      for(int i = 0; i < LX; i++){
+        sink += (int)((LY/2) - CH1_VPos + ((sig1Data[i] - offset1)/CH1_VScale)*120);
+      }
+    }
+    uint32_t floatCycles = (ARM_DWT_CYCCNT - start)/runs;
+
+    start = ARM_DWT_CYCCNT;
+    for(int r = 0; r < runs; r++){
+      for(int i = 0; i < LX; i++){
+        sink += countToPixel1[sigRaw[0][i]];
+      }
+    }
+    uint32_t lutCycles = (ARM_DWT_CYCCNT - start)/runs;
+
+    start = ARM_DWT_CYCCNT;
+    pixelLUTVScale[0] = -1; // Force a rebuild
+    updatePixelLUT(0);
+    uint32_t rebuildCycles = ARM_DWT_CYCCNT - start;
+
+    Serial.print("Float mapping (cycles/frame): ");
+    Serial.println(floatCycles);
+    Serial.print("LUT mapping (cycles/frame):   ");
+    Serial.println(lutCycles);
+    Serial.print("LUT rebuild (cycles):         ");
+    Serial.println(rebuildCycles);
+  }
+
+
+/*
+Name: displayTriggerSelect
+Description: Displays the moscilloscope menu's "trigger select" option: the trigger level, source, type, upper level, times and hysteresis
+(encoder 1 moves the ">" marker, encoder 2 changes the marked entry; autoset, which encoder 2's button runs, also sets the hysteresis)
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayTriggerSelect(){
+    char text[24];
+
+    oScopeImage.fillThickRect({110, 210, 0, 175}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
+
+    // On-screen positions are hard-coded here for our given display arrangement
+    oScopeImage.drawText(">", {114, 20 + 20*triggerMenuItem}, CHANGE_VALUE_FONT, WHITE);
+    snprintf(text, sizeof(text), "Trig: %.2fV", triggerVoltage);
+    oScopeImage.drawText(text, {124, 20}, CHANGE_VALUE_FONT, WHITE);
+    snprintf(text, sizeof(text), "Src: %s", triggerSourceNames[triggerSource]);
+    oScopeImage.drawText(text, {124, 40}, CHANGE_VALUE_FONT, WHITE);
+    oScopeImage.drawText(triggerTypeNames[triggerType], {124, 60}, CHANGE_VALUE_FONT, WHITE);
+    snprintf(text, sizeof(text), "Upr: %.2fV", triggerUpper);
+    oScopeImage.drawText(text, {124, 80}, CHANGE_VALUE_FONT, WHITE);
+    snprintf(text, sizeof(text), "T1: %.1fus", triggerTime1*1E6);
+    oScopeImage.drawText(text, {124, 100}, CHANGE_VALUE_FONT, WHITE);
+    snprintf(text, sizeof(text), "T2: %.1fus", triggerTime2*1E6);
+    oScopeImage.drawText(text, {124, 120}, CHANGE_VALUE_FONT, WHITE);
+
+    snprintf(text, sizeof(text), "Hyst: %.2fV", triggerHysteresis);
+    oScopeImage.drawText(text, {124, 140}, CHANGE_VALUE_FONT, WHITE);
+
+    oScopeImage.drawText(acquisitionRunning ? "Press: Autoset" : "Autoset: Run first", {116, 162}, MENU_FONT, WHITE);
+  }
+
+  /*
+Name: displayScalingSelect
+Description: Displays the moscilloscope menu's "scaling select" option for changing the horizontal and vertical scale values
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayScalingSelect(){
+    oScopeImage.fillThickRect({110, 210, 0, 65}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
+
+    oScopeImage.drawText("Horz: ", {114, 25}, CHANGE_VALUE_FONT, WHITE);
+    oScopeImage.drawText(doubleToCharArr(HScale*1000000.0), {165, 25}, CHANGE_VALUE_FONT, WHITE);
+  
+    // On-screen positions are hard-coded here for our given display arrangement. The vertical scale shown (and adjusted) is scaleChannel's.
+    if(scaleChannel == 0){
+      oScopeImage.drawText("Vert1: ", {114, 50}, CHANGE_VALUE_FONT, CH1_COLOR);
+      oScopeImage.drawText(doubleToCharArr(CH1_VScale), {165, 50}, CHANGE_VALUE_FONT, CH1_COLOR);
+    }else{
+      oScopeImage.drawText("Vert2: ", {114, 50}, CHANGE_VALUE_FONT, CH2_COLOR);
+      oScopeImage.drawText(doubleToCharArr(CH2_VScale), {165, 50}, CHANGE_VALUE_FONT, CH2_COLOR);
+    }
+  }
+
+/*
+Name: displayMathSelect
+Description: Displays the moscilloscope menu's "math select" option for choosing the math channel's operation (encoder 2) and scale (encoder 1)
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayMathSelect(){
+    oScopeImage.fillThickRect({110, 210, 0, 65}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
+
+    // On-screen positions are hard-coded here for our given display arrangement
+    oScopeImage.drawText("Math: ", {114, 25}, CHANGE_VALUE_FONT, MATH_COLOR);
+    oScopeImage.drawText(mathOpName(), {165, 25}, CHANGE_VALUE_FONT, MATH_COLOR);
+    oScopeImage.drawText("Vert: ", {114, 50}, CHANGE_VALUE_FONT, MATH_COLOR);
+    oScopeImage.drawText(doubleToCharArr(mathVScale), {165, 50}, CHANGE_VALUE_FONT, MATH_COLOR);
+  }
+
+/*
+Name: displayCursorSelect
+Description: Displays the moscilloscope menu's "cursor select" option for choosing the cursor mode (encoder 2's button) and the channel the
+voltage readouts come from (encoder 1)
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayCursorSelect(){
+    const char* modes[CURSOR_NUM_MODES] = {"OFF", "Time", "Volt"};
+
+    oScopeImage.fillThickRect({110, 210, 0, 65}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
+
+    // On-screen positions are hard-coded here for our given display arrangement
+    oScopeImage.drawText("Curs: ", {114, 25}, CHANGE_VALUE_FONT, CURSOR_COLOR);
+    oScopeImage.drawText(modes[cursorMode], {165, 25}, CHANGE_VALUE_FONT, CURSOR_COLOR);
+    oScopeImage.drawText("Chan: ", {114, 50}, CHANGE_VALUE_FONT, CURSOR_COLOR);
+    oScopeImage.drawText((cursorChannel == 0) ? "CH1" : "CH2", {165, 50}, CHANGE_VALUE_FONT, CURSOR_COLOR);
+  }
+
+/*
+Name: processingName
+Description: Short name of the acquisition processing mode for the display
+Returns: const char* (name)
+Parameters: None
+*/
+  const char* processingName(){
+    switch(procMode){
+      case PROC_AVG_EXP:   return "AvgExp";
+      case PROC_AVG_BLOCK: return "AvgBlk";
+      case PROC_HIRES:     return "HiRes";
+    }
+    return "Normal";
+  }
+
+/*
+Name: displayAcquireSelect
+Description: Displays the moscilloscope menu's "acquire select" option for choosing the processing mode (encoder 2's button) and the number of
+acquisitions/samples averaged (encoder 1), along with the resulting effective resolution
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayAcquireSelect(){
+    char text[16];
+
+    oScopeImage.fillThickRect({110, 210, 0, 90}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
+
+    // On-screen positions are hard-coded here for our given display arrangement
+    oScopeImage.drawText("Mode: ", {114, 25}, CHANGE_VALUE_FONT, WHITE);
+    oScopeImage.drawText(processingName(), {160, 25}, CHANGE_VALUE_FONT, WHITE);
+    oScopeImage.drawText("N: ", {114, 50}, CHANGE_VALUE_FONT, WHITE);
+    oScopeImage.drawText(intToCharArr(1 << avgLog2), {160, 50}, CHANGE_VALUE_FONT, WHITE);
+    snprintf(text, sizeof(text), "%.1f", effectiveBits(procMode, avgLog2));
+    oScopeImage.drawText("Bits: ", {114, 75}, CHANGE_VALUE_FONT, WHITE);
+    oScopeImage.drawText(text, {160, 75}, CHANGE_VALUE_FONT, WHITE);
+  }
+
+/*
+Name: displayProcessingTag
+Description: When averaging or high-res is on, shows the mode and count under the trigger voltage (e.g. "AvgExp 16")
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayProcessingTag(){
+    if(procMode == PROC_NORMAL){
+      return;
+    }
+    oScopeImage.drawText(processingName(), {240, 40}, SCALE_FONT, WHITE);
+    oScopeImage.drawText(intToCharArr(1 << avgLog2), {285, 40}, SCALE_FONT, WHITE);
+  }
+
+/*
+Name: displayDecodeSelect
+Description: Displays the moscilloscope menu's "decode select" option for choosing the bus protocol (encoder 2's button), the UART baud rate
+(encoder 1) and the logic threshold (encoder 2)
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayDecodeSelect(){
+    char text[16];
+
+    oScopeImage.fillThickRect({110, 210, 0, 90}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
+
+    // On-screen positions are hard-coded here for our given display arrangement
+    oScopeImage.drawText("Bus: ", {114, 25}, CHANGE_VALUE_FONT, WHITE);
+    oScopeImage.drawText(decodeProtocolNames[decodeProtocol], {160, 25}, CHANGE_VALUE_FONT, WHITE);
+    oScopeImage.drawText("Baud: ", {114, 50}, CHANGE_VALUE_FONT, WHITE);
+    snprintf(text, sizeof(text), "%ld", decodeBaudRates[decodeBaudIndex]);
+    oScopeImage.drawText(text, {160, 50}, CHANGE_VALUE_FONT, WHITE);
+    oScopeImage.drawText("Thr: ", {114, 75}, CHANGE_VALUE_FONT, WHITE);
+    snprintf(text, sizeof(text), "%.2fV", decodeThreshold);
+    oScopeImage.drawText(text, {160, 75}, CHANGE_VALUE_FONT, WHITE);
+  }
+
+/*
+Name: displayMaskSelect
+Description: Displays the moscilloscope menu's "mask select" option: the mask entries (encoder 2 moves the ">" marker, its button acts on the
+marked entry) and the tolerance used for new masks (encoder 1)
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayMaskSelect(){
+    char text[32]; // Room for both counters at their longest (10 digits each)
+
+    oScopeImage.fillThickRect({110, 210, 0, 115}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
+
+    // On-screen positions are hard-coded here for our given display arrangement
+    oScopeImage.drawText(">", {114, 20 + 20*maskMenuItem}, CHANGE_VALUE_FONT, WHITE);
+    oScopeImage.drawText("Test: ", {124, 20}, CHANGE_VALUE_FONT, WHITE);
+    oScopeImage.drawText(maskTesting ? "ON" : "OFF", {175, 20}, CHANGE_VALUE_FONT, WHITE);
+    oScopeImage.drawText("Stop: ", {124, 40}, CHANGE_VALUE_FONT, WHITE);
+    oScopeImage.drawText(maskStopOnFail ? "ON" : "OFF", {175, 40}, CHANGE_VALUE_FONT, WHITE);
+    oScopeImage.drawText(maskValid ? "Remake" : "Make", {124, 60}, CHANGE_VALUE_FONT, WHITE);
+    snprintf(text, sizeof(text), "Reset %lu/%lu", (unsigned long)maskFailCount, (unsigned long)(maskPassCount + maskFailCount));
+    oScopeImage.drawText(text, {124, 80}, CHANGE_VALUE_FONT, WHITE);
+    snprintf(text, sizeof(text), "Tol: %.2fV", maskTolerance);
+    oScopeImage.drawText(text, {124, 105}, CHANGE_VALUE_FONT, WHITE);
+  }
+
+/*
+Name: displayRefSelect
+Description: Displays the moscilloscope menu's "reference select" option: the slot (encoder 1) and what it holds, and the action encoder 2's
+button will run on it (encoder 2)
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayRefSelect(){
+    const char* actionNames[REF_NUM_ACTIONS] = {"Save CH1", "Save CH2", "Show/Hide", "Clear", "To EEPROM", "From EEPROM", "To SD", "From SD"};
+    const RefSlot& ref = refSlots[refSlot];
+    char text[24];
+
+    oScopeImage.fillThickRect({110, 210, 0, 90}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
+
+    // On-screen positions are hard-coded here for our given display arrangement
+    oScopeImage.drawText("Slot: ", {114, 25}, CHANGE_VALUE_FONT, WHITE);
+    oScopeImage.drawText(intToCharArr(refSlot + 1), {160, 25}, CHANGE_VALUE_FONT, refColors[refSlot]);
+    if(ref.valid){
+      snprintf(text, sizeof(text), "CH%d %s", ref.channel + 1, ref.shown ? "shown" : "hidden");
+    }else{
+      snprintf(text, sizeof(text), "empty");
+    }
+    oScopeImage.drawText(text, {114, 50}, CHANGE_VALUE_FONT, WHITE);
+    oScopeImage.drawText(actionNames[refAction], {114, 75}, CHANGE_VALUE_FONT, WHITE);
+  }
+
+/*
+Name: displayDisplaySelect
+Description: Displays the moscilloscope menu's "display select" option for stepping through the YT (voltage vs time), XY and zoom displays
+(encoder 2's button), the interpolation used at timebases shorter than the sample rate (encoder 1), and whether the encoders pan and zoom the
+zoom window once the menu is closed (encoder 2)
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayDisplaySelect(){
+    oScopeImage.fillThickRect({110, 210, 0, 90}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
+
+    oScopeImage.drawText("Mode: ", {114, 25}, CHANGE_VALUE_FONT, WHITE); 
+    oScopeImage.drawText(displayModeNames[displayMode], {175, 25}, CHANGE_VALUE_FONT, WHITE); 
+    oScopeImage.drawText("Intp: ", {114, 50}, CHANGE_VALUE_FONT, WHITE);
+    oScopeImage.drawText(interpModeNames[interpMode], {155, 50}, CHANGE_VALUE_FONT, WHITE);
+    oScopeImage.drawText("Knobs: ", {114, 75}, CHANGE_VALUE_FONT, WHITE);
+    oScopeImage.drawText(zoomEncoders ? "Zoom" : "Menu", {165, 75}, CHANGE_VALUE_FONT, WHITE);
+  }
+
+/*
+Name: displayPositionSelect
+Description: Displays the moscilloscope menu's "position select" option for moving each channel's trace up and down (encoder 1 moves channel
+one, encoder 2 moves channel two)
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayPositionSelect(){
+    oScopeImage.fillThickRect({110, 210, 0, 65}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
+
+    // On-screen positions are hard-coded here for our given display arrangement
+    oScopeImage.drawText("Pos1: ", {114, 25}, CHANGE_VALUE_FONT, CH1_COLOR);
+    oScopeImage.drawText(intToCharArr(CH1_VPos), {165, 25}, CHANGE_VALUE_FONT, CH1_COLOR);
+    oScopeImage.drawText("Pos2: ", {114, 50}, CHANGE_VALUE_FONT, CH2_COLOR);
+    oScopeImage.drawText(intToCharArr(CH2_VPos), {165, 50}, CHANGE_VALUE_FONT, CH2_COLOR);
+  }
+
+/*
+Name: displayWave1Select
+Description: Displays the moscilloscope menu's "wave 1 select" option for turning on/off channel one's waveform plot
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayWave1Select(){
+    oScopeImage.fillThickRect({110, 210, 0, 40}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
+
+    oScopeImage.drawText("Wave 1: ", {114, 25}, CHANGE_VALUE_FONT, WHITE); 
+    if(showWave1 == true){
+      oScopeImage.drawText("ON", {175, 25}, CHANGE_VALUE_FONT, WHITE); 
+    }else{
+      oScopeImage.drawText("OFF", {175, 25}, CHANGE_VALUE_FONT, WHITE); 
+    }
+  }
+
+  /*
+Name: displayWave2Select
+Description: Displays the moscilloscope menu's "wave 2 select" option for turning on/off channel two's waveform plot
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayWave2Select(){
+    oScopeImage.fillThickRect({110, 210, 0, 40}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
+
+    oScopeImage.drawText("Wave 2: ", {114, 25}, CHANGE_VALUE_FONT, WHITE); 
+    if(showWave2 == true){
+      oScopeImage.drawText("ON", {175, 25}, CHANGE_VALUE_FONT, WHITE); 
+    }else{
+      oScopeImage.drawText("OFF", {175, 25}, CHANGE_VALUE_FONT, WHITE); 
+    }
+  }
+
+
+/*
+Name: displayMeas1Select
+Description: Displays the moscilloscope menu's "measurements 1 select" option for turning on/off channel one's measurements display
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayMeas1Select(){
+    oScopeImage.fillThickRect({110, 210, 0, 40}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
+
+    oScopeImage.drawText("Meas 1: ", {114, 25}, CHANGE_VALUE_FONT, WHITE); 
+    if(showMeas1 == true){
+      oScopeImage.drawText("ON", {175, 25}, CHANGE_VALUE_FONT, WHITE); 
+    }else{
+      oScopeImage.drawText("OFF", {175, 25}, CHANGE_VALUE_FONT, WHITE); 
+    }
+  }
+
+  /*
+Name: displayMeas2Select
+Description: Displays the moscilloscope menu's "measurements 2 select" option for turning on/off channel two's measurements display
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayMeas2Select(){
+    oScopeImage.fillThickRect({110, 210, 0, 40}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
+
+    oScopeImage.drawText("Meas 2: ", {114, 25}, CHANGE_VALUE_FONT, WHITE); 
+    if(showMeas2 == true){
+      oScopeImage.drawText("ON", {175, 25}, CHANGE_VALUE_FONT, WHITE); 
+    }else{
+      oScopeImage.drawText("OFF", {175, 25}, CHANGE_VALUE_FONT, WHITE); 
+    }
+  }
+
+
+/*
+Name: displayCoupling1Select
+Description: Displays the moscilloscope menu's "CH1 coupling" option for switching channel one between DC and (emulated) AC coupling
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayCoupling1Select(){
+    oScopeImage.fillThickRect({110, 210, 0, 40}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
+
+    oScopeImage.drawText("CH1: ", {114, 25}, CHANGE_VALUE_FONT, WHITE); 
+    if(CH1_AC == true){
+      oScopeImage.drawText("AC", {175, 25}, CHANGE_VALUE_FONT, WHITE); 
+    }else{
+      oScopeImage.drawText("DC", {175, 25}, CHANGE_VALUE_FONT, WHITE); 
+    }
+  }
+
+/*
+Name: displayCoupling2Select
+Description: Displays the moscilloscope menu's "CH2 coupling" option for switching channel two between DC and (emulated) AC coupling
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayCoupling2Select(){
+    oScopeImage.fillThickRect({110, 210, 0, 40}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
+
+    oScopeImage.drawText("CH2: ", {114, 25}, CHANGE_VALUE_FONT, WHITE); 
+    if(CH2_AC == true){
+      oScopeImage.drawText("AC", {175, 25}, CHANGE_VALUE_FONT, WHITE); 
+    }else{
+      oScopeImage.drawText("DC", {175, 25}, CHANGE_VALUE_FONT, WHITE); 
+    }
+  }
+
+
+/*
+Name: displayStatsSelect
+Description: Displays the moscilloscope menu's "measurement statistics" option for switching the measurements between the latest value and
+their running mean +/- standard deviation
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayStatsSelect(){
+    oScopeImage.fillThickRect({110, 210, 0, 40}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
+
+    oScopeImage.drawText("Stats: ", {114, 25}, CHANGE_VALUE_FONT, WHITE); 
+    if(showStats == true){
+      oScopeImage.drawText("ON", {175, 25}, CHANGE_VALUE_FONT, WHITE); 
+    }else{
+      oScopeImage.drawText("OFF", {175, 25}, CHANGE_VALUE_FONT, WHITE); 
+    }
+  }
+
+/*
+Name: displayStatsResetSelect
+Description: Displays the moscilloscope menu's "reset statistics" option (encoder 2's button clears them), with the number of acquisitions
+accumulated so far
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayStatsResetSelect(){
+    oScopeImage.fillThickRect({110, 210, 0, 40}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
+
+    oScopeImage.drawText("Count: ", {114, 25}, CHANGE_VALUE_FONT, WHITE); 
+    oScopeImage.drawText(intToCharArr(measStats[STAT_CH1_P2P].count > measStats[STAT_CH2_P2P].count ?
+                                      measStats[STAT_CH1_P2P].count : measStats[STAT_CH2_P2P].count), {165, 25}, CHANGE_VALUE_FONT, WHITE); 
+  }
+
+
+/*
+Name: displayFreqCounterSelect
+Description: Displays the moscilloscope menu's "frequency counter" option for turning the hardware frequency counter (on FREQ_PIN) on/off
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayFreqCounterSelect(){
+    oScopeImage.fillThickRect({110, 210, 0, 40}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
+
+    oScopeImage.drawText("Counter: ", {114, 25}, CHANGE_VALUE_FONT, WHITE); 
+    if(freqCounterOn == true){
+      oScopeImage.drawText("ON", {175, 25}, CHANGE_VALUE_FONT, WHITE); 
+    }else{
+      oScopeImage.drawText("OFF", {175, 25}, CHANGE_VALUE_FONT, WHITE); 
+    }
+  }
+
+
+/*
+Name: menuBottom
+Description: Bottom of a menu box that starts at y = 30. The box is 160 pixels tall, growing (17 pixels per option) for menus with too many
+options to fit their 15 pixel tall boxes in that.
+Returns: int (y coordinate of the bottom of the menu box)
+Parameters: int "numOptions"
+*/
+  int menuBottom(int numOptions){
+    int height = 17*numOptions;
+    return 30 + ((height > 160) ? height : 160);
+  }
+
+/*
+Name: menuOptionY
+Description: Spreads a menu's options evenly down the menu box (30 to menuBottom), and returns the top of a given option's (15 pixel tall) box
+Returns: int (y coordinate of the top of the option's box)
+Parameters: int "option" (1 to numOptions), int "numOptions"
+*/
+  int menuOptionY(int option, int numOptions){
+    int spacing = (menuBottom(numOptions) - 30)/numOptions;
+    return 30 + (option - 1)*spacing + (spacing - 15)/2;
+  }
+
+/*
+Name: displayMenuSelector
+Description: Displays which menu option the user is currently selected to by displaying a red box around their selection
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayMenuSelector(){
+    // Make the following rectangle's coordinates dependent on the menu-selecting variable
+    if(menuSelecting == 0){
+      oScopeImage.drawRect({25, 93, 30, menuBottom(MAIN_MENU_OPTIONS)}, tgx::RGB32_Red);
+
+    }else{
+      int y = menuOptionY(menuSelecting, MAIN_MENU_OPTIONS);
+      oScopeImage.drawRect({32, 86, y, y + 15}, tgx::RGB32_Red);
+    }
+  }
 
-  for(int i = 0; i < 320; i++){
+/*
+Name: displayChannelsSelector
+Description: Displays which channel menu (menu >> channels) the user is currently selecting by displaying a red box around their selection
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayChannelsSelector(){
+    // Make the following rectangle's coordinates dependent on the channels-selecting variable
+    if(chDataSelecting == 0){
+      oScopeImage.drawRect({99, 178, 30, menuBottom(CH_MENU_OPTIONS)}, tgx::RGB32_Red);
 
-    if(strideIndex >= NUM_SAMPLES){
-      Serial.println("Attempt to index past data array! - Stopped");
-      strideIndex = NUM_SAMPLES - 1;
-      break;
+    }else{
+      int y = menuOptionY(chDataSelecting, CH_MENU_OPTIONS);
+      oScopeImage.drawRect({102, 175, y, y + 15}, tgx::RGB32_Red);
     }
+  }
 
-    sig1Data[i] = voltageData1[(sig1TrigIndex + (int)(strideIndex))%NUM_SAMPLES];
-    sig2Data[i] = voltageData2[(sig2TrigIndex + (int)(strideIndex))%NUM_SAMPLES];
+/*
+Name: displayChannelsBlock 
+Description: Displays the channels menu block with its options (show wave 1, wave 2, meas 1, meas 2, CH1/CH2 coupling, statistics on/off and reset, frequency counter). Calls the selector display function as well.
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayChannelsBlock(){
+    const char* options[CH_MENU_OPTIONS] = {"Show Wave 1", "Show Wave 2", "Show Meas 1", "Show Meas 2", "CH1 Coupling", "CH2 Coupling",
+                                              "Meas Stats", "Reset Stats", "Freq Counter"};
 
-    strideIndex += stride;
-    
+    oScopeImage.fillThickRect({99, 178, 30, menuBottom(CH_MENU_OPTIONS)}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1); // gray filled, 2 pixels thick red rectangle, 0% opacity (main menu box)
+    for(int option = 1; option <= CH_MENU_OPTIONS; option++){
+      int y = menuOptionY(option, CH_MENU_OPTIONS);
+      oScopeImage.fillThickRect({102, 175, y, y + 15}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
+    }
+
+    displayChannelsSelector();
+
+    /* Text of each option....*/
+    for(int option = 1; option <= CH_MENU_OPTIONS; option++){
+      oScopeImage.drawText(options[option - 1], {105, menuOptionY(option, CH_MENU_OPTIONS) + 12}, MENU_FONT, MENU_COLOR);
+    }
   }
-}
+
 
 /*
-Name: printRawChannelData
-Description: Used for testing & debugging. Prints out the first 20 values of the NUM_SAMPLES-long "rawData" arrays (both channels)
-Returns: Nothing
+Name: displayMenuBlock
+Description: Displays the main menu's block of options (Channels, Trigger, Scaling, Position, Math, Display, Cursors, Acquire, Decode, Mask and Refs). Calls the menu selector display function as well.
+Returns: Nothing (shows on display)
 Parameters: None
 */
-void printRawChannelData(){
-  Serial.println("Channel 1 Data (first 20 values):");
-  Serial.print("[");
-  for(int i = 0; i < 20; i++){
-    Serial.print(rawData1[i]);
-    if(i == NUM_SAMPLES - 1){
-      Serial.println("]");
-    }else{
-      Serial.print(", ");
+  void displayMenuBlock(){
+    // Switch case needs to happen first to ensure that lower-level selections don't have the menu shown in frame
+    const char* options[MAIN_MENU_OPTIONS] = {"Channels", "Trigger", "Scaling", "Position", "Math", "Display", "Cursors", "Acquire",
+                                                "Decode", "Mask", "Refs"};
+    
+    oScopeImage.fillThickRect({25, 93, 30, menuBottom(MAIN_MENU_OPTIONS)}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1); // gray filled, 2 pixels thick red rectangle, 0% opacity (main menu box)
+    for(int option = 1; option <= MAIN_MENU_OPTIONS; option++){
+      int y = menuOptionY(option, MAIN_MENU_OPTIONS);
+      oScopeImage.fillThickRect({32, 86, y, y + 15}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
     }
-  }
-  
-  Serial.println("Channel 2 Data (first 20 values):");
-  Serial.print("[");
-  for(int i = 0; i < 20; i++){
-    Serial.print(rawData2[i]);
-    if(i == 19){
-      Serial.println("]");
-    }else{
-      Serial.print(", ");
+
+    displayMenuSelector();
+
+    /* Text of each option....*/
+    for(int option = 1; option <= MAIN_MENU_OPTIONS; option++){
+      oScopeImage.drawText(options[option - 1], {37, menuOptionY(option, MAIN_MENU_OPTIONS) + 12}, MENU_FONT, MENU_COLOR);
     }
   }
-}
 
 
 /*
-Name: printPlottingData
-Description: Used for testing & debugging. Prints out all 320 values of the "plotting data" arrays (both channels).
-Returns: Nothing
+Name: displayMenu
+Description: The main menu-displaying function. Uses a switchcase that is based on the global menu-selecting variables to display which option the
+user is selected on, as well any necessary information related to that option.
+Returns: Nothing (shows on display)
 Parameters: None
 */
-void printPlottingData(){
-  Serial.println("Channel One Plotting Data -----------");
-    Serial.print("[");
-    for(int i = 0; i < 320; i++){
-      Serial.print(sig1Data[i]);
-      if(i == 319){
-        Serial.println("]");
-      }else{
-        Serial.print(", ");
+  void displayMenu(){
+    if(menuSelected > 0){
+      //switch case of channels, scaling, and trigger
+      switch(menuSelected){
+        case 1: //Channels
+          if(chDataSelected > 0){
+            switch(chDataSelected){
+              case 1:
+                displayWave1Select();
+              break;
+
+              case 2:
+                displayWave2Select();
+              break;
+
+              case 3:
+                displayMeas1Select();
+              break;
+
+              case 4:
+                displayMeas2Select();
+              break;
+
+              case 5:
+                displayCoupling1Select();
+              break;
+
+              case 6:
+                displayCoupling2Select();
+              break;
+
+              case 7:
+                displayStatsSelect();
+              break;
+
+              case 8:
+                displayStatsResetSelect();
+              break;
+
+              case 9:
+                displayFreqCounterSelect();
+              break;
+            }
+          }else{
+            displayMenuBlock();
+            displayChannelsBlock();
+          }
+        break;
+
+        case 2: // Trigger Voltage Selection
+          displayTriggerSelect();
+        break;
+
+        case 3:
+          displayScalingSelect();
+        break;
+
+        case 4:
+          displayPositionSelect();
+        break;
+
+        case 5:
+          displayMathSelect();
+        break;
+
+        case 6:
+          displayDisplaySelect();
+        break;
+
+        case 7:
+          displayCursorSelect();
+        break;
+
+        case 8:
+          displayAcquireSelect();
+        break;
+
+        case 9:
+          displayDecodeSelect();
+        break;
+
+        case 10:
+          displayMaskSelect();
+        break;
+
+        case 11:
+          displayRefSelect();
+        break;
       }
+      
+    }else{
+      displayMenuBlock();
     }
+  }
 
-    Serial.println("Channel Two Plotting Data -----------");
-    Serial.print("[");
-    for(int i = 0; i < 320; i++){
-      Serial.print(sig2Data[i]);
-      if(i == 319){
-        Serial.println("]");
-      }else{
-        Serial.print(", ");
-      }
+
+/*
+Name: displayChannels
+Description: Depending on the boolean value of the global variables for channel 1 & 2, calls/doesn't call the functions for displaying
+the waveforms and measurements of each channel. In XY mode the waveforms have already been drawn by displayXY(), so only the measurements are;
+in the zoom view they are drawn as its two panes.
+Returns: Nothing (shows on display)
+Parameters: None
+*/
+  void displayChannels(){
+    updatePixelLUTs();
+
+    if(showMeas1){
+      displayMeas(0);
+    }
+    if(showMeas2){
+      displayMeas(1);
+    }
+    if(displayMode == DISPLAY_XY){
+      return;
+    }
+    if(displayMode == DISPLAY_ZOOM){
+      displayZoom();
+      return;
     }
+    if(showWave1){
+      displaySignal(0);
+    }
+    if(showWave2){
+      displaySignal(1);
+    }
+    if(mathOp != MATH_OFF){
+      displayMathSignal();
+    }
+  }
+
+
+  void displayUIStates(){
+    button1.update();
+    button2.update();
+    button3.update();
+    button4.update();
+
+    oScopeImage.drawText("E1: ", {170, 100}, SCALE_FONT, WHITE);
+    oScopeImage.drawText(doubleToCharArr(encoder1.read()), {200, 100}, SCALE_FONT, WHITE);
+
+    oScopeImage.drawText("E2: ", {170, 120}, SCALE_FONT, WHITE);
+    oScopeImage.drawText(doubleToCharArr(encoder2.read()), {200, 120}, SCALE_FONT, WHITE);
+
+    oScopeImage.drawText("B1: ", {170, 140}, SCALE_FONT, WHITE);
+    oScopeImage.drawText(intToCharArr(button1.fell()), {200, 140}, SCALE_FONT, WHITE);
+
+     oScopeImage.drawText("B2: ", {170, 160}, SCALE_FONT, WHITE);
+    oScopeImage.drawText(intToCharArr(button2.fell()), {200, 160}, SCALE_FONT, WHITE);
+
+     oScopeImage.drawText("B3: ", {170, 180}, SCALE_FONT, WHITE);
+    oScopeImage.drawText(intToCharArr(button3.fell()), {200, 180}, SCALE_FONT, WHITE);
+
+     oScopeImage.drawText("B4: ", {170, 200}, SCALE_FONT, WHITE);
+    oScopeImage.drawText(intToCharArr(button4.fell()), {200, 200}, SCALE_FONT, WHITE);
+
 }
 
+/*
+Name: renderFrame
+Description: Draws a whole frame into the framebuffer from the current plotting data: waveforms, measurements, overlays and the menu. Sending
+it to the display (tft.update) is left to the caller, so frames can also be rendered off-screen (see benchmarkReplay).
+Returns: Nothing (draws into fb)
+Parameters: None
+*/
+void renderFrame(){
+  oScopeImage.clear(tgx::RGB32_Black); //Clear the image
 
-void updateOffsets(){
-  double sum1 = 0;
-  double sum2 = 0;
-  for(int i = 0; i < NUM_SAMPLES; i++){
-    sum1 += voltageData1[i];
-    sum2 += voltageData2[i];
+  // The XY display accumulates intensity in the framebuffer, so it goes onto the cleared image before anything else is drawn
+  if(displayMode == DISPLAY_XY){
+    updatePixelLUTs();
+    displayXY();
   }
+  
+    
+  // Display the basic moscilloscope components
+  drawAxes();
+  displayChannelMarkers();
+  displayTriggerVoltage();
+  displayVScale();
+  displayHScale();
+  displayRunState();
+  displayProcessingTag();
+  displayChannels();
 
-  offset1 = (sum1*1.0) / NUM_SAMPLES;
-  offset2 = (sum2*1.0) / NUM_SAMPLES;
-}
+  // The cursors are an overlay on top of the traces
+  if(cursorMode != CURSOR_OFF && displayMode == DISPLAY_YT){
+    displayCursors();
+  }
 
-// ----------------------
-/* END ADC FUNCTIONS */
-// ----------------------
+  if(freqCounterOn){
+    displayFrequencyCounter();
+  }
 
+  // Reference waveforms sit under the overlays, alongside the live traces
+  if(displayMode == DISPLAY_YT){
+    displayRefs();
+  }
 
+  if(maskTesting && maskValid && displayMode == DISPLAY_YT){
+    displayMaskOverlay();
+  }
 
+  // Decoded bus traffic is labeled over the traces
+  if(decodeProtocol != DECODE_OFF && displayMode == DISPLAY_YT){
+    displayDecodeAnnotations();
+  }
+  
+  
+  #if debugging
+  // displayOffsets();
+  // displayUIStates();
+  #endif
 
+  #if runUI
+  // If the user (UI) has indicated, display the menu (from navigation)
+  if(showMenu){
+    displayMenu();
+  }else{
+  
+  }
+  #endif
+}
 
 //--------------------------
-/* BEGIN Display Functions */
+/* END Display Functions */
 // -------------------------
 
+
+
+
+
+// -----------------------------------
+/* BEGIN Capture Replay Functions */
+// -----------------------------------
+
+/*
+Name: captureHeader
+Description: The header for a capture of a number of records taken in captureAcqMode by this build, packed in captureLayout
+Returns: CaptureHeader
+Parameters: uint32_t "records"
+*/
+CaptureHeader captureHeader(uint32_t records){
+  return CaptureHeader {CAPTURE_MAGIC, CAPTURE_VERSION, (uint8_t)captureLayout, NUM_CHANNELS, records, NUM_SAMPLES, (uint32_t)captureAcqMode,
+                        (float)((captureAcqMode == ACQ_DUAL) ? ADC_SAMPLE_DT : ADC_SAMPLE_DT/2.0)};
+}
+
 /*
-Name: intToCharArr
-Description: Converts an integer-type value into an array of chars to allow printing of numbers.
-Returns: A char pointer (char array) representing an integer value
-Parameters: int "num"
+Name: captureHeaderValid
+Description: Whether a capture header is one this build can replay: a known layout, and the same channel count and record length
+Returns: bool
+Parameters: const CaptureHeader& "header"
 */
-const char* intToCharArr(int num){
-  const char* charArr;
-  String stringNum = (String)(num);
-  charArr = stringNum.c_str();
-  return charArr;
+bool captureHeaderValid(const CaptureHeader& header){
+  return header.magic == CAPTURE_MAGIC && header.version == CAPTURE_VERSION && header.layout < STORE_NUM_LAYOUTS
+      && header.channels == NUM_CHANNELS && header.recordLength == NUM_SAMPLES && header.acqMode <= ACQ_INTERLEAVE_CH2;
 }
 
 /*
-Name: doubletoCharArr 
-Description: Converts a double-type value into an array of chars to allow printing of numbers
-Returns: a char pointer (char array) representing a double value
-Parameters: double "num"
+Name: captureRecordBytes
+Description: The bytes one record takes in a capture packed in a layout
+Returns: uint32_t "bytes"
+Parameters: int "layout" (STORE_ value)
 */
-const char* doubleToCharArr(double num){
-  const char* charArr;
-  String stringNum = (String)(num);
-  charArr = stringNum.c_str();
-  return charArr;
+uint32_t captureRecordBytes(int layout){
+  return (NUM_CHANNELS*NUM_SAMPLES*storeLayoutBits[layout] + 31)/32*4;
 }
 
 /*
-Name: calcCH1P2P
-Description: calcCH1P2P = "calculate channel one peak-to-peak." Find's the highest and lowest values from the 320-value long
-channel one plotting array, and subtracts them from eachother to get the maximum voltage difference of the waveform.
-Returns: Nothing (updates global variable)
-Parameters: None
+Name: packCaptureChunk
+Description: Packs RECORD_WINDOW samples per channel of the record, from sample index first, into a chunk of a capture record in another
+layout (BITS per sample, dropping the SHIFT low bits)
+Returns: Nothing (fills the chunk)
+Parameters: uint32_t "chunk[]" (CAPTURE_CHUNK_WORDS + 1 words), int "first"
 */
-void calcCH1P2P(){
-  double lowV = 10000;
-  double highV = -10000;
-  for(int i = 0; i < LX; i++){
-    if(sig1Data[i] < lowV){
-      lowV = sig1Data[i];
-    }
-    if(sig1Data[i] > highV){
-      highV = sig1Data[i];
-    }
+template<int BITS, int SHIFT>
+void packCaptureChunk(uint32_t chunk[], int first){
+  sample_t window[RECORD_WINDOW];
+  for(int ch = 0; ch < NUM_CHANNELS; ch++){
+    loadRecordWindow(ch, first, RECORD_WINDOW, window);
+    packChannel<NUM_CHANNELS, BITS, SHIFT>(chunk, ch, 0, RECORD_WINDOW, window);
   }
-
-  CH1_P2P = highV - lowV;
 }
 
-
 /*
-Name: calcCH2P2P
-Description: calcCH1P2P = "calculate channel two peak-to-peak." Find's the highest and lowest values from the 320-value long
-channel two plotting array, and subtracts them from eachother to get the maximum voltage difference of the waveform.
-Returns: Nothing (updates global variable)
-Parameters: None
+Name: unpackCaptureChunk
+Description: The reverse of packCaptureChunk: unpacks a chunk of a capture record into the record from sample index first
+Returns: Nothing (updates sampleStore)
+Parameters: const uint32_t "chunk[]", int "first"
 */
-void calcCH2P2P(){
-  double lowV = 10000;
-  double highV = -10000;
-  for(int i = 0; i < LX; i++){
-    if(sig2Data[i] < lowV){
-      lowV = sig2Data[i];
-    }
-    if(sig2Data[i] > highV){
-      highV = sig2Data[i];
-    }
+template<int BITS, int SHIFT>
+void unpackCaptureChunk(const uint32_t chunk[], int first){
+  sample_t window[RECORD_WINDOW];
+  for(int ch = 0; ch < NUM_CHANNELS; ch++){
+    unpackChannel<NUM_CHANNELS, BITS, SHIFT>(chunk, ch, 0, RECORD_WINDOW, window);
+    saveRecordWindow(ch, first, RECORD_WINDOW, window);
   }
-
-  CH2_P2P = highV - lowV;
 }
 
 /*
-Name: calcCH1T
-Description: Calculates the period of channel one. (1) Determines if the waveform is increasing or decreasing from the first point. (2) waits until the value
-'comes back around', which would be half a period. (3) Update the CH1_T value with the calculate period. Update the value to -1 if a period couldn't be found.
-Returns: Nothing (updates global variable)
-Parameters: None
+Name: writeCaptureRecord
+Description: Appends the record to a capture file, packed in a layout: the record's own layout straight from the sample store, the others
+converted a chunk (RECORD_WINDOW samples per channel) at a time
+Returns: bool (true if the whole record was written)
+Parameters: File& "file", int "layout" (STORE_ value)
 */
-void calcCH1T(){
-  
-  #if dummy 
-    CH1_T = 999;
-  #endif
-  
-  #if !dummy
-  double sample;
-  int repeatIndex = -1; 
-  int slope;
-  int signCounter = 0;
-
-  sample = voltageData1[0];
+bool writeCaptureRecord(File& file, int layout){
+  if(layout == STORE_PACK_PROC){
+    return file.write((const uint8_t*)sampleStore, SAMPLE_STORE_BYTES) == SAMPLE_STORE_BYTES;
+  }
 
-  // Determine the waveform's slope direction (positive or negative)
-  for(int i = 1; i < NUM_SAMPLES; i++){
-    if(voltageData1[i] < sample){
-      signCounter--;
-    }else if(voltageData1[i] > sample){
-      signCounter++;
+  uint32_t chunk[CAPTURE_CHUNK_WORDS + 1]; // A field is merged into the two words it can straddle, so one spare word follows
+  size_t bytes = RECORD_WINDOW*NUM_CHANNELS*storeLayoutBits[layout]/8;
+  bool ok = true;
+  for(int first = 0; ok && first < NUM_SAMPLES; first += RECORD_WINDOW){
+    if(layout == STORE_U16){
+      packCaptureChunk<16, 0>(chunk, first);
     }else{
-
-    }
-    
-    if(abs(signCounter) >= 3){ // If three or more repeated in/decreases of value are detected, slope sign can be determined
-      if(signCounter < 0){
-        slope = -1;
-        break;
-      }else if(signCounter > 0){
-        slope = 1;
-        break;
-      }
+      packCaptureChunk<STORE_ADC_BITS, PROC_EXTRA_BITS>(chunk, first);
     }
+    ok = file.write((const uint8_t*)chunk, bytes) == bytes;
   }
+  return ok;
+}
 
+/*
+Name: readCaptureRecord
+Description: Reads the next record of a capture file, packed in a layout, into the sample store (see writeCaptureRecord)
+Returns: bool (true if the whole record was read)
+Parameters: File& "file", int "layout" (STORE_ value)
+*/
+bool readCaptureRecord(File& file, int layout){
+  if(layout == STORE_PACK_PROC){
+    return file.read(sampleStore, SAMPLE_STORE_BYTES) == (int)SAMPLE_STORE_BYTES;
+  }
 
-  // Using the slope direction, look for when the value 'comes back around', and record the index where it does
-  for(int i = 1; i < NUM_SAMPLES; i++){
-    if(slope < 0){
-      if(voltageData1[i] > sample){
-        repeatIndex = i;
-        break;
-      }
+  uint32_t chunk[CAPTURE_CHUNK_WORDS + 1];
+  int bytes = RECORD_WINDOW*NUM_CHANNELS*storeLayoutBits[layout]/8;
+  bool ok = true;
+  for(int first = 0; ok && first < NUM_SAMPLES; first += RECORD_WINDOW){
+    ok = file.read(chunk, bytes) == bytes;
+    if(!ok){
+      break;
     }
-    if(slope > 0){
-      if(voltageData1[i] < sample){
-        repeatIndex = i;
-        break;
-      }
+    if(layout == STORE_U16){
+      unpackCaptureChunk<16, 0>(chunk, first);
+    }else{
+      unpackCaptureChunk<STORE_ADC_BITS, PROC_EXTRA_BITS>(chunk, first);
     }
   }
-
-  // Calculate the period. Set the period to -1 if it could not be determined
-  if(repeatIndex < 0){
-    CH1_T = -1;
-  }else{
-    CH1_T = (repeatIndex*2.0)*sampleDt;
-  }
-
-  #endif
+  return ok;
 }
 
 /*
-Name: calcCH1T
-Description: Calculates the period of channel one. (1) Determines if the waveform is increasing or decreasing from the first point. (2) waits until the value
-'comes back around', which would be half a period. (3) Update the CH1_T value with the calculate period. Update the value to -1 if a period couldn't be found.
-Returns: Nothing (updates global variable)
+Name: startCapture
+Description: Starts a new capture: replaces CAPTURE_FILE with a header for no records yet, and turns recording on
+Returns: bool (true if recording)
 Parameters: None
 */
-void calcCH2T(){
-  
-  #if dummy 
-    CH2_T = 999;
-  #endif
-  
-  #if !dummy
-  double sample;
-  int repeatIndex = -1; 
-  int slope;
-  int signCounter = 0;
-
-  sample = voltageData2[0];
-
-  // Determine the waveform's slope direction (positive or negative)
-  for(int i = 1; i < NUM_SAMPLES; i++){
-    if(voltageData2[i] < sample){
-      signCounter--;
-    }else if(voltageData2[i] > sample){
-      signCounter++;
-    }else{
-
-    }
-    
-    if(abs(signCounter) >= 3){ // If three or more repeated in/decreases of value are detected, slope sign can be determined
-      if(signCounter < 0){
-        slope = -1;
-        break;
-      }else if(signCounter > 0){
-        slope = 1;
-        break;
-      }
-    }
+bool startCapture(){
+  if(!sdAvailable || replaying){
+    return false;
   }
-
-
-  // Using the slope direction, look for when the value 'comes back around', and record the index where it does
-  for(int i = 1; i < NUM_SAMPLES; i++){
-    if(slope < 0){
-      if(voltageData2[i] > sample){
-        repeatIndex = i;
-        break;
-      }
-    }
-    if(slope > 0){
-      if(voltageData2[i] < sample){
-        repeatIndex = i;
-        break;
-      }
-    }
+  if(captureRecording){
+    captureFile.close();
   }
 
-  // Calculate the period. Set the period to -1 if it could not be determined
-  if(repeatIndex < 0){
-    CH2_T = -1;
-  }else{
-    CH2_T = (repeatIndex*2.0)*sampleDt;
+  SD.remove(CAPTURE_FILE);
+  captureFile = SD.open(CAPTURE_FILE, FILE_WRITE);
+  captureRecords = 0;
+  captureAcqMode = acqMode;
+  CaptureHeader header = captureHeader(0);
+  captureRecording = captureFile && captureFile.write((const uint8_t*)&header, sizeof(header)) == sizeof(header);
+  if(!captureRecording && captureFile){
+    captureFile.close();
   }
-
-  #endif
+  return captureRecording;
 }
 
 /*
-Name: drawAxes
-Description: Uses the TGX library to draw a collection of vertical & horizontal lines, making the oscilloscope's 
-X & Y axes.
-Returns: Nothing (shows on display)
+Name: stopCapture
+Description: Stops recording: writes the record count into the capture's header and closes the file
+Returns: Nothing (updates global variables)
 Parameters: None
 */
-void drawAxes()
-  {
-    // Draw X-axis
-    oScopeImage.drawFastHLine(tgx::iVec2 {0, 120}, 320, WHITE);
-
-    //Draw Y-axis
-    oScopeImage.drawFastVLine(tgx::iVec2 {160, 0}, 240, WHITE);
-   
-    // Draw small markers along the X-axis
-    for(int i = 0; i <= 32; i++){
-      oScopeImage.drawFastVLine(tgx::iVec2 {i*10, 115}, 10, WHITE);
-    }
-
-    // Draw small markers along the Y-axis
-    for(int i = 0; i <= 24; i++){
-      oScopeImage.drawFastHLine(tgx::iVec2 {155, i*10}, 10, WHITE);
-    }
+void stopCapture(){
+  if(!captureRecording){
+    return;
   }
 
+  CaptureHeader header = captureHeader(captureRecords);
+  captureFile.seek(0);
+  captureFile.write((const uint8_t*)&header, sizeof(header));
+  captureFile.close();
+  captureRecording = false;
+  Serial.print("Capture stopped at ");
+  Serial.print(captureRecords);
+  Serial.println(" records");
+}
 
 /*
-Name: displayTriggerVoltage
-Description: Reads the global "triggerVoltage" variable and displays it on screen. Most accurate units are also printed (mV or V).
-Returns: Nothing (shows on display)
+Name: recordCapture
+Description: While capture recording is on, appends the acquisition just processed (the whole store) to the capture. Recording stops once the
+card is full or the records stop matching the capture's timing.
+Returns: Nothing (updates the capture file)
 Parameters: None
 */
-  void displayTriggerVoltage(){
-    
-    oScopeImage.drawText("Volt Trig: ", {240, 10}, TRIG_VOLT_FONT, WHITE); // Display "Volt Trig" heading
-    
-    if(abs(triggerVoltage) < 1){
-      oScopeImage.drawText(intToCharArr((int)(triggerVoltage*1000)), {285, 10}, TRIG_VOLT_FONT, WHITE); // Display trigger voltage value
-      oScopeImage.drawText("mV", {305, 10}, TRIG_VOLT_FONT, WHITE); // Add "mV" units
-    } else {
-      oScopeImage.drawText(doubleToCharArr(triggerVoltage), {285, 10}, TRIG_VOLT_FONT, WHITE); // Display trigger voltage value
-      oScopeImage.drawText("V", {305, 10}, TRIG_VOLT_FONT, WHITE); // Add "V" units
-    }
-    
+void recordCapture(){
+  if(!captureRecording){
+    return;
   }
 
+  if(acqMode != captureAcqMode || !writeCaptureRecord(captureFile, captureLayout)){
+    stopCapture();
+    return;
+  }
+  captureRecords++;
+}
 
 /*
-Name: displayHScale
-Description: Reads the global "HScale" variable and displays its value on screen.
-Returns: Nothing (shows on display)
+Name: sendCapture
+Description: Copies CAPTURE_FILE to the serial port as it is (header, then the records)
+Returns: bool (true if everything was sent)
 Parameters: None
 */
-  void displayHScale(){
-    // On-screen positions are hard-coded here for our given display arrangement
-    oScopeImage.drawText("Horz: ", {265, 230}, SCALE_FONT, WHITE);
-    oScopeImage.drawText(doubleToCharArr(HScale*1000000.0), {295, 230}, SCALE_FONT, WHITE);
+bool sendCapture(){
+  if(!sdAvailable || captureRecording || replaying){
+    return false;
   }
 
+  File file = SD.open(CAPTURE_FILE, FILE_READ);
+  if(!file){
+    return false;
+  }
+  uint8_t buffer[512];
+  bool ok = true;
+  int count;
+  while(ok && (count = file.read(buffer, sizeof(buffer))) > 0){
+    ok = Serial.write(buffer, count) == (size_t)count;
+  }
+  file.close();
+  return ok;
+}
 
 /*
-Name: displayVScale
-Description: Reads the global variable "VScale" and displays its value on screen.
-Returns: Nothing (shows on display)
+Name: receiveCapture
+Description: Reads a capture sent by sendCapture from the serial port into CAPTURE_FILE. Captures in an unknown layout, or from a build with a
+different channel count or record length, are refused.
+Returns: bool (true if the whole capture was received)
 Parameters: None
 */
-  void displayVScale(){
-    // On-screen positions are hard-coded here for our given display arrangement
-    oScopeImage.drawText("Vert: ", {200, 230}, SCALE_FONT, WHITE);
-    oScopeImage.drawText(doubleToCharArr(VScale), {230, 230}, SCALE_FONT, WHITE);
+bool receiveCapture(){
+  CaptureHeader header;
+  if(!sdAvailable || captureRecording || replaying || Serial.readBytes((char*)&header, sizeof(header)) != sizeof(header)
+     || !captureHeaderValid(header)){
+    return false;
   }
 
-
-  void displayOffsets(){
-    updateOffsets();
-    // On-screen positions are hard-coded here for our given display arrangement
-    oScopeImage.drawText("Offset1: ", {220, 120}, SCALE_FONT, WHITE);
-    oScopeImage.drawText(doubleToCharArr(offset1*1.0), {280, 120}, SCALE_FONT, WHITE);
-    oScopeImage.drawText("Offset2: ", {220, 140}, SCALE_FONT, WHITE);
-    oScopeImage.drawText(doubleToCharArr(offset2*1.0), {280, 140}, SCALE_FONT, WHITE);
+  SD.remove(CAPTURE_FILE);
+  File file = SD.open(CAPTURE_FILE, FILE_WRITE);
+  if(!file){
+    return false;
+  }
+  uint8_t buffer[512];
+  uint64_t remaining = (uint64_t)header.records*captureRecordBytes(header.layout);
+  bool ok = file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header);
+  while(ok && remaining > 0){
+    size_t count = (size_t)min(remaining, (uint64_t)sizeof(buffer));
+    ok = Serial.readBytes((char*)buffer, count) == count && file.write(buffer, count) == count;
+    remaining -= count;
   }
+  file.close();
+  return ok;
+}
 
 /*
-Name: displayCH1Meas
-Description: displayCH1Meas = "display channel one measurements." Calculates and displays channel one's peak-to-peak voltage and period.
-Returns: Nothing (shows on display)
-Parameters: None
+Name: copyCaptureFile
+Description: Copies a capture file on the SD card to another name (replacing it). Only a capture this build can replay is copied.
+Returns: bool (true if copied)
+Parameters: const char* "from", const char* "to"
 */
-  void displayCH1Meas(){
-    calcCH1P2P();
-    calcCH1T();
-    
-    // On-screen positions are hard-coded here for our given display arrangement
-    oScopeImage.drawText("CH1 Measurements:", {0,10}, MEAS_FONT, CH1_COLOR);
-    oScopeImage.drawText("P2P:", {0,25}, MEAS_FONT, CH1_COLOR);
-    oScopeImage.drawText("T:", {0,40}, MEAS_FONT, CH1_COLOR);
-
-    if(abs(CH1_P2P) < 1){
-      oScopeImage.drawText(intToCharArr((int)(CH1_P2P*1000)), {25,25}, MEAS_FONT, CH1_COLOR);
-      oScopeImage.drawText("mV", {45, 25}, TRIG_VOLT_FONT, CH1_COLOR); // Add "mV" units
-    } else {
-      oScopeImage.drawText(doubleToCharArr(CH1_P2P), {25,25}, MEAS_FONT, CH1_COLOR);
-      oScopeImage.drawText("V", {45, 25}, TRIG_VOLT_FONT, CH1_COLOR); // Add "V" units
-    }
+bool copyCaptureFile(const char* from, const char* to){
+  CaptureHeader header;
+  if(!sdAvailable || captureRecording || replaying){
+    return false;
+  }
 
-    if(abs(CH1_T) < 0.001){
-      oScopeImage.drawText(intToCharArr((int)(CH1_T*1000000)), {15,40}, MEAS_FONT, CH1_COLOR);
-      oScopeImage.drawText("us", {35, 40}, TRIG_VOLT_FONT, CH1_COLOR); // Add "micro-seconds" units
-    } else if (abs(CH1_T) < 1){
-      oScopeImage.drawText(intToCharArr((int)(CH1_T*1000)), {15,40}, MEAS_FONT, CH1_COLOR);
-      oScopeImage.drawText("ms", {35, 40}, TRIG_VOLT_FONT, CH1_COLOR); // Add "milli-seconds" units
-    } else {
-      oScopeImage.drawText(doubleToCharArr(CH1_T), {15,40}, MEAS_FONT, CH1_COLOR);
-      oScopeImage.drawText("s", {35, 40}, TRIG_VOLT_FONT, CH1_COLOR); // Add "seconds" units
-    }
+  File in = SD.open(from, FILE_READ);
+  if(!in){
+    return false;
+  }
+  if(in.read(&header, sizeof(header)) != (int)sizeof(header) || !captureHeaderValid(header)){
+    in.close();
+    return false;
   }
 
+  SD.remove(to);
+  File out = SD.open(to, FILE_WRITE);
+  uint8_t buffer[512];
+  bool ok = out && out.write((const uint8_t*)&header, sizeof(header)) == sizeof(header);
+  int count;
+  while(ok && (count = in.read(buffer, sizeof(buffer))) > 0){
+    ok = out.write(buffer, count) == (size_t)count;
+  }
+  in.close();
+  out.close();
+  return ok;
+}
 
 /*
-Name: displayCH2Meas
-Description: displayCH2Meas = "display channel two measurements." Calculates and displays channel two's peak-to-peak voltage and period.
-Returns: Nothing (shows on display)
-Parameters: None
+Name: captureSlotName
+Description: The file name of a saved capture slot (CAPTn.BIN)
+Returns: Nothing (writes into the provided buffer)
+Parameters: char* "name" (at least 10 chars), int "slot" (0 to CAPTURE_NUM_SLOTS - 1)
 */
-  void displayCH2Meas(){
-    calcCH2P2P();
-    calcCH2T();
-
-    // On-screen positions are hard-coded here for our given display arrangement
-    oScopeImage.drawText("CH2 Measurements:", {0,205}, MEAS_FONT, CH2_COLOR);
-    oScopeImage.drawText("P2P:", {0,220}, MEAS_FONT, CH2_COLOR);
-    oScopeImage.drawText("T:", {0,235}, MEAS_FONT, CH2_COLOR);
-    
-    if(abs(CH2_P2P) < 1){
-      oScopeImage.drawText(intToCharArr((int)(CH2_P2P*1000)), {25,220}, MEAS_FONT, CH2_COLOR);
-      oScopeImage.drawText("mV", {45, 220}, TRIG_VOLT_FONT, CH2_COLOR); // Add "mV" units
-    } else {
-      oScopeImage.drawText(doubleToCharArr(CH2_P2P), {25,220}, MEAS_FONT, CH2_COLOR);
-      oScopeImage.drawText("V", {45, 220}, TRIG_VOLT_FONT, CH2_COLOR); // Add "V" units
-    }
+void captureSlotName(char* name, int slot){
+  snprintf(name, 10, "CAPT%c.BIN", '0' + slot); // One digit, so the name always fits 8.3
+}
 
-    if(abs(CH2_T) < 0.001){
-      oScopeImage.drawText(intToCharArr((int)(CH2_T*1000000)), {15, 235}, MEAS_FONT, CH2_COLOR);
-      oScopeImage.drawText("us", {35, 235}, TRIG_VOLT_FONT, CH2_COLOR); // Add "micro-seconds" units
-    } else if (abs(CH2_T) < 1){
-      oScopeImage.drawText(intToCharArr((int)(CH2_T*1000)), {15, 235}, MEAS_FONT, CH2_COLOR);
-      oScopeImage.drawText("ms", {35, 235}, TRIG_VOLT_FONT, CH2_COLOR); // Add "milli-seconds" units
-    } else {
-      oScopeImage.drawText(doubleToCharArr(CH2_T), {15, 235}, MEAS_FONT, CH2_COLOR);
-      oScopeImage.drawText("s", {35, 235}, TRIG_VOLT_FONT, CH2_COLOR); // Add "seconds" units
-    }
+/*
+Name: saveCapture
+Description: Keeps a copy of CAPTURE_FILE in a numbered slot on the SD card ("capture save <n>"), so the next capture doesn't replace it
+Returns: bool (true if saved)
+Parameters: int "slot"
+*/
+bool saveCapture(int slot){
+  char name[10];
+  if(slot < 0 || slot >= CAPTURE_NUM_SLOTS){
+    return false;
   }
+  captureSlotName(name, slot);
+  return copyCaptureFile(CAPTURE_FILE, name);
+}
 
 /*
-Name: displayCH1Signal
-Description: displayCH1Signal = "display channel one's signal (waveform)." Map all of channel one's 320 extracted voltage data points
-into x & y vectors (2D coordinates), then plot them on screen. Color of the points are CH1_COLOR
-Returns: Nothing (shows on display)
-Parameters: None
+Name: loadCapture
+Description: Copies a saved slot back to CAPTURE_FILE ("capture load <n>"), ready to be replayed
+Returns: bool (true if loaded)
+Parameters: int "slot"
 */
-  void displayCH1Signal(){
-
-    // Translate & scale channel 1's voltage values to pixel coordinate (for plotting)
-    for(int i = 0; i < LX; i++){
-      sig1Points[i].x = i;
-      sig1Points[i].y = (int)((LY/2) + (sig1Data[i]/VScale)*120); // Y pixel coordinate = 120 + (voltage/scalar)*120
-    }
-    // Plot channel 1's data points (voltage vs time)
-    for(int i = 0; i < LX; i++){
-      oScopeImage.drawPixel(sig1Points[i], CH1_COLOR);
-    }
+bool loadCapture(int slot){
+  char name[10];
+  if(slot < 0 || slot >= CAPTURE_NUM_SLOTS){
+    return false;
   }
-
+  captureSlotName(name, slot);
+  return copyCaptureFile(name, CAPTURE_FILE);
+}
 
 /*
-Name: displayCH2Signal
-Description: displayCH2Signal = "display channel two's signal (waveform)." Map all of channel two's 320 extracted voltage data points
-into x & y vectors (2D coordinates), then plot them on screen. Color of the points are CH2_COLOR
-Returns: Nothing (shows on display)
-Parameters: None
+Name: setCaptureLayout
+Description: Picks the layout the next capture is written in ("capture layout <n>"): STORE_U16, STORE_PACK_PROC (the record's own, the
+default) or STORE_PACK_ADC (smallest, drops the processing's extra bits). Refused while recording, as the capture's records share one layout.
+Returns: bool (true if set)
+Parameters: int "layout"
 */
-  void displayCH2Signal(){
-
-    // Translate & scale channel 2's voltage values to pixel coordinate (for plotting)
-    for(int i = 0; i < LX; i++){
-      sig2Points[i].x = i;
-      sig2Points[i].y = (int)((LY/2) + (sig2Data[i]/VScale)*120); // Y pixel coordinate = 120 + (voltage/scalar)*120
-    }
-
-    // Plot channel 2's data points (voltage vs time)
-    for(int i = 0; i < LX; i++){
-      oScopeImage.drawPixel(sig2Points[i], CH2_COLOR);
-    }
+bool setCaptureLayout(int layout){
+  if(layout < 0 || layout >= STORE_NUM_LAYOUTS || captureRecording){
+    return false;
   }
-
+  captureLayout = layout;
+  return true;
+}
 
 /*
-Name: displayTriggerSelect
-Description: Displays the moscilloscope menu's "trigger select" option for changing the trigger voltage value
-Returns: Nothing (shows on display)
-Parameters: None
+Name: setReplay
+Description: Starts or stops replaying CAPTURE_FILE. Replay takes on the capture's acquisition mode (and so its sample spacing); stopping hands
+the mode back to updateAcquisitionMode(). The records are converted with this unit's calibration.
+Returns: bool (true if replay is now in the state asked for)
+Parameters: bool "on"
 */
-  void displayTriggerSelect(){
-    oScopeImage.fillThickRect({110, 210, 0, 40}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
-    
-    oScopeImage.drawText("Trig: ", {116, 25}, CHANGE_VALUE_FONT, WHITE); // Display "Volt Trig" heading
-    
-    if(abs(triggerVoltage) < 1){
-      oScopeImage.drawText(intToCharArr((int)(triggerVoltage*1000)), {150, 25}, CHANGE_VALUE_FONT, WHITE); // Display trigger voltage value
-      oScopeImage.drawText("mV", {185, 25}, CHANGE_VALUE_FONT, WHITE); // Add "mV" units
-    } else {
-      oScopeImage.drawText(doubleToCharArr(triggerVoltage), {150, 25}, CHANGE_VALUE_FONT, WHITE); // Display trigger voltage value
-      oScopeImage.drawText("V", {185, 25}, CHANGE_VALUE_FONT, WHITE); // Add "V" units
-    }
+bool setReplay(bool on){
+  if(replaying){
+    captureFile.close();
+    replaying = false;
+  }
+  if(!on){
+    return true;
+  }
+  if(!sdAvailable || captureRecording){
+    return false;
+  }
 
+  CaptureHeader header;
+  captureFile = SD.open(CAPTURE_FILE, FILE_READ);
+  if(!captureFile){
+    return false;
+  }
+  if(captureFile.read(&header, sizeof(header)) != (int)sizeof(header) || !captureHeaderValid(header) || header.records == 0){
+    captureFile.close();
+    return false; // Nothing to replay
   }
 
-  /*
-Name: displayScalingSelect
-Description: Displays the moscilloscope menu's "scaling select" option for changing the horizontal and vertical scale values
-Returns: Nothing (shows on display)
+  replaying = true;
+  replayPosition = 0;
+  captureRecords = header.records;
+  captureAcqMode = header.acqMode;
+  replayLayout = header.layout;
+  setAcquisitionMode(captureAcqMode);
+  return true;
+}
+
+/*
+Name: replayNextRecord
+Description: The replay source: reads the next record of the capture into the sample store, wrapping around at its end. The records were
+stored after processAcquisition(), so they are already in processed counts.
+Returns: Nothing (updates sampleStore)
 Parameters: None
 */
-  void displayScalingSelect(){
-    oScopeImage.fillThickRect({110, 210, 0, 65}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
-
-    oScopeImage.drawText("Horz: ", {114, 25}, CHANGE_VALUE_FONT, WHITE);
-    oScopeImage.drawText(doubleToCharArr(HScale*1000000.0), {165, 25}, CHANGE_VALUE_FONT, WHITE);
-  
-    // On-screen positions are hard-coded here for our given display arrangement
-    oScopeImage.drawText("Vert: ", {114, 50}, CHANGE_VALUE_FONT, WHITE);
-    oScopeImage.drawText(doubleToCharArr(VScale), {165, 50}, CHANGE_VALUE_FONT, WHITE);
+void replayNextRecord(){
+  if(replayPosition >= captureRecords){
+    replayPosition = 0;
   }
+  captureFile.seek(sizeof(CaptureHeader) + (uint64_t)replayPosition*captureRecordBytes(replayLayout));
+  readCaptureRecord(captureFile, replayLayout);
+  replayPosition++;
+}
 
 /*
-Name: displayWave1Select
-Description: Displays the moscilloscope menu's "wave 1 select" option for turning on/off channel one's waveform plot
-Returns: Nothing (shows on display)
-Parameters: None
+Name: benchmarkReplay
+Description: Used for testing & debugging. Pushes every record of the capture through the pipeline as fast as it will go (unpack, voltage
+conversion and trigger, decimation, decoding and mask test, then an off-screen render with the measurements), and reports the acquisitions
+per second and the time spent in each stage (reading a record off the card counts as its unpack). Optionally writes every rendered frame to
+REPLAY_FRAMES_FILE on the SD card (not timed).
+Returns: Nothing (prints to terminal)
+Parameters: bool "emitFrames"
 */
-  void displayWave1Select(){
-    oScopeImage.fillThickRect({110, 210, 0, 40}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
+void benchmarkReplay(bool emitFrames){
+  const char* stageNames[] = {"Unpack", "Convert + trigger", "Decimate", "Decode + mask", "Render + measure"};
+  const int numStages = sizeof(stageNames)/sizeof(stageNames[0]);
+  uint64_t stageCycles[numStages] = {0};
+  uint32_t maskFailsBefore = maskFailCount;
+  File frames;
+
+  bool wasReplaying = replaying;
+  if(!setReplay(true)){
+    Serial.println("No capture to replay");
+    return;
+  }
+  uint32_t records = captureRecords;
+  if(emitFrames){
+    SD.remove(REPLAY_FRAMES_FILE);
+    frames = SD.open(REPLAY_FRAMES_FILE, FILE_WRITE);
+  }
+  bool writingFrames = (bool)frames;
 
-    oScopeImage.drawText("Wave 1: ", {114, 25}, CHANGE_VALUE_FONT, WHITE); 
-    if(showWave1 == true){
-      oScopeImage.drawText("ON", {175, 25}, CHANGE_VALUE_FONT, WHITE); 
-    }else{
-      oScopeImage.drawText("OFF", {175, 25}, CHANGE_VALUE_FONT, WHITE); 
+  for(uint32_t r = 0; r < records; r++){
+    uint32_t marks[numStages + 1];
+
+    marks[0] = ARM_DWT_CYCCNT;
+    replayNextRecord();
+    marks[1] = ARM_DWT_CYCCNT;
+    updateVoltageData();
+    marks[2] = ARM_DWT_CYCCNT;
+    extractPlottingData();
+    if(displayMode == DISPLAY_ZOOM){
+      extractZoomOverview();
+      extractZoomColumns();
+    }
+    marks[3] = ARM_DWT_CYCCNT;
+    runProtocolDecoder();
+    runMaskTest();
+    marks[4] = ARM_DWT_CYCCNT;
+    renderFrame();
+    marks[5] = ARM_DWT_CYCCNT;
+
+    for(int stage = 0; stage < numStages; stage++){
+      stageCycles[stage] += marks[stage + 1] - marks[stage];
+    }
+    if(writingFrames){
+      frames.write((const uint8_t*)fb, sizeof(fb));
     }
   }
 
-  /*
-Name: displayWave2Select
-Description: Displays the moscilloscope menu's "wave 2 select" option for turning on/off channel two's waveform plot
-Returns: Nothing (shows on display)
-Parameters: None
-*/
-  void displayWave2Select(){
-    oScopeImage.fillThickRect({110, 210, 0, 40}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
+  if(writingFrames){
+    frames.close();
+  }
+  setReplay(wasReplaying);
 
-    oScopeImage.drawText("Wave 2: ", {114, 25}, CHANGE_VALUE_FONT, WHITE); 
-    if(showWave2 == true){
-      oScopeImage.drawText("ON", {175, 25}, CHANGE_VALUE_FONT, WHITE); 
-    }else{
-      oScopeImage.drawText("OFF", {175, 25}, CHANGE_VALUE_FONT, WHITE); 
-    }
+  uint64_t totalCycles = 0;
+  for(int stage = 0; stage < numStages; stage++){
+    totalCycles += stageCycles[stage];
+  }
+  double cyclesPerUs = F_CPU_ACTUAL/1E6;
+
+  Serial.print("Replayed ");
+  Serial.print(records);
+  Serial.print(" records: ");
+  Serial.print(records/(totalCycles/(cyclesPerUs*1E6)), 1);
+  Serial.println(" acquisitions/s");
+  Serial.println("Stage, us/record, share");
+  for(int stage = 0; stage < numStages; stage++){
+    Serial.print(stageNames[stage]);
+    Serial.print(", ");
+    Serial.print(stageCycles[stage]/cyclesPerUs/records, 1);
+    Serial.print(", ");
+    Serial.print(100.0*stageCycles[stage]/totalCycles, 1);
+    Serial.println("%");
   }
+  if(maskTesting && maskValid){
+    Serial.print("Mask failures: ");
+    Serial.println(maskFailCount - maskFailsBefore);
+  }
+  if(emitFrames){
+    Serial.println(writingFrames ? "Frames written to " REPLAY_FRAMES_FILE : "Frames not written (no SD card)");
+  }
+}
+
+
+// ---------------------------------
+/* END Capture Replay Functions */
+// ---------------------------------
+
+
+
 
+// -------------------------------------
+/* BEGIN Frame Regression Functions */
+// -------------------------------------
 
 /*
-Name: displayMeas1Select
-Description: Displays the moscilloscope menu's "measurements 1 select" option for turning on/off channel one's measurements display
-Returns: Nothing (shows on display)
-Parameters: None
+Name: frameBMPHeader
+Description: Fills in the header of a top-down LX x LY RGB565 BMP image (BI_BITFIELDS, so the pixels are stored exactly as in fb)
+Returns: Nothing (fills the provided array)
+Parameters: uint8_t "header[]" (FRAME_BMP_HEADER bytes)
 */
-  void displayMeas1Select(){
-    oScopeImage.fillThickRect({110, 210, 0, 40}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
-
-    oScopeImage.drawText("Meas 1: ", {114, 25}, CHANGE_VALUE_FONT, WHITE); 
-    if(showMeas1 == true){
-      oScopeImage.drawText("ON", {175, 25}, CHANGE_VALUE_FONT, WHITE); 
-    }else{
-      oScopeImage.drawText("OFF", {175, 25}, CHANGE_VALUE_FONT, WHITE); 
+void frameBMPHeader(uint8_t header[FRAME_BMP_HEADER]){
+  const uint32_t fields[][2] = { // {offset, value} of each little-endian field
+    {2, FRAME_BMP_HEADER + LX*LY*2}, {10, FRAME_BMP_HEADER}, {14, 40}, {18, LX}, {22, (uint32_t)-LY}, {26, 1 | (16 << 16)}, {30, 3},
+    {34, LX*LY*2}, {38, 2835}, {42, 2835}, {54, 0xF800}, {58, 0x07E0}, {62, 0x001F}
+  };
+
+  memset(header, 0, FRAME_BMP_HEADER);
+  header[0] = 'B';
+  header[1] = 'M';
+  for(int f = 0; f < (int)(sizeof(fields)/sizeof(fields[0])); f++){
+    for(int b = 0; b < 4; b++){
+      header[fields[f][0] + b] = (fields[f][1] >> (8*b)) & 0xFF;
     }
   }
+}
 
-  /*
-Name: displayMeas2Select
-Description: Displays the moscilloscope menu's "measurements 2 select" option for turning on/off channel two's measurements display
-Returns: Nothing (shows on display)
-Parameters: None
+/*
+Name: writeFrameBMP
+Description: Writes the framebuffer to the SD card as a BMP image
+Returns: bool (true if written)
+Parameters: const char* "name"
 */
-  void displayMeas2Select(){
-    oScopeImage.fillThickRect({110, 210, 0, 40}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
+bool writeFrameBMP(const char* name){
+  uint8_t header[FRAME_BMP_HEADER];
+  frameBMPHeader(header);
+
+  SD.remove(name);
+  File file = SD.open(name, FILE_WRITE);
+  if(!file){
+    return false;
+  }
+  bool ok = file.write(header, sizeof(header)) == sizeof(header);
+  ok = ok && file.write((const uint8_t*)fb, sizeof(fb)) == sizeof(fb);
+  file.close();
+  return ok;
+}
 
-    oScopeImage.drawText("Meas 2: ", {114, 25}, CHANGE_VALUE_FONT, WHITE); 
-    if(showMeas2 == true){
-      oScopeImage.drawText("ON", {175, 25}, CHANGE_VALUE_FONT, WHITE); 
-    }else{
-      oScopeImage.drawText("OFF", {175, 25}, CHANGE_VALUE_FONT, WHITE); 
+/*
+Name: writeFrameDiff
+Description: Compares the framebuffer with a golden frame BMP on the SD card, a row at a time, and writes a diff BMP: pixels that match are
+shown at half brightness, pixels that differ in FRAME_DIFF_COLOR.
+Returns: int "differing pixels" (-1 if the golden frame couldn't be read or the diff written)
+Parameters: const char* "goldenName", const char* "diffName"
+*/
+int writeFrameDiff(const char* goldenName, const char* diffName){
+  uint8_t header[FRAME_BMP_HEADER];
+  uint16_t golden[LX];
+  uint16_t diff[LX];
+  int differing = 0;
+
+  File goldenFile = SD.open(goldenName, FILE_READ);
+  if(!goldenFile){
+    return -1;
+  }
+  SD.remove(diffName);
+  File diffFile = SD.open(diffName, FILE_WRITE);
+  if(!diffFile){
+    goldenFile.close();
+    return -1;
+  }
+
+  frameBMPHeader(header);
+  bool ok = goldenFile.seek(FRAME_BMP_HEADER) && diffFile.write(header, sizeof(header)) == sizeof(header);
+  for(int y = 0; y < LY && ok; y++){
+    const uint16_t* row = &fb[y*LX];
+    ok = goldenFile.read(golden, sizeof(golden)) == (int)sizeof(golden);
+    for(int x = 0; x < LX; x++){
+      if(golden[x] == row[x]){
+        diff[x] = (row[x] >> 1) & 0x7BEF; // Halve each color field
+      }else{
+        diff[x] = FRAME_DIFF_COLOR.val;
+        differing++;
+      }
     }
+    ok = ok && diffFile.write((const uint8_t*)diff, sizeof(diff)) == sizeof(diff);
   }
 
+  goldenFile.close();
+  diffFile.close();
+  return ok ? differing : -1;
+}
+
+// Every global that changes what renderFrame draws (settings, menu state, overlays and what they show), saved before the frame scenarios pin
+// them and put back afterwards. A setting added to the display belongs here, or a unit set differently fails against the golden frames.
+struct DisplayState {
+  CalibrationData cal;
+  double VScale[NUM_CHANNELS];
+  int VPos[NUM_CHANNELS];
+  bool AC[NUM_CHANNELS];
+  bool showWave[NUM_CHANNELS];
+  bool showMeas[NUM_CHANNELS];
+  bool showStats;
+  MeasStats stats[NUM_STATS];
+  double HScale;
+  int acqMode, procMode, avgLog2, interpMode;
+  int triggerType, triggerSource, triggerMenuItem;
+  double triggerVoltage, triggerHysteresis, triggerUpper, triggerTime1, triggerTime2;
+  int displayMode, zoomOffset;
+  bool zoomEncoders;
+  int cursorMode, cursorChannel, cursorT1, cursorT2;
+  double cursorV1, cursorV2;
+  int mathOp;
+  double mathVScale;
+  int decodeProtocol, decodeBaudIndex;
+  double decodeThreshold;
+  bool showMenu;
+  int menuSelected, menuSelecting, chDataSelected, chDataSelecting, scaleChannel;
+  bool freqCounterOn, acquisitionRunning, singleArmed;
+  MaskData mask;
+  bool maskValid, maskTesting, maskStopOnFail, maskLastFailed;
+  int maskMenuItem, maskFailColumn;
+  uint32_t maskPassCount, maskFailCount;
+  double maskTolerance;
+  RefSlot refs[REF_NUM_SLOTS];
+  int refSlot, refAction;
+};
 
 /*
-Name: displayMenuSelector
-Description: Displays which menu option the user is currently selected to by displaying a red box around their selection
-Returns: Nothing (shows on display)
-Parameters: None
+Name: saveDisplayState
+Description: Copies every display-affecting global into a DisplayState
+Returns: Nothing (fills the provided struct)
+Parameters: DisplayState& "state"
 */
-  void displayMenuSelector(){
-    // Make the following rectangle's coordinates dependent on the menu-selecting variable
-    if(menuSelecting == 0){
-      oScopeImage.drawRect({25, 93, 30, 190}, tgx::RGB32_Red);
+void saveDisplayState(DisplayState& state){
+  state.cal = calData;
+  for(int ch = 0; ch < NUM_CHANNELS; ch++){
+    state.VScale[ch] = (ch == 0) ? CH1_VScale : CH2_VScale;
+    state.VPos[ch] = (ch == 0) ? CH1_VPos : CH2_VPos;
+    state.AC[ch] = (ch == 0) ? CH1_AC : CH2_AC;
+    state.showWave[ch] = (ch == 0) ? showWave1 : showWave2;
+    state.showMeas[ch] = (ch == 0) ? showMeas1 : showMeas2;
+  }
+  state.showStats = showStats;
+  memcpy(state.stats, measStats, sizeof(measStats));
+  state.HScale = HScale;
+  state.acqMode = acqMode;
+  state.procMode = procMode;
+  state.avgLog2 = avgLog2;
+  state.interpMode = interpMode;
+  state.triggerType = triggerType;
+  state.triggerSource = triggerSource;
+  state.triggerMenuItem = triggerMenuItem;
+  state.triggerVoltage = triggerVoltage;
+  state.triggerHysteresis = triggerHysteresis;
+  state.triggerUpper = triggerUpper;
+  state.triggerTime1 = triggerTime1;
+  state.triggerTime2 = triggerTime2;
+  state.displayMode = displayMode;
+  state.zoomOffset = zoomOffset;
+  state.zoomEncoders = zoomEncoders;
+  state.cursorMode = cursorMode;
+  state.cursorChannel = cursorChannel;
+  state.cursorT1 = cursorT1;
+  state.cursorT2 = cursorT2;
+  state.cursorV1 = cursorV1;
+  state.cursorV2 = cursorV2;
+  state.mathOp = mathOp;
+  state.mathVScale = mathVScale;
+  state.decodeProtocol = decodeProtocol;
+  state.decodeBaudIndex = decodeBaudIndex;
+  state.decodeThreshold = decodeThreshold;
+  state.showMenu = showMenu;
+  state.menuSelected = menuSelected;
+  state.menuSelecting = menuSelecting;
+  state.chDataSelected = chDataSelected;
+  state.chDataSelecting = chDataSelecting;
+  state.scaleChannel = scaleChannel;
+  state.freqCounterOn = freqCounterOn;
+  state.acquisitionRunning = acquisitionRunning;
+  state.singleArmed = singleArmed;
+  state.mask = maskData;
+  state.maskValid = maskValid;
+  state.maskTesting = maskTesting;
+  state.maskStopOnFail = maskStopOnFail;
+  state.maskLastFailed = maskLastFailed;
+  state.maskMenuItem = maskMenuItem;
+  state.maskFailColumn = maskFailColumn;
+  state.maskPassCount = maskPassCount;
+  state.maskFailCount = maskFailCount;
+  state.maskTolerance = maskTolerance;
+  memcpy(state.refs, refSlots, sizeof(refSlots));
+  state.refSlot = refSlot;
+  state.refAction = refAction;
+}
 
-    }else{
-      oScopeImage.drawRect({32, 86, 61+(menuSelecting-1)*47, 76+(menuSelecting-1)*47}, tgx::RGB32_Red);
-    }
+/*
+Name: restoreDisplayState
+Description: Puts every display-affecting global back as saveDisplayState found it, rebuilding the voltage tables and math coefficients that
+follow from them
+Returns: Nothing (updates global variables)
+Parameters: const DisplayState& "state"
+*/
+void restoreDisplayState(const DisplayState& state){
+  calData = state.cal;
+  CH1_VScale = state.VScale[0];
+  CH2_VScale = state.VScale[1];
+  CH1_VPos = state.VPos[0];
+  CH2_VPos = state.VPos[1];
+  CH1_AC = state.AC[0];
+  CH2_AC = state.AC[1];
+  showWave1 = state.showWave[0];
+  showWave2 = state.showWave[1];
+  showMeas1 = state.showMeas[0];
+  showMeas2 = state.showMeas[1];
+  showStats = state.showStats;
+  memcpy(measStats, state.stats, sizeof(measStats));
+  HScale = state.HScale;
+  if(acqMode != state.acqMode){
+    setAcquisitionMode(state.acqMode);
   }
+  buildVoltageLUTs();
+  procMode = state.procMode;
+  avgLog2 = state.avgLog2;
+  interpMode = state.interpMode;
+  triggerType = state.triggerType;
+  triggerSource = state.triggerSource;
+  triggerMenuItem = state.triggerMenuItem;
+  triggerVoltage = state.triggerVoltage;
+  triggerHysteresis = state.triggerHysteresis;
+  triggerUpper = state.triggerUpper;
+  triggerTime1 = state.triggerTime1;
+  triggerTime2 = state.triggerTime2;
+  displayMode = state.displayMode;
+  zoomOffset = state.zoomOffset;
+  zoomEncoders = state.zoomEncoders;
+  cursorMode = state.cursorMode;
+  cursorChannel = state.cursorChannel;
+  cursorT1 = state.cursorT1;
+  cursorT2 = state.cursorT2;
+  cursorV1 = state.cursorV1;
+  cursorV2 = state.cursorV2;
+  setMathOp(state.mathOp);
+  mathVScale = state.mathVScale;
+  decodeProtocol = state.decodeProtocol;
+  decodeBaudIndex = state.decodeBaudIndex;
+  decodeThreshold = state.decodeThreshold;
+  showMenu = state.showMenu;
+  menuSelected = state.menuSelected;
+  menuSelecting = state.menuSelecting;
+  chDataSelected = state.chDataSelected;
+  chDataSelecting = state.chDataSelecting;
+  scaleChannel = state.scaleChannel;
+  freqCounterOn = state.freqCounterOn;
+  acquisitionRunning = state.acquisitionRunning;
+  singleArmed = state.singleArmed;
+  maskData = state.mask;
+  maskValid = state.maskValid;
+  maskTesting = state.maskTesting;
+  maskStopOnFail = state.maskStopOnFail;
+  maskLastFailed = state.maskLastFailed;
+  maskMenuItem = state.maskMenuItem;
+  maskFailColumn = state.maskFailColumn;
+  maskPassCount = state.maskPassCount;
+  maskFailCount = state.maskFailCount;
+  maskTolerance = state.maskTolerance;
+  memcpy(refSlots, state.refs, sizeof(refSlots));
+  refSlot = state.refSlot;
+  refAction = state.refAction;
+}
 
 /*
-Name: displayChannelsSelector
-Description: Displays which channel menu (menu >> channels) the user is currently selecting by displaying a red box around their selection
-Returns: Nothing (shows on display)
+Name: pinDisplayState
+Description: Sets the display-affecting globals the frame scenarios don't set themselves to fixed values: the ideal calibration (so frames
+don't depend on this unit's), dual-channel acquisition and the defaults of everything else
+Returns: Nothing (updates global variables)
 Parameters: None
 */
-  void displayChannelsSelector(){
-    // Make the following rectangle's coordinates dependent on the channels-selecting variable
-    if(chDataSelecting == 0){
-      oScopeImage.drawRect({99, 178, 30, 190}, tgx::RGB32_Red);
-
-    }else{
-      oScopeImage.drawRect({102, 175, 52+(chDataSelecting-1)*32, 67+(chDataSelecting-1)*32}, tgx::RGB32_Red);
-    }
+void pinDisplayState(){
+  if(acqMode != ACQ_DUAL){
+    setAcquisitionMode(ACQ_DUAL);
   }
+  resetCalibration();
+  buildVoltageLUTs();
+  CH1_VScale = CH2_VScale = 5;
+  CH1_VPos = CH2_VPos = 0;
+  CH1_AC = CH2_AC = false;
+  showWave1 = showWave2 = true;
+  HScale = 50E-6;
+  procMode = PROC_NORMAL;
+  avgLog2 = 4;
+  interpMode = INTERP_SINC;
+  triggerMenuItem = TRIG_ITEM_LEVEL;
+  triggerVoltage = 0.5;
+  triggerHysteresis = 0;
+  triggerUpper = 2.5;
+  triggerTime1 = 10E-6;
+  triggerTime2 = 50E-6;
+  zoomEncoders = false;
+  cursorT1 = 80;
+  cursorT2 = 240;
+  cursorV1 = 1.0;
+  cursorV2 = -1.0;
+  cursorChannel = 0;
+  mathVScale = 10;
+  decodeProtocol = DECODE_OFF;
+  decodeBaudIndex = 4;
+  decodeThreshold = 1.65;
+  scaleChannel = 0;
+  freqCounterOn = false;
+  acquisitionRunning = true;
+  singleArmed = false;
+  maskStopOnFail = false;
+  maskMenuItem = MASK_ITEM_TEST;
+  maskTolerance = 0.2;
+  for(int slot = 0; slot < REF_NUM_SLOTS; slot++){
+    refSlots[slot].valid = false;
+    refSlots[slot].shown = false;
+  }
+  refSlot = 0;
+  refAction = REF_ACT_SAVE_CH1;
+}
 
 /*
-Name: displayChannelsBlock 
-Description: Displays the channels menu block with its four options (show wave 1, wave 2, meas 1, meas 2). Calls the selector display function as well.
-Returns: Nothing (shows on display)
-Parameters: None
+Name: setupFrameScenario
+Description: Puts the scope into a scenario's state: synthesizes its standard waveforms, sets up the menu and overlays, and runs the pipeline
+up to (not including) rendering
+Returns: Nothing (updates global variables)
+Parameters: const FrameScenario& "scenario"
 */
-  void displayChannelsBlock(){
-    oScopeImage.fillThickRect({99, 178, 30, 190}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1); // gray filled, 2 pixels thick red rectangle, 0% opacity (main menu box)
-    oScopeImage.fillThickRect({102, 175, 52+(0)*32, 67+(0)*32}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
-    oScopeImage.fillThickRect({102, 175, 52+(1)*32, 67+(1)*32}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
-    oScopeImage.fillThickRect({102, 175, 52+(2)*32, 67+(2)*32}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
-    oScopeImage.fillThickRect({102, 175, 52+(3)*32, 67+(3)*32}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
+void setupFrameScenario(const FrameScenario& scenario){
+  // {CH1 square, frequency, p-p, level, CH2 square, frequency, p-p, level} per FRAME_WAVE_ value
+  const double waves[][8] = {
+    {0, 1000,  4.0, 0,    1, 2500,  2.0, 1.0},
+    {1, 10000, 1.0, -1.0, 0, 20000, 6.0, 0},
+    {0, 0,     0,   0,    0, 0,     0,   0},
+  };
+  const double* wave = waves[scenario.wave];
+
+  synthRecord(0, wave[0] != 0, wave[1], wave[2], wave[3]);
+  synthRecord(1, wave[4] != 0, wave[5], wave[6], wave[7]);
+
+  showMeas1 = showMeas2 = (scenario.overlays & FRAME_SHOW_MEAS) != 0;
+  showStats = (scenario.overlays & FRAME_SHOW_STATS) != 0;
+  cursorMode = CURSOR_OFF;
+  if(scenario.overlays & FRAME_SHOW_TCURSORS){
+    cursorMode = CURSOR_TIME;
+  }
+  if(scenario.overlays & FRAME_SHOW_VCURSORS){
+    cursorMode = CURSOR_VOLT;
+  }
+  setMathOp((scenario.overlays & FRAME_SHOW_MATH) ? MATH_SUB : MATH_OFF);
+  displayMode = DISPLAY_YT;
+  if(scenario.overlays & FRAME_SHOW_XY){
+    displayMode = DISPLAY_XY;
+  }
+  if(scenario.overlays & FRAME_SHOW_ZOOM){
+    displayMode = DISPLAY_ZOOM;
+  }
+  zoomOffset = (scenario.overlays & FRAME_SHOW_ZOOM) ? FRAME_ZOOM_OFFSET : 0;
+  triggerType = scenario.trigType;
+  triggerSource = scenario.trigSource;
 
-    displayChannelsSelector();
+  showMenu = (scenario.menu >= 0);
+  menuSelected = (scenario.menu > 0) ? scenario.menu : 0;
+  menuSelecting = (scenario.menu > 0) ? scenario.menu : 1;
+  chDataSelected = scenario.subMenu;
+  chDataSelecting = (scenario.subMenu > 0) ? scenario.subMenu : 1;
 
-    /* Text of each option....*/
-    oScopeImage.drawText("Show Wave 1", {105, 64}, MENU_FONT, MENU_COLOR);
-    oScopeImage.drawText("Show Wave 2", {105, 96}, MENU_FONT, MENU_COLOR);
-    oScopeImage.drawText("Show Meas 1", {105, 128}, MENU_FONT, MENU_COLOR);
-    oScopeImage.drawText("Show Meas 2", {105, 160}, MENU_FONT, MENU_COLOR);
+  resetStats();
+  updateVoltageData();
+  extractPlottingData();
+  addMeasStats(); // As the scope counts a newly acquired record
+  if(displayMode == DISPLAY_ZOOM){
+    extractZoomOverview();
+    extractZoomColumns();
+  }
+
+  // Channel 2's trace as a reference, so it is drawn against channel 1's scale and position
+  RefSlot& ref = refSlots[0];
+  ref.valid = ref.shown = (scenario.overlays & FRAME_SHOW_REF) != 0;
+  if(ref.valid){
+    memcpy(ref.trace, sigRaw[1], sizeof(ref.trace));
+    ref.channel = 0;
+    ref.sampleDt = sampleDt;
+    ref.stride = plotStride;
+    ref.hasRecord = false;
+    ref.mappedLUTBuild = -1;
   }
 
+  // A mask made from this record (with the usual tolerance), as it would stand after a run of tests
+  maskTesting = (scenario.overlays & FRAME_SHOW_MASK) != 0;
+  maskValid = maskTesting;
+  if(maskTesting){
+    buildMask();
+    maskPassCount = FRAME_MASK_PASSES;
+    maskFailCount = FRAME_MASK_FAILS;
+    maskLastFailed = false;
+  }
+}
 
 /*
-Name: displayMenuBlock
-Description: Displays the main menu's block of options (Channels, Trigger, and Scaling). Calls the menu selector display function as well.
-Returns: Nothing (shows on display)
-Parameters: None
+Name: readGoldenHashes
+Description: Reads the recorded golden frame hashes from the SD card
+Returns: bool (true if hashes for the current set of scenarios were read)
+Parameters: GoldenHashes& "golden"
 */
-  void displayMenuBlock(){
-    // Switch case needs to happen first to ensure that lower-level selections don't have the menu shown in frame
-    
-    oScopeImage.fillThickRect({25, 93, 30, 190}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1); // gray filled, 2 pixels thick red rectangle, 0% opacity (main menu box)
-    oScopeImage.fillThickRect({32, 86, 61, 76}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
-    oScopeImage.fillThickRect({32, 86, 108, 123}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
-    oScopeImage.fillThickRect({32, 86, 155, 170}, 2, tgx::RGB32_Gray, tgx::RGB32_White, 1);
+bool readGoldenHashes(GoldenHashes& golden){
+  if(!sdAvailable){
+    return false;
+  }
 
-    displayMenuSelector();
+  File file = SD.open(GOLDEN_FILE, FILE_READ);
+  if(!file){
+    return false;
+  }
+  bool ok = file.read(&golden, sizeof(golden)) == (int)sizeof(golden);
+  file.close();
+  return ok && golden.magic == GOLDEN_MAGIC && golden.count == FRAME_NUM_SCENARIOS;
+}
 
-    /* Text of each option....*/
-    oScopeImage.drawText("Channels", {37, 73}, MENU_FONT, MENU_COLOR);
-    oScopeImage.drawText("Trigger", {41, 120}, MENU_FONT, MENU_COLOR);
-    oScopeImage.drawText("Scaling", {41, 167}, MENU_FONT, MENU_COLOR);
+/*
+Name: testFrameRegression
+Description: Used for testing & debugging. Renders every frame scenario with fixed settings and the ideal calibration (so frames don't depend
+on this unit's calibration or settings, see pinDisplayState), and reports each frame's CRC-32 and render time. When recording, the hashes and
+golden frames (GOLDnn.BMP) are saved to the SD card; otherwise each hash is compared with the recorded one, and a failing frame is saved (FAILnn.BMP) along with a diff
+against its golden frame (DIFFnn.BMP). Everything the scenarios change is restored afterwards.
+Returns: Nothing (prints to terminal)
+Parameters: bool "record"
+*/
+void testFrameRegression(bool record){
+  GoldenHashes golden;
+  bool haveGolden = !record && readGoldenHashes(golden);
+  bool allPass = true;
+
+  // Save everything the scenarios touch, and pin what they don't set themselves
+  DisplayState saved;
+  saveDisplayState(saved);
+  pinDisplayState();
+
+  Serial.println("Scenario, CRC-32, render (us), result");
+  for(int i = 0; i < FRAME_NUM_SCENARIOS; i++){
+    char name[20]; // Room for any int, though GOLDnn.BMP only ever needs two digits
+    setupFrameScenario(frameScenarios[i]);
+
+    uint32_t start = ARM_DWT_CYCCNT;
+    renderFrame();
+    uint32_t cycles = ARM_DWT_CYCCNT - start;
+    uint32_t crc = calCRC32((const uint8_t*)fb, sizeof(fb));
+
+    Serial.print(frameScenarios[i].name);
+    Serial.print(", ");
+    Serial.print(crc, HEX);
+    Serial.print(", ");
+    Serial.print(cycles/(F_CPU_ACTUAL/1E6), 1);
+    Serial.print(", ");
+
+    if(record){
+      golden.crc[i] = crc;
+      snprintf(name, sizeof(name), "GOLD%02d.BMP", i);
+      Serial.println((sdAvailable && writeFrameBMP(name)) ? "recorded" : "recorded (frame not saved)");
+    }else if(!haveGolden){
+      Serial.println("no golden hash");
+    }else if(crc == golden.crc[i]){
+      Serial.println("PASS");
+    }else{
+      allPass = false;
+      snprintf(name, sizeof(name), "FAIL%02d.BMP", i);
+      writeFrameBMP(name);
+      char goldenName[20];
+      snprintf(goldenName, sizeof(goldenName), "GOLD%02d.BMP", i);
+      snprintf(name, sizeof(name), "DIFF%02d.BMP", i);
+      int differing = writeFrameDiff(goldenName, name);
+      Serial.print("FAIL (");
+      if(differing >= 0){
+        Serial.print(differing);
+        Serial.print(" pixels differ, see ");
+        Serial.print(name);
+      }else{
+        Serial.print("no golden frame to diff against");
+      }
+      Serial.println(")");
+    }
   }
 
+  if(record){
+    golden.magic = GOLDEN_MAGIC;
+    golden.count = FRAME_NUM_SCENARIOS;
+    bool saved = false;
+    if(sdAvailable){
+      SD.remove(GOLDEN_FILE);
+      File file = SD.open(GOLDEN_FILE, FILE_WRITE);
+      if(file){
+        saved = file.write((const uint8_t*)&golden, sizeof(golden)) == sizeof(golden);
+        file.close();
+      }
+    }
+    Serial.println(saved ? "Golden frames recorded" : "Golden hashes not saved (no SD card)");
+  }else if(haveGolden){
+    Serial.println(allPass ? "Frame regression test PASSED" : "Frame regression test FAILED");
+  }else{
+    Serial.println("No golden hashes recorded (run \"testframes record\" first)");
+  }
+
+  // Put everything back
+  restoreDisplayState(saved);
+}
+
+
+// -----------------------------------
+/* END Frame Regression Functions */
+// -----------------------------------
+
+
+
+
+//--------------------------
+/* BEGIN Run Control Functions */
+// -------------------------
 
 /*
-Name: displayMenu
-Description: The main menu-displaying function. Uses a switchcase that is based on the global menu-selecting variables to display which option the
-user is selected on, as well any necessary information related to that option.
-Returns: Nothing (shows on display)
+Name: updateRecordStages
+Description: Brings the processing of the current record up to date, running each stage only if one of its inputs changed since it last ran:
+the voltage/trigger stage (updateVoltageData) on a new record, calibration or trigger setting; the plotting stage (extractPlottingData) after
+the voltage stage or on a new HScale, interpolation mode, math operation or math expression; the protocol decoder on a new record or decode setting; and, when
+shown, the zoom panes (extractZoomColumns) after the plotting stage or on a pan. While running every record is new, so everything runs. While stopped, rescaling, re-triggering or panning the held record
+only redoes what depends on it (VScale, position and coupling only change the count -> pixel tables, which are rebuilt as they are drawn).
+Returns: Nothing (updates global variables)
 Parameters: None
 */
-  void displayMenu(){
-    if(menuSelected > 0){
-      //switch case of channels, scaling, and trigger
-      switch(menuSelected){
-        case 1: //Channels
-          if(chDataSelected > 0){
-            switch(chDataSelected){
-              case 1:
-                displayWave1Select();
-              break;
-
-              case 2:
-                displayWave2Select();
-              break;
+void updateRecordStages(){
+  double trigSettings[5] = {triggerVoltage, triggerHysteresis, triggerUpper, triggerTime1, triggerTime2};
 
-              case 3:
-                displayMeas1Select();
-              break;
+  if(voltageStageRecord != recordVersion || voltageStageLUTVersion != voltageLUTVersion || voltageStageTrigType != triggerType
+     || voltageStageTrigSource != triggerSource || memcmp(trigSettings, voltageStageTrigSettings, sizeof(trigSettings)) != 0){
+    updateVoltageData();
+    voltageStageRecord = recordVersion;
+    voltageStageLUTVersion = voltageLUTVersion;
+    voltageStageTrigType = triggerType;
+    voltageStageTrigSource = triggerSource;
+    memcpy(voltageStageTrigSettings, trigSettings, sizeof(trigSettings));
+    voltageStageRuns++;
+  }
 
-              case 4:
-                displayMeas2Select();
-              break;
-            }
-          }else{
-            displayMenuBlock();
-            displayChannelsBlock();
-          }
-        break;
+  if(plotStageVoltageRuns != voltageStageRuns || plotStageHScale != HScale || plotStageInterpMode != interpMode || plotStageMathVersion != mathVersion){
+    extractPlottingData();
+    plotStageVoltageRuns = voltageStageRuns;
+    plotStageHScale = HScale;
+    plotStageInterpMode = interpMode;
+    plotStageMathVersion = mathVersion;
+    plotStageRuns++;
+  }
 
-        case 2: // Trigger Voltage Selection
-          displayTriggerSelect();
-        break;
+  if(decodeStageRecord != recordVersion || decodeStageLUTVersion != voltageLUTVersion || decodeStageProtocol != decodeProtocol
+     || decodeStageBaudIndex != decodeBaudIndex || decodeStageThreshold != decodeThreshold){
+    runProtocolDecoder();
+    decodeStageRecord = recordVersion;
+    decodeStageLUTVersion = voltageLUTVersion;
+    decodeStageProtocol = decodeProtocol;
+    decodeStageBaudIndex = decodeBaudIndex;
+    decodeStageThreshold = decodeThreshold;
+  }
 
-        case 3:
-          displayScalingSelect();
-        break;
-      }
-      
-    }else{
-      displayMenuBlock();
+  if(displayMode != DISPLAY_ZOOM){
+    zoomOverviewStageRecord = 0xFFFFFFFF; // Not shown, so worked out afresh when it next is
+    zoomStagePlotRuns = 0xFFFFFFFF;
+  }else{
+    if(zoomOverviewStageRecord != recordVersion){
+      extractZoomOverview();
+      zoomOverviewStageRecord = recordVersion;
+    }
+    if(zoomStagePlotRuns != plotStageRuns || zoomStageOffset != zoomOffset){
+      extractZoomColumns();
+      zoomStagePlotRuns = plotStageRuns;
+      zoomStageOffset = zoomOffset;
     }
   }
+}
 
+/*
+Name: recordTriggered
+Description: Whether the trigger was found in the current record. A free-running record always counts.
+Returns: bool
+Parameters: None
+*/
+bool recordTriggered(){
+  return trigIndex > 0 || triggerSource == TRIG_SRC_FREE;
+}
 
 /*
-Name: displayChannels
-Description: Depending on the boolean value of the global variables for channel 1 & 2, calls/doesn't call the functions for displaying
-the waveforms and measurements of each channel.
-Returns: Nothing (shows on display)
+Name: completeSingle
+Description: Ends an armed single acquisition once a record has triggered (after that record has been tested, counted and drawn like any
+other), or once something else (the mask test's stop-on-fail) has stopped acquisition.
+Returns: Nothing (updates global variables)
 Parameters: None
 */
-  void displayChannels(){
-    if(showMeas1){
-      displayCH1Meas();
-    }
-    if(showMeas2){
-      displayCH2Meas();
-    }
-    if(showWave1){
-      displayCH1Signal();
-    }
-    if(showWave2){
-      displayCH2Signal();
-    }
+void completeSingle(){
+  if(!singleArmed || (acquisitionRunning && !recordTriggered())){
+    return;
   }
+  acquisitionRunning = false;
+  singleArmed = false;
+}
 
+//--------------------------
+/* END Run Control Functions */
+// -------------------------
 
-  void displayUIStates(){
-    button1.update();
-    button2.update();
-    button3.update();
-    button4.update();
 
-    oScopeImage.drawText("E1: ", {170, 100}, SCALE_FONT, WHITE);
-    oScopeImage.drawText(doubleToCharArr(encoder1.read()), {200, 100}, SCALE_FONT, WHITE);
 
-    oScopeImage.drawText("E2: ", {170, 120}, SCALE_FONT, WHITE);
-    oScopeImage.drawText(doubleToCharArr(encoder2.read()), {200, 120}, SCALE_FONT, WHITE);
 
-    oScopeImage.drawText("B1: ", {170, 140}, SCALE_FONT, WHITE);
-    oScopeImage.drawText(intToCharArr(button1.fell()), {200, 140}, SCALE_FONT, WHITE);
+//--------------------------
+/* BEGIN Serial Command Functions */
+// -------------------------
 
-     oScopeImage.drawText("B2: ", {170, 160}, SCALE_FONT, WHITE);
-    oScopeImage.drawText(intToCharArr(button2.fell()), {200, 160}, SCALE_FONT, WHITE);
+/*
+Name: handleSerialCommands
+Description: Reads one line from the serial monitor (if one is waiting) and runs the matching maintenance command. Not available in DUMMY mode,
+where the serial monitor is used to fake the UI inputs.
+  cal1 / cal2  - run the interactive calibration for channel 1 / 2
+  calreset     - forget the stored calibration (back to ideal values)
+  calprint     - print the calibration tables
+  testpix      - check the count -> pixel tables against the floating point mapping
+  benchpix     - time the floating point mapping against the count -> pixel tables
+  maskfail     - print the last capture that failed the mask test
+  testmask     - check the mask test's pass/fail and timebase checks against synthesized records
+  autoset      - set the scales, timebase and trigger from the current signals
+  testautoset  - check autoset against synthesized signals
+  stats        - print the running statistics (count, mean, sigma, min, max) of every measurement
+  benchavg     - report the cost and effective bits of every averaging/high-res setting (ground channel 1 first)
+  testdecode   - check the UART/SPI/I2C decoders against synthesized bus transfers
+  testtrigger  - check the pulse width, runt, timeout and slew triggers against a synthesized record
+  benchinterp  - report the cost and error of each interpolation mode at strides below one sample
+  run          - start acquiring continuously
+  stop         - stop, holding the current record (it can still be rescaled, re-triggered, panned and measured)
+  single       - acquire until a record triggers, then stop on it
+  math <expr>  - set the math channel to an expression in A and B (e.g. "math (A-B)*2"), or "math off"
+  capture start / stop / clear - record processed acquisitions to CAPTURE.BIN on the SD card / stop / delete it
+  capture layout <n>           - pack the next capture's records as uint16 (0), processed counts (1, default) or ADC counts (2)
+  capture save <n> / load <n>  - copy the capture to / from slot n (0-9) on the SD card
+  capture send / receive       - copy the capture to / from the serial port
+  replay on / off              - take records from the capture instead of the ADCs
+The tests and benchmarks (test..., bench...) and autoset leave records of their own in the sample store, so they are refused while a record
+is held.
+Returns: Nothing
+Parameters: None
+*/
+void handleSerialCommands(){
+  #if !DUMMY
+  if(Serial.available() == 0){
+    return;
+  }
 
-     oScopeImage.drawText("B3: ", {170, 180}, SCALE_FONT, WHITE);
-    oScopeImage.drawText(intToCharArr(button3.fell()), {200, 180}, SCALE_FONT, WHITE);
+  String command = Serial.readStringUntil('\n');
+  command.trim();
 
-     oScopeImage.drawText("B4: ", {170, 200}, SCALE_FONT, WHITE);
-    oScopeImage.drawText(intToCharArr(button4.fell()), {200, 200}, SCALE_FONT, WHITE);
+  if(!acquisitionRunning && (command.startsWith("test") || command.startsWith("bench") || command == "autoset")){
+    Serial.println("Stopped: tests, benchmarks and autoset overwrite the held record (\"run\" first)");
+    return;
+  }
 
+  if(command == "cal1"){
+    runCalibration(0);
+  }else if(command == "cal2"){
+    runCalibration(1);
+  }else if(command == "calreset"){
+    resetCalibration();
+    saveCalibration();
+    buildVoltageLUTs();
+    Serial.println("Calibration reset");
+  }else if(command == "calprint"){
+    printCalibration();
+  }else if(command == "math off"){
+    setMathOp(MATH_OFF);
+  }else if(command.startsWith("math ")){
+    String expression = command.substring(5);
+    float poly[MATH_TERMS];
+    if(expression.length() < (int)sizeof(mathExprText) && compileMathExpression(expression.c_str(), poly)){
+      memcpy(mathExprPoly, poly, sizeof(poly));
+      strcpy(mathExprText, expression.c_str());
+      setMathOp(MATH_EXPR);
+    }else{
+      Serial.println("Math expression not understood (A, B, numbers, + - * /, up to second order)");
+    }
+  }else if(command == "capture start"){
+    Serial.println(startCapture() ? "Capturing to " CAPTURE_FILE : "Capture not started");
+  }else if(command == "capture stop"){
+    stopCapture();
+  }else if(command == "capture clear"){
+    stopCapture();
+    setReplay(false);
+    if(sdAvailable){
+      SD.remove(CAPTURE_FILE);
+    }
+  }else if(command.startsWith("capture layout ") && command.length() == 16){
+    Serial.println(setCaptureLayout(command.c_str()[15] - '0') ? "Capture layout set" : "Capture layout not set");
+  }else if(command.startsWith("capture save ") && command.length() == 14){
+    Serial.println(saveCapture(command.c_str()[13] - '0') ? "Capture saved" : "Capture not saved");
+  }else if(command.startsWith("capture load ") && command.length() == 14){
+    Serial.println(loadCapture(command.c_str()[13] - '0') ? "Capture loaded" : "No capture loaded");
+  }else if(command == "capture send"){
+    sendCapture();
+  }else if(command == "capture receive"){
+    Serial.println(receiveCapture() ? "Capture received" : "No capture received");
+  }else if(command == "replay on"){
+    Serial.println(setReplay(true) ? "Replaying capture" : "No capture to replay");
+  }else if(command == "replay off"){
+    setReplay(false);
+  }else if(command == "benchreplay"){
+    benchmarkReplay(false);
+  }else if(command == "benchreplay frames"){
+    benchmarkReplay(true);
+  }else if(command == "benchinterp"){
+    benchmarkInterpolation();
+  }else if(command == "testtrigger"){
+    testTriggers();
+  }else if(command == "testdsp"){
+    testDSPKernels();
+  }else if(command == "testframes"){
+    testFrameRegression(false);
+  }else if(command == "testframes record"){
+    testFrameRegression(true);
+  }else if(command == "benchstore"){
+    benchmarkSampleStore();
+  }else if(command == "benchavg"){
+    benchmarkAveraging();
+  }else if(command == "run"){
+    acquisitionRunning = true;
+    singleArmed = false;
+  }else if(command == "stop"){
+    acquisitionRunning = false;
+    singleArmed = false;
+  }else if(command == "single"){
+    updateRunControl(false, true);
+  }else if(command == "autoset"){
+    autosetPending = true;
+  }else if(command == "testautoset"){
+    testAutoset();
+  }else if(command == "stats"){
+    printStats();
+  }else if(command == "maskfail"){
+    printMaskFailure();
+  }else if(command == "testmask"){
+    testMaskTest();
+  }else if(command == "testdecode"){
+    testProtocolDecoders();
+  }else if(command == "testpix"){
+    verifyPixelLUTs();
+  }else if(command == "benchpix"){
+    benchmarkPixelMapping();
+  }else{
+    Serial.print("Unknown command: ");
+    Serial.println(command);
+  }
+  #endif
 }
 
 //--------------------------
-/* END Display Functions */
+/* END Serial Command Functions */
 // -------------------------
 
 
@@ -1663,9 +9232,21 @@ void setup(){
   adc->adc1->setSamplingSpeed(ADC_SAMPLING_SPEED::VERY_HIGH_SPEED);
   adc->adc1->setAveraging(ADC_OVERSAMPLING);
   adc->startSynchronizedSingleRead(CH1_PIN, CH2_PIN);
+
+  // Interleaving needs the channel's pin to be reachable from both ADCs
+  interleaveCH1Available = adc->adc0->checkPin(CH1_PIN) && adc->adc1->checkPin(CH1_PIN);
+  interleaveCH2Available = adc->adc0->checkPin(CH2_PIN) && adc->adc1->checkPin(CH2_PIN);
   /* ADC setup code end*/
 
+  loadCalibration();
+  loadMask();
+  sdAvailable = SD.begin(BUILTIN_SDCARD);
+  buildVoltageLUTs();
+  buildSincTable();
+
+  updateAcquisitionMode();
   sampleChannels();
+  processAcquisition();
   updateVoltageData();
   extractPlottingData();
 
@@ -1733,15 +9314,40 @@ void loop(){
   // UITerminalTest();
   #endif
 
+  handleSerialCommands();
+  updateFrequencyCounter();
+  updateExternalTrigger();
+
   // ----------- ADC Loop ------------
-  bound(HScale, HScaleMin, HScaleMax);
+  if(!replaying && acquisitionRunning){
+    updateAcquisitionMode(); // A replayed capture keeps the mode it was sampled in, and a held record the one it was acquired in
+  }
+  if(autosetPending){
+    autosetPending = false;
+    runAutoset();
+    recordVersion++; // Autoset acquires records of its own
+  }
+  bound(HScale, shortestHScale(), HScaleMax);
   
   // If in regular mode, sample Teensy's two ADCs and process the data into global arrays
   #if !DUMMY
 
-  sampleChannels();
-  updateVoltageData();
-  extractPlottingData();
+  // Once stopped (Stop, Single or mask stop-on-fail), the held capture is kept, and only the stages whose inputs changed are redone on it
+  if(acquisitionRunning && replaying){
+    replayNextRecord(); // Replayed records were captured already processed
+    recordVersion++;
+  }else if(acquisitionRunning){
+    sampleChannels();
+    processAcquisition();
+    recordCapture();
+    recordVersion++;
+  }
+  updateRecordStages();
+  if(acquisitionRunning){
+    addMeasStats(); // Once per new record, now that its measurements are up to date
+  }
+  runMaskTest();
+  runRefAction();
  
   #endif
 
@@ -1749,8 +9355,16 @@ void loop(){
   // print out all the necessary test data.
   #if DUMMY
     sampleChannels();
+    processAcquisition();
     updateVoltageData();
     extractPlottingData();
+    if(displayMode == DISPLAY_ZOOM){
+      extractZoomOverview();
+      extractZoomColumns();
+    }
+    runProtocolDecoder();
+    runMaskTest();
+    runRefAction();
 
     Serial.println("-------- HScale Test --------");
     Serial.print("HScale: ");
@@ -1766,10 +9380,8 @@ void loop(){
     Serial.print("Trigger Voltage: ");
     Serial.println(triggerVoltage);
 
-    Serial.print("sig1TrigIndex: ");
-    Serial.println(sig1TrigIndex);
-    Serial.print("sig2TrigIndex: ");
-    Serial.println(sig2TrigIndex);
+    Serial.print("trigIndex: ");
+    Serial.println(trigIndex);
 
     printRawChannelData();
     printPlottingData();
@@ -1780,35 +9392,14 @@ void loop(){
 
   // --------- Display + UI Loop ----------
   
-  oScopeImage.clear(tgx::RGB32_Black); //Clear the image
-  
-    
-  // Display the basic moscilloscope components
-  drawAxes();
-  displayTriggerVoltage();
-  displayVScale();
-  displayHScale();
-  displayChannels();
-  
-  
-  #if debugging
-  // displayOffsets();
-  // displayUIStates();
-  #endif
-
-  #if runUI
-  // If the user (UI) has indicated, display the menu (from navigation)
-  if(showMenu){
-    displayMenu();
-  }else{
-  
-  }
-  #endif
-  
+  renderFrame();
 
   // "Update" the image (send the the newest frame to the display)
   tft.update(fb);
 
+  // A single acquisition stops once its record has been through everything above
+  completeSingle();
+
 // --------- Display + UI Loop^^ ----------
   
   }